@@ -0,0 +1,92 @@
+#!/bin/sh
+# Benchmark harness for the assembler - run through "make bench".
+#
+# Generates a fixed set of synthetic programs with gen_program, assembles each one BENCH_RUNS times
+# with --stats (two pass and single pass) and reports the best wall time of every phase together with
+# the throughput in source lines/s and MB/s.
+#
+# Usage: bench.sh <run-assembler> <gen_program> <work dir>
+# Environment: BENCH_LINES (instruction lines per program, default 100000)
+#              BENCH_RUNS  (runs per program, default 5)
+
+ASSEMBLER=$1
+GENERATOR=$2
+WORK_DIR=$3
+LINES=${BENCH_LINES:-100000}
+RUNS=${BENCH_RUNS:-5}
+
+if [ ! -x "$ASSEMBLER" ] || [ ! -x "$GENERATOR" ] || [ -z "$WORK_DIR" ]; then
+    echo "Usage: $0 <run-assembler> <gen_program> <work dir>" >&2
+    exit 1
+fi
+
+mkdir -p "$WORK_DIR" || exit 1
+
+# Prints the best time of each phase of the file over all the runs, one "phase seconds" pair per line
+best_times()
+{
+    awk '
+        /^Statistics for / { in_file = ($0 !~ /file\(s\)/); next }
+        in_file && NF == 3 && $2 ~ /^[0-9.]+$/ {
+            if (!($1 in best)) names[n++] = $1
+            if (!($1 in best) || $2 + 0 < best[$1]) best[$1] = $2 + 0
+        }
+        END { for (i = 0; i < n; i++) printf "%s %.6f\n", names[i], best[names[i]] / 1000 }
+    '
+}
+
+# Generates a program and benchmarks both engines on it: bench_program <name> [generator options]
+bench_program()
+{
+    name=$1
+    shift
+    program="$WORK_DIR/bench_$name"
+
+    "$GENERATOR" -n "$LINES" "$@" > "$program.as" || exit 1
+
+    source_lines=$(wc -l < "$program.as")
+    source_bytes=$(wc -c < "$program.as")
+
+    for engine in two_pass single_pass; do
+        flags=
+        [ "$engine" = single_pass ] && flags=--single-pass
+
+        : > "$program.stats"
+        run=0
+        while [ $run -lt "$RUNS" ]; do
+            # shellcheck disable=SC2086
+            "$ASSEMBLER" --stats $flags "$program" >> "$program.stats" 2> "$program.err" || exit 1
+            if [ -s "$program.err" ]; then
+                echo "bench: $program.as reported errors:" >&2
+                head -5 "$program.err" >&2
+                exit 1
+            fi
+            run=$((run + 1))
+        done
+
+        best_times < "$program.stats" | while read -r phase seconds; do
+            # Phases the engine does not run are skipped
+            case "$phase" in
+                first_pass|second_pass) [ "$engine" = single_pass ] && continue ;;
+                single_pass) [ "$engine" = two_pass ] && continue ;;
+                preprocess+first_pass) continue ;;
+            esac
+
+            awk -v name="$name" -v engine="$engine" -v phase="$phase" -v s="$seconds" \
+                -v lines="$source_lines" -v bytes="$source_bytes" 'BEGIN {
+                if (s > 0)
+                    printf "%-8s %-12s %-12s %12.3f %14.0f %10.2f\n", name, engine, phase, s * 1000, lines / s, bytes / s / 1e6
+                else
+                    printf "%-8s %-12s %-12s %12.3f %14s %10s\n", name, engine, phase, 0, "-", "-"
+            }'
+        done
+    done
+}
+
+printf "%-8s %-12s %-12s %12s %14s %10s\n" "program" "engine" "phase" "best (ms)" "lines/s" "MB/s"
+
+# Workloads - each one stresses a different part of the assembler
+bench_program base
+bench_program labels -l 80 -x 40 -e 50
+bench_program macros -m 50
+bench_program data -d 500
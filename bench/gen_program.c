@@ -0,0 +1,264 @@
+/**
+ * @file gen_program.c
+ * @brief Synthetic workload generator for the assembler benchmarks.
+ * @details This program writes a large, valid assembly program to stdout. The shape of the program is
+ *          controlled from the command line - number of instruction lines, label density, macro usage,
+ *          size of the .data arrays and the share of extern and entry symbols.
+ *          The output only depends on the options (including the seed), so a given command line always
+ *          produces the same program and benchmark results stay comparable between builds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define USAGE "Usage <%s> [-n lines] [-l label%%] [-m macro%%] [-d data_size] [-x extern%%] [-e entry%%] [-s seed]\n"
+
+#define MACRO_COUNT 8                                   /* Number of macros defined at the top of the program */
+#define MACRO_BODY_LINES 3                              /* Number of lines in each macro body */
+#define DATA_VALUES_PER_LINE 10                         /* Values per .data line, keeps the lines under 80 chars */
+#define LINES_PER_DATA_ARRAY 100                        /* One .data array per this many instruction lines */
+#define LINES_PER_EXTERN 100                            /* One .extern declaration per this many instruction lines */
+
+/* Generator options structure */
+
+typedef struct {
+    long lines;                                         /* Number of instruction lines (-n) */
+    int label_pct;                                      /* Percent of the instruction lines with a label (-l) */
+    int macro_pct;                                      /* Percent of the instruction lines that are macro calls (-m) */
+    int data_size;                                      /* Number of values in each .data array (-d) */
+    int extern_pct;                                     /* Percent of the symbol operands that are externs (-x) */
+    int entry_pct;                                      /* Percent of the labels declared .entry (-e) */
+    unsigned long seed;                                 /* Seed of the random generator (-s) */
+} GenOptions;
+
+/* Two operand instructions whose operands may be any register or symbol */
+static const char *two_operand[] = {"mov", "add", "sub"};
+
+/* One operand instructions whose operand may be any register or symbol */
+static const char *one_operand[] = {"clr", "not", "inc", "dec", "red"};
+
+/* Jump instructions, taking a symbol or a relative (&label) operand */
+static const char *jumps[] = {"jmp", "bne", "jsr"};
+
+/* State of the linear congruential generator - the C library rand() differs between platforms */
+static unsigned long rng_state = 1;
+
+/* Returns a pseudo random number in [0, range) */
+static long rng(long range)
+{
+    rng_state = (rng_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return range > 0 ? (long)((rng_state >> 8) % (unsigned long)range) : 0;
+}
+
+/* Number of labels in the program, the label of a line is known without storing the lines */
+static long label_count(const GenOptions *opt)
+{
+    return opt->lines * opt->label_pct / 100;
+}
+
+/* Returns the index of the label defined on the given instruction line, or -1 if the line has no label */
+static long line_label(const GenOptions *opt, long line)
+{
+    long before = line * opt->label_pct / 100;
+    long after = (line + 1) * opt->label_pct / 100;
+
+    return after != before ? before : -1;
+}
+
+/* Number of .extern declarations in the program */
+static long extern_count(const GenOptions *opt)
+{
+    return opt->extern_pct > 0 ? opt->lines / LINES_PER_EXTERN + 1 : 0;
+}
+
+/* Number of .data arrays in the program */
+static long data_count(const GenOptions *opt)
+{
+    return opt->data_size > 0 ? opt->lines / LINES_PER_DATA_ARRAY + 1 : 0;
+}
+
+/* Prints a symbol operand - a label, an extern or a data array, or a register when there are no symbols */
+static void print_symbol(const GenOptions *opt)
+{
+    long labels = label_count(opt);
+
+    if (extern_count(opt) && rng(100) < opt->extern_pct)
+        printf("X%ld", rng(extern_count(opt)));
+    else if (data_count(opt) && (!labels || rng(2)))
+        printf("D%ld", rng(data_count(opt)));
+    else if (labels)
+        printf("L%ld", rng(labels));
+    else
+        printf("r%ld", rng(8));
+}
+
+/* Prints a register or symbol operand */
+static void print_operand(const GenOptions *opt)
+{
+    if (rng(2))
+        printf("r%ld", rng(8));
+    else
+        print_symbol(opt);
+}
+
+/* Prints a single random instruction without the label and the newline */
+static void print_instruction(const GenOptions *opt)
+{
+    long labels = label_count(opt);
+
+    switch (rng(8))
+    {
+        case 0:
+        case 1:
+            printf("%s ", two_operand[rng(sizeof(two_operand) / sizeof(two_operand[0]))]);
+            print_operand(opt);
+            printf(", r%ld", rng(8));
+            break;
+
+        case 2:
+            printf("cmp ");
+            print_operand(opt);
+            printf(", #%ld", rng(2001) - 1000);
+            break;
+
+        case 3:
+            /* lea only takes a symbol source, a program without symbols gets a register operand instead */
+            printf("%s ", labels || data_count(opt) || extern_count(opt) ? "lea" : "mov");
+            print_symbol(opt);
+            printf(", r%ld", rng(8));
+            break;
+
+        case 4:
+        case 5:
+            printf("%s ", one_operand[rng(sizeof(one_operand) / sizeof(one_operand[0]))]);
+            print_operand(opt);
+            break;
+
+        case 6:
+            if (labels)
+                printf("%s &L%ld", jumps[rng(sizeof(jumps) / sizeof(jumps[0]))], rng(labels));
+            else
+                printf("prn #%ld", rng(2001) - 1000);
+            break;
+
+        default:
+            printf("prn ");
+            if (rng(2))
+                printf("#%ld", rng(2001) - 1000);
+            else
+                print_operand(opt);
+            break;
+    }
+}
+
+/* Parses a non negative numeric option value */
+static int parse_value(const char *str, long max, long *value)
+{
+    char *end = NULL;
+
+    if (!str)
+        return 0;
+
+    *value = strtol(str, &end, 10);
+    return *end == '\0' && *value >= 0 && *value <= max;
+}
+
+int main(int argc, char **argv)
+{
+    GenOptions opt = {10000, 20, 5, 20, 10, 10, 1};
+    long i, j, value;
+
+    /* Parse the options, each one takes a value */
+    for (i = 1; i < argc; i++)
+    {
+        char flag = (argv[i][0] == '-' && argv[i][1] && !argv[i][2]) ? argv[i][1] : '\0';
+        const char *arg = i + 1 < argc ? argv[++i] : NULL;
+
+        if (!parse_value(arg, flag == 'n' || flag == 's' ? 100000000L : (flag == 'd' ? 10000L : 100L), &value))
+            flag = '\0';
+
+        switch (flag)
+        {
+            case 'n': opt.lines = value; break;
+            case 'l': opt.label_pct = (int)value; break;
+            case 'm': opt.macro_pct = (int)value; break;
+            case 'd': opt.data_size = (int)value; break;
+            case 'x': opt.extern_pct = (int)value; break;
+            case 'e': opt.entry_pct = (int)value; break;
+            case 's': opt.seed = (unsigned long)value; break;
+            default:
+                fprintf(stderr, USAGE, argv[0]);
+                return 1;
+        }
+    }
+
+    rng_state = opt.seed;
+
+    printf("; generated by gen_program -n %ld -l %d -m %d -d %d -x %d -e %d -s %lu\n",
+           opt.lines, opt.label_pct, opt.macro_pct, opt.data_size, opt.extern_pct, opt.entry_pct, opt.seed);
+
+    /* Externs and entries */
+    for (i = 0; i < extern_count(&opt); i++)
+        printf(".extern X%ld\n", i);
+
+    for (i = 0; i < label_count(&opt); i++)
+        if (rng(100) < opt.entry_pct)
+            printf(".entry L%ld\n", i);
+
+    /* Macro definitions */
+    if (opt.macro_pct > 0)
+    {
+        for (i = 0; i < MACRO_COUNT; i++)
+        {
+            printf("mcro macro_%ld\n", i);
+            for (j = 0; j < MACRO_BODY_LINES; j++)
+            {
+                printf("    ");
+                print_instruction(&opt);
+                printf("\n");
+            }
+            printf("mcroend\n");
+        }
+    }
+
+    /* Instruction lines */
+    for (i = 0; i < opt.lines; i++)
+    {
+        long label = line_label(&opt, i);
+
+        if (label >= 0)
+            printf("L%ld: ", label);
+        else
+            printf("    ");
+
+        /* A labeled line must hold an instruction, macro calls can not be labeled */
+        if (label < 0 && rng(100) < opt.macro_pct)
+            printf("macro_%ld", rng(MACRO_COUNT));
+        else
+            print_instruction(&opt);
+
+        printf("\n");
+    }
+
+    printf("    stop\n");
+
+    /* Data arrays */
+    for (i = 0; i < data_count(&opt); i++)
+    {
+        for (j = 0; j < opt.data_size; j++)
+        {
+            if (j == 0)
+                printf("D%ld: .data ", i);
+            else if (j % DATA_VALUES_PER_LINE == 0)
+                printf("\n    .data ");
+            else
+                printf(", ");
+
+            printf("%ld", rng(20001) - 10000);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
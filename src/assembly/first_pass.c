@@ -21,14 +21,14 @@
 #include <ctype.h>
 
 
-Symbol *symbol_create(StringView sv, size_t address, int external, int entry)
+Symbol *symbol_create(Arena *arena, StringView sv, size_t address, int external, int entry)
 {
     Symbol *symbol = NULL;
 
     if (!sv.str)
         return NULL;
 
-    symbol = (Symbol *)MALLOC(sizeof(Symbol));
+    symbol = (Symbol *)ARENA_ALLOC(arena, sizeof(Symbol));
     if (!symbol)
         return NULL;
 
@@ -58,7 +58,7 @@ Symbol *symbol_copy(void *symbol)
     if (!symbol)
         return NULL;
 
-    copy = symbol_create(sym->sv, sym->address, sym->external, sym->entry);
+    copy = symbol_create(NULL, sym->sv, sym->address, sym->external, sym->entry);
     if (!copy)
         return NULL;
 
@@ -68,7 +68,6 @@ Symbol *symbol_copy(void *symbol)
 int validate_label(StringView sv, AssemblerContext *ctx)
 {
     size_t i;
-    char *label_str = NULL;
     Symbol *existing_symbol = NULL;
     
     /* Check if label is empty */
@@ -109,57 +108,43 @@ int validate_label(StringView sv, AssemblerContext *ctx)
         }
     }
     
-    /* Create a null-terminated copy of the label for comparison */
-    label_str = (char *)MALLOC(sv.length + 1);
-    if (!label_str)
-        return 0;
-    
-    /* Copy the label string */
-    memcpy(label_str, sv.str, sv.length);
-    label_str[sv.length] = '\0';
-    
     /* Check if label is a reserved word */
-    if (find_instruction(label_str) != NULL) 
+    if (find_instruction(sv) != NULL) 
     {
         error_report(ctx->errors, ERR_LABEL_NAME_INSTRUCTION, 
-                     "%s:%d: Label name '%s' cannot be an instruction name", 
-                     ctx->ir_filename, ctx->line_number, label_str);
-        FREE(label_str);
+                     "%s:%d: Label name '%.*s' cannot be an instruction name", 
+                     ctx->ir_filename, ctx->line_number, (int)sv.length, sv.str);
         return 0;
     }
 
     /* Check if label is a register name */
-    if (find_register(label_str) != NULL) 
+    if (find_register(sv) != NULL) 
     {
         error_report(ctx->errors, ERR_LABEL_NAME_REGISTER, 
-                     "%s:%d: Label name '%s' cannot be a register name", 
-                     ctx->ir_filename, ctx->line_number, label_str);
-        FREE(label_str);
+                     "%s:%d: Label name '%.*s' cannot be a register name", 
+                     ctx->ir_filename, ctx->line_number, (int)sv.length, sv.str);
         return 0;
     }
     
     /* Check if label is a directive name */
-    if (is_directive(sv_from_str(label_str))) 
+    if (is_directive(sv)) 
     {
         error_report(ctx->errors, ERR_LABEL_NAME_DIRECTIVE, 
-                     "%s:%d: Label name '%s' cannot be a directive name", 
-                     ctx->ir_filename, ctx->line_number, label_str);
-        FREE(label_str);
+                     "%s:%d: Label name '%.*s' cannot be a directive name", 
+                     ctx->ir_filename, ctx->line_number, (int)sv.length, sv.str);
         return 0;
     }
     
     /* Check if the label is already defined (duplicate) */
-    existing_symbol = hash_map_get(ctx->symbol_table, label_str);
+    existing_symbol = hash_map_get_sv(ctx->symbol_table, sv);
     if (existing_symbol != NULL) 
     {
         error_report(ctx->errors, ERR_LABEL_NAME_DUPLICATE, 
-                     "%s:%d: Label '%s' already defined", 
-                     ctx->ir_filename, ctx->line_number, label_str);
-        FREE(label_str);
+                     "%s:%d: Label '%.*s' already defined", 
+                     ctx->ir_filename, ctx->line_number, (int)sv.length, sv.str);
         return 0;
     }
     
-    FREE(label_str);
     return 1;
 }
 
@@ -179,11 +164,11 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
     Token *token = NULL;
     Token *label = NULL;
     Symbol *symbol = NULL;
-    char *str = NULL;
     int is_external = 0;
     int is_entry = 0;
     size_t address = 0;
     StringView sv = {0}, label_sv = {0};
+    char *name = NULL;
 
     if (!ctx || !tokens || array_list_size(tokens) == 0)
         return;
@@ -195,7 +180,7 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
     if (token && token->type == TOKEN_LABEL)
     {
         label = token;
-        label_sv = token->sv;
+        label_sv = token_sv(token);
         i += 2;
     }
     else
@@ -212,7 +197,7 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
     /* For label definitions, validate the label name, colon and directive */
     if (label && !is_entry_statement(tokens) && !is_extern_statement(tokens)) 
     {
-        if (!validate_label(label->sv, ctx)) 
+        if (!validate_label(token_sv(label), ctx)) 
             return; /* Invalid label, error already reported */
         
     }
@@ -234,7 +219,7 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
     {
         i++;
         token = (Token *)array_list_get(tokens, i);
-        sv = token->sv;
+        sv = token_sv(token);
         is_external = 1;
     }
 
@@ -243,25 +228,29 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
     {
         i++;
         token = (Token *)array_list_get(tokens, i);
-        sv = token->sv;
+        sv = token_sv(token);
         is_entry = 1;
     }
 
     else
         return; 
 
+    /* A streamed line is released once it is processed, so the symbol keeps a copy of its name */
+    if (ctx->line_arena && sv.str && (name = (char *)ARENA_ALLOC(ctx->arena, sv.length + 1)))
+    {
+        memcpy(name, sv.str, sv.length);
+        name[sv.length] = '\0';
+        sv.str = name;
+    }
+
     /* Create the symbol with the determined attributes */
-    symbol = symbol_create(sv, address, is_external, is_entry);
+    symbol = symbol_create(ctx->arena, sv, address, is_external, is_entry);
     if (!symbol)
         return;
 
     /* Add the symbol to the appropriate collections */
     if (is_external || !is_entry)
-    {
-        str = sv.str;
-        str[sv.length] = '\0';
-        hash_map_put(ctx->symbol_table, str, symbol);
-    }
+        hash_map_put_sv(ctx->symbol_table, sv, symbol);
     
     if (is_external)
         array_list_append(ctx->extern_names, symbol);
@@ -269,14 +258,58 @@ void define_symbol(AssemblerContext *ctx, ArrayList *tokens)
         array_list_append(ctx->entry_names, symbol);
 }
 
-void first_pass(AssemblerContext *ctx)
+void first_pass_statement(Lexer *lexer, AssemblerContext *ctx, ArrayList *tokens)
 {
-    Lexer lexer = {0};
-    ArrayList *tokens = NULL;
     ParsedInstruction instruction = {0};
     ParsedDirective directive = {0};
+    Statement *statement = NULL;
     int is_instruction = 0;
     int is_directive = 0;
+
+    if (!lexer || !ctx || !tokens)
+        return;
+
+    /* If its an instruction parse it an instruction and update IC */
+    if ((is_instruction = is_instruction_statement(tokens)))
+    {
+        parse_instruction(&instruction, tokens, ctx, 1);
+
+        /* Keep the parsed instruction for the second pass */
+        if ((statement = statement_append(ctx, STATEMENT_INSTRUCTION, lexer->line_number)))
+        {
+            statement->as.instruction = instruction;
+            statement->as.instruction.tokens = NULL;
+        }
+
+        ctx->IC += instruction.code_word_count;
+    }
+
+    /* If its a directive parse it and update DC */
+    if ((is_directive = is_directive_statement(tokens)))
+    {
+        parse_directive(&directive, tokens, ctx);
+
+        /* Keep the parsed directive for the second pass */
+        if ((statement = statement_append(ctx, STATEMENT_DIRECTIVE, lexer->line_number)))
+        {
+            statement->as.directive = directive;
+            statement->as.directive.tokens = NULL;
+        }
+
+        ctx->DC += directive.code_word_count;
+        ctx->IC += directive.code_word_count;
+    }
+
+    /* If the statement is neither an instruction nor a directive, report an error */
+    if (!is_instruction && !is_directive)
+        error_report(ctx->errors, ERR_INVALID_STATEMENT, "%s:%d: Invalid statement: '%.*s'", 
+                     ctx->ir_filename, lexer->line_number, (int)lexer->current_line.length, lexer->current_line.str); 
+}
+
+void first_pass(AssemblerContext *ctx)
+{
+    Lexer lexer = {0};
+    ArrayList *tokens = NULL;
    
     if (!ctx)
         return;
@@ -290,7 +323,7 @@ void first_pass(AssemblerContext *ctx)
     ctx->line_number = 1;
     
     /* Iterate through each line of the file */
-    while (lexer_next_line(&lexer, ctx))
+    while (!error_limit_reached(ctx->errors) && lexer_next_line(&lexer, ctx))
     {
         /* Tokenize the current line */
         lexer_tokenize_line(&lexer, ctx, tokens);
@@ -299,34 +332,16 @@ void first_pass(AssemblerContext *ctx)
         if (is_label_statement(tokens) || is_entry_statement(tokens) || is_extern_statement(tokens))
             define_symbol(ctx, tokens);
         
-        /* If its an instruction parse it an instruction and update IC */
-        if ((is_instruction = is_instruction_statement(tokens)))
-        {
-            parse_instruction(&instruction, tokens, ctx, 1);
-            ctx->IC += instruction.code_word_count;
-        }
-
-        /* If its a directive parse it and update DC */
-        if ((is_directive = is_directive_statement(tokens)))
-        {
-            parse_directive(&directive, tokens, ctx);
-            ctx->DC += directive.code_word_count;
-            ctx->IC += directive.code_word_count;
-        }
-
-        /* If the statement is neither an instruction nor a directive, report an error */
-        if (!is_instruction && !is_directive)
-            error_report(ctx->errors, ERR_INVALID_STATEMENT, "%s:%d: Invalid statement: '%.*s'", 
-                         ctx->ir_filename, lexer.line_number, (int)lexer.current_line.length, lexer.current_line.str); 
+        /* Parse the statement and update IC and DC */
+        first_pass_statement(&lexer, ctx, tokens);
 
         /* Clear for next line */
         array_list_clear(tokens);
 
-        /* Update Line number and reset flags */
+        /* Update Line number */
         ctx->line_number++;
-        is_instruction = is_directive = 0;
     }
     
     /* Clean up */
     array_list_destroy(tokens);
-}
\ No newline at end of file
+}
@@ -13,6 +13,7 @@
 
 #include "../main/assembler.h"
 #include "../common/string_view.h"
+#include "../common/lexer.h"
 
 #define MAX_LABEL_LEN 31
 
@@ -29,12 +30,14 @@ typedef struct {
 
 /**
  * @brief Creates a new symbol.
+ * @param arena The arena to allocate the symbol from, NULL to allocate it on the heap.
  * @param sv The symbol name as a StringView.
  * @param address The address of the symbol.
  * @param external Flag indicating if the symbol is external.
  * @param entry Flag indicating if the symbol is defined with .entry.
+ * @note Heap symbols must be freed by the caller using symbol_destroy(), arena symbols are released with the arena.
  */
-Symbol *symbol_create(StringView sv, size_t address, int external, int entry);
+Symbol *symbol_create(Arena *arena, StringView sv, size_t address, int external, int entry);
 
 /**
  * @brief Destroys a symbol and frees its memory.
@@ -54,9 +57,19 @@ Symbol *symbol_copy(void *symbol);
 /**
  * @brief Preforms the first pass of the assembler - Parsing, Building the symbol table, calculating addresses and error checking.
  * @param ctx Pointer to the assembler context.
+ * @note Every parsed instruction and directive is kept in ctx->statements together with its IC and DC for the second pass.
  */
 void first_pass(AssemblerContext *ctx);
 
+/**
+ * @brief Parses a tokenized line as an instruction or directive statement and advances IC and DC by its size.
+ * @param lexer Pointer to the lexer holding the line.
+ * @param ctx Pointer to the assembler context.
+ * @param tokens The tokens of the line.
+ * @note The statement is appended to ctx->statements with the IC and DC before it. Symbols are not defined here.
+ */
+void first_pass_statement(Lexer *lexer, AssemblerContext *ctx, ArrayList *tokens);
+
 /**
  * @brief Validates a label name.
  * @param sv The label name as a StringView.
@@ -0,0 +1,380 @@
+/**
+ * @file linker.c
+ * @brief Implementation of the link stage of the assembler.
+ * @details This file contains the loader of binary object files and the link stage - the modules are assembled
+ *          or loaded on a worker pool, laid out and indexed on the calling thread, and relocated into the program
+ *          image on the worker pool again, every module into its own range of the image.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "./linker.h"
+#include "./first_pass.h"
+#include "../main/simulator.h"
+#include "../main/worker_pool.h"
+#include "../common/code_gen.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/isa.h"
+#include "../common/util.h"
+
+/* Highest address an ARE_RELOCATABLE word can hold */
+#define LINK_MAX_ADDRESS ((size_t)(IMM_MASK >> IMM_SHIFT))
+
+/* An entry of the global symbol index - the symbol comes first, so a list of them is written as a list of symbols */
+typedef struct {
+    Symbol symbol;                                      /* The entry, at its address in the program */
+    int module;                                         /* Index of the module defining it */
+} LinkSymbol;
+
+/* State of a single link_modules() call shared with the worker threads */
+typedef struct {
+    char **modules;                                     /* Names of the modules */
+    AssemblerContext *contexts;                         /* One context per module */
+    AssemblerOptions module_options;                    /* Options of the modules - their files are not written */
+    size_t *bases;                                      /* Address of the first word of every module in the program */
+    HashMap *index;                                     /* Entries of all the modules by name (LinkSymbol) */
+    AssemblerContext *program;                          /* The linked program */
+    int is_failed;                                      /* A module reported errors */
+} LinkJob;
+
+/* Reads a 32 bit little endian field */
+static unsigned long read_u32(const unsigned char *field)
+{
+    return (unsigned long)field[0] | ((unsigned long)field[1] << 8) |
+           ((unsigned long)field[2] << 16) | ((unsigned long)field[3] << 24);
+}
+
+/* Reads a table of (name offset, address) pairs into a list of symbols, returns 0 if a name is not in the string table */
+static int load_symbols(AssemblerContext *ctx, const unsigned char *table, size_t count,
+                        const char *names, size_t names_size, ArrayList *list, int is_external)
+{
+    Symbol *symbol = NULL;
+    char *name = NULL;
+    size_t i, offset, length;
+
+    for (i = 0; i < count; i++)
+    {
+        offset = read_u32(table + 2 * i * OBJ_BIN_FIELD_SIZE);
+
+        if (offset >= names_size || !memchr(names + offset, '\0', names_size - offset))
+            return 0;
+
+        /* The names are copied into the arena, the file contents are released once loaded */
+        length = strlen(names + offset);
+        name = (char *)ARENA_ALLOC(ctx->arena, length + 1);
+        if (!name)
+            return 0;
+
+        memcpy(name, names + offset, length + 1);
+
+        symbol = symbol_create(ctx->arena, sv_from_parts(name, length),
+                               read_u32(table + (2 * i + 1) * OBJ_BIN_FIELD_SIZE), is_external, !is_external);
+        if (!symbol)
+            return 0;
+
+        array_list_append(list, symbol);
+    }
+
+    return 1;
+}
+
+int link_load_object(AssemblerContext *ctx)
+{
+    const unsigned char *data = NULL;
+    char *contents = NULL;
+    size_t i, size = 0, image_size = 0, data_count = 0, entry_count = 0, extern_count = 0, names_size = 0;
+    size_t tables = 0, flagged = 0;
+    int is_loaded = 0;
+
+    if (!ctx || !ctx->filename || !ctx->errors)
+        return 0;
+
+    contents = file_read_contents(ctx->filename, &size);
+    if (!contents)
+    {
+        error_report(ctx->errors, ERR_FILE_READ, "Failed to read file: %s", ctx->filename);
+        return 0;
+    }
+
+    data = (const unsigned char *)contents;
+
+    /* Header - the counts are checked against the size of the file before anything is read */
+    if (size >= OBJ_BIN_HEADER_SIZE && memcmp(data, OBJ_BIN_MAGIC, OBJ_BIN_FIELD_SIZE) == 0 &&
+        read_u32(data + 4) == OBJ_BIN_VERSION && read_u32(data + 8) == INITIAL_IC)
+    {
+        image_size = read_u32(data + 12) + read_u32(data + 16);
+        data_count = read_u32(data + 16);
+        entry_count = read_u32(data + 20);
+        extern_count = read_u32(data + 24);
+        names_size = read_u32(data + 28);
+
+        if (image_size <= size / OBJ_BIN_FIELD_SIZE && entry_count + extern_count <= size / OBJ_BIN_FIELD_SIZE)
+            tables = OBJ_BIN_HEADER_SIZE + (image_size + 2 * (entry_count + extern_count)) * OBJ_BIN_FIELD_SIZE;
+
+        is_loaded = tables > 0 && tables + names_size == size;
+    }
+
+    /* The image as it was written, data words keep their flag */
+    if (is_loaded && image_size > 0)
+    {
+        ctx->image = (Word *)MALLOC(image_size * sizeof(Word));
+        is_loaded = ctx->image != NULL;
+
+        for (i = 0; is_loaded && i < image_size; i++)
+        {
+            ctx->image[i] = read_u32(data + OBJ_BIN_HEADER_SIZE + i * OBJ_BIN_FIELD_SIZE) & (WORD_MASK | WORD_DATA_FLAG);
+            flagged += (ctx->image[i] & WORD_DATA_FLAG) != 0;
+        }
+
+        ctx->image_size = ctx->image_capacity = is_loaded ? image_size : 0;
+        is_loaded = is_loaded && flagged == data_count;
+    }
+
+    /* Entries, then externals */
+    if (is_loaded)
+    {
+        const unsigned char *table = data + OBJ_BIN_HEADER_SIZE + image_size * OBJ_BIN_FIELD_SIZE;
+
+        is_loaded = load_symbols(ctx, table, entry_count, contents + tables, names_size, ctx->entries, 0) &&
+                    load_symbols(ctx, table + 2 * entry_count * OBJ_BIN_FIELD_SIZE, extern_count,
+                                 contents + tables, names_size, ctx->externals, 1);
+    }
+
+    if (is_loaded)
+    {
+        ctx->IC = INITIAL_IC + (int)image_size;
+        ctx->DC = (int)data_count;
+    }
+    else
+        error_report(ctx->errors, ERR_LINK_OBJECT, "%s: Invalid binary object file", ctx->filename);
+
+    FREE(contents);
+    return is_loaded;
+}
+
+/* Worker task - assembles or loads a single module, keeping its errors in its context */
+static void link_module_load(void *arg, int index)
+{
+    LinkJob *job = (LinkJob *)arg;
+    AssemblerContext *ctx = &job->contexts[index];
+    const char *name = job->modules[index];
+    size_t length = strlen(name), ext_length = strlen(OBJ_BIN_EXT);
+
+    asm_ctx_init(ctx, name, &job->module_options);
+
+    if (ctx->errors && length > ext_length && strcmp(name + length - ext_length, OBJ_BIN_EXT) == 0)
+        link_load_object(ctx);
+    else if (ctx->errors)
+        assemble_file(ctx);
+
+    /* The context is released on the calling thread */
+    stats_set_thread_allocs(NULL);
+}
+
+/* Called in module order - reports the errors of a module */
+static void link_module_done(void *arg, int index)
+{
+    LinkJob *job = (LinkJob *)arg;
+    AssemblerContext *ctx = &job->contexts[index];
+
+    if (!ctx->errors || error_count(ctx->errors) > 0)
+        job->is_failed = 1;
+
+    if (ctx->errors)
+        error_report_all(ctx->errors);
+}
+
+/* Lays the modules out one after the other and indexes their entries, returns 0 on an error */
+static int link_layout(LinkJob *job, int module_count, ErrorLog *errors)
+{
+    AssemblerContext *ctx = NULL;
+    LinkSymbol *existing = NULL, *entry = NULL;
+    Symbol *symbol = NULL;
+    size_t i, address = INITIAL_IC;
+    int module;
+
+    for (module = 0; module < module_count; module++)
+    {
+        job->bases[module] = address;
+        address += job->contexts[module].image_size;
+        job->program->DC += job->contexts[module].DC;
+    }
+
+    if (address - 1 > LINK_MAX_ADDRESS)
+    {
+        error_report(errors, ERR_ADD_OUT_OF_BOUNDS, "%s: Program of %lu words exceeds the highest address %lu",
+                     job->program->filename, (unsigned long)(address - INITIAL_IC), (unsigned long)LINK_MAX_ADDRESS);
+        return 0;
+    }
+
+    job->program->image_size = address - INITIAL_IC;
+    job->program->IC = (int)address;
+
+    /* Global symbol index - the entries of every module at their address in the program */
+    for (module = 0; module < module_count; module++)
+    {
+        ctx = &job->contexts[module];
+
+        for (i = 0; i < array_list_size(ctx->entries); i++)
+        {
+            symbol = (Symbol *)array_list_get(ctx->entries, i);
+            existing = (LinkSymbol *)hash_map_get_sv(job->index, symbol->sv);
+
+            if (existing)
+            {
+                error_report(errors, ERR_LINK_DUPLICATE, "%s: Entry '%.*s' is already defined in %s",
+                             ctx->filename, (int)symbol->sv.length, symbol->sv.str, job->modules[existing->module]);
+                continue;
+            }
+
+            entry = (LinkSymbol *)ARENA_ALLOC(job->program->arena, sizeof(LinkSymbol));
+            if (!entry)
+                return 0;
+
+            entry->symbol = *symbol;
+            entry->symbol.address = symbol->address - INITIAL_IC + job->bases[module];
+            entry->module = module;
+
+            hash_map_put_sv(job->index, symbol->sv, entry);
+            array_list_append(job->program->entries, entry);
+        }
+    }
+
+    return error_count(errors) == 0;
+}
+
+/* Worker task - copies a module into its range of the program image, relocating and patching its words */
+static void link_module_relocate(void *arg, int index)
+{
+    LinkJob *job = (LinkJob *)arg;
+    AssemblerContext *ctx = &job->contexts[index];
+    size_t offset = job->bases[index] - INITIAL_IC;
+    Word *image = job->program->image + offset;
+    LinkSymbol *target = NULL;
+    Symbol *external = NULL;
+    Word word = 0;
+    size_t i, word_index;
+
+    /* Words holding the address of a symbol of the module move with it - data words are never relocated */
+    for (i = 0; i < ctx->image_size; i++)
+    {
+        word = ctx->image[i];
+
+        if (!(word & WORD_DATA_FLAG) && (word & ARE_MASK) == ARE_RELOCATABLE)
+        {
+            word_from_immediate(&word, (int)((word & IMM_MASK) >> IMM_SHIFT) + (int)offset);
+            word_set_are(&word, ARE_RELOCATABLE);
+        }
+
+        image[i] = word;
+    }
+
+    /* External references take the address of the entry of the same name, relocatable like any other address */
+    for (i = 0; i < array_list_size(ctx->externals); i++)
+    {
+        external = (Symbol *)array_list_get(ctx->externals, i);
+        target = (LinkSymbol *)hash_map_get_sv(job->index, external->sv);
+        word_index = external->address - INITIAL_IC;
+
+        if (!target)
+        {
+            error_report(ctx->errors, ERR_LINK_UNDEFINED, "%s: External symbol '%.*s' is not an entry of any linked module",
+                         ctx->filename, (int)external->sv.length, external->sv.str);
+            continue;
+        }
+
+        if (external->address < INITIAL_IC || word_index >= ctx->image_size)
+        {
+            error_report(ctx->errors, ERR_LINK_OBJECT, "%s: Reference to '%.*s' at address %lu is outside of the module",
+                         ctx->filename, (int)external->sv.length, external->sv.str, (unsigned long)external->address);
+            continue;
+        }
+
+        word_from_immediate(&image[word_index], (int)target->symbol.address);
+        word_set_are(&image[word_index], ARE_RELOCATABLE);
+    }
+}
+
+int link_modules(char **modules, int module_count, const char *output, const AssemblerOptions *options)
+{
+    AssemblerContext program;
+    LinkJob job;
+    int jobs = options ? options->jobs : 0;
+    int i, is_linked = 0;
+
+    if (!modules || module_count < 1 || !output)
+        return 1;
+
+    memset(&job, 0, sizeof(LinkJob));
+    job.modules = modules;
+    job.program = &program;
+
+    /* The modules stay in memory - no file is written and the build cache is not used for them */
+    if (options)
+        job.module_options = *options;
+    job.module_options.no_output = 1;
+    job.module_options.cache_dir = NULL;
+
+    asm_ctx_init(&program, output, options);
+    stats_set_thread_allocs(NULL);
+
+    job.contexts = (AssemblerContext *)MALLOC(module_count * sizeof(AssemblerContext));
+    job.bases = (size_t *)MALLOC(module_count * sizeof(size_t));
+    job.index = hash_map_create(NULL);
+
+    if (!program.errors || !job.contexts || !job.bases || !job.index)
+    {
+        fprintf(stderr, "Failed to create the link job\n");
+        job.is_failed = 1;
+    }
+    else
+    {
+        memset(job.contexts, 0, module_count * sizeof(AssemblerContext));
+
+        /* Assemble or load the modules, their errors are reported in module order */
+        worker_pool_run(jobs, module_count, link_module_load, link_module_done, &job);
+    }
+
+    /* Lay the program out, then relocate every module into it */
+    if (!job.is_failed && link_layout(&job, module_count, program.errors))
+    {
+        program.image = (Word *)MALLOC((program.image_size ? program.image_size : 1) * sizeof(Word));
+        program.image_capacity = program.image ? program.image_size : 0;
+
+        if (program.image)
+        {
+            worker_pool_run(jobs, module_count, link_module_relocate, link_module_done, &job);
+            is_linked = !job.is_failed;
+        }
+    }
+
+    /* Write the program, in the formats of the assembler's output files */
+    if (is_linked)
+        generate_output(&program, 2);
+    else if (program.errors)
+        error_report_all(program.errors);
+
+    /* With --run the linked program is run, and has to stop */
+    if (is_linked && options && options->run)
+        is_linked = sim_run(&program, options);
+
+    /* Clean up - the entries of the program point into the modules */
+    asm_ctx_destroy(&program);
+
+    if (job.contexts)
+    {
+        for (i = 0; i < module_count; i++)
+            asm_ctx_destroy(&job.contexts[i]);
+
+        FREE(job.contexts);
+    }
+
+    if (job.bases)
+        FREE(job.bases);
+    if (job.index)
+        hash_map_destroy(job.index);
+
+    return !is_linked;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file linker.h
+ * @brief Header file for the link stage of the assembler (--link).
+ * @details This file contains the function prototypes for combining assembled modules into a single program.
+ *          Every module is either a source, assembled in memory without writing its files, or a binary object
+ *          file (.obb) written with --binary. The modules are laid out one after the other from INITIAL_IC,
+ *          in the order they were given, and a global symbol index is built from the entries of every module.
+ *          The modules are then copied into the program image in parallel, one task per module:
+ *
+ *          - ARE_RELOCATABLE words have the base of their module added to their address
+ *          - ARE_EXTERNAL words are patched from the externals list of their module with the address of the
+ *            entry of the same name, and become ARE_RELOCATABLE
+ *
+ * The program is written as <output>.ob and <output>.ent (with --binary also <output>.obb), in the formats of
+ * the assembler's own output files. Nothing is written if a module has errors, an external symbol is not an entry
+ * of any module, or an entry is defined by two modules.
+ */
+
+#ifndef LINKER_H
+#define LINKER_H
+
+#include "../main/assembler.h"
+
+/**
+ * @brief Loads a binary object file (.obb) into an initialized context, as if its module was assembled.
+ * @param ctx Pointer to the context, ctx->filename is the path of the binary object file.
+ * @return 1 on success, 0 if the file can not be read or is not a valid binary object file (an error is reported).
+ * @note Fills the image, IC, DC, entries and externals of the context - everything the link stage uses.
+ */
+int link_load_object(AssemblerContext *ctx);
+
+/**
+ * @brief Assembles or loads the modules and links them into a single program.
+ * @param modules The names of the modules - sources without their extension, or binary object files ending with .obb.
+ * @param module_count The number of modules.
+ * @param output The name of the program, without an extension.
+ * @param options Options of the run, NULL for the defaults. With options->jobs > 1 the modules are assembled
+ *                and relocated on a pool of worker threads.
+ * @return 0 if the program was written, 1 otherwise. The errors are reported in the order of the modules.
+ * @note With options->run the written program is run in the simulator, and 1 is returned if it does not stop.
+ */
+int link_modules(char **modules, int module_count, const char *output, const AssemblerOptions *options);
+
+#endif /* LINKER_H */
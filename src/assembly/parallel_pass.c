@@ -0,0 +1,478 @@
+/**
+ * @file parallel_pass.c
+ * @brief Implementation of the intra-file parallel passes of the assembler.
+ * @details This file contains the chunking of a file over worker threads for the first and second pass.
+ *          A chunk runs on a shadow copy of the context: it shares the read-only state (the lines, the token
+ *          line index, the symbol table) and has its own arena, errors, statements, externals and allocation
+ *          statistics, which are merged back into the context in chunk order on the calling thread.
+ *          A chunk stops at its first error - the pass is then run again serially, which reports the errors
+ *          in order and stops at max_errors like any other file.
+ */
+
+#include <string.h>
+
+#include "./parallel_pass.h"
+#include "./first_pass.h"
+#include "./second_pass.h"
+#include "../main/worker_pool.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/lexer.h"
+#include "../common/parser.h"
+#include "../common/util.h"
+
+/* A line defining a symbol, its definition waits for the base address of its chunk */
+typedef struct {
+    size_t line_number;                                 /* Line number of the definition */
+    int IC;                                             /* IC at the start of the line, relative to the chunk */
+} SymbolLine;
+
+/* A contiguous range of lines (first pass) or statements (second pass) */
+typedef struct {
+    AssemblerContext local;                             /* Shadow context of the chunk */
+    size_t first;                                       /* Index of the first line or statement */
+    size_t last;                                        /* Index after the last line or statement */
+    SymbolLine *symbol_lines;                           /* Lines defining symbols, in line order */
+    size_t symbol_count;                                /* Number of symbol lines */
+    size_t symbol_capacity;                             /* Allocated capacity of symbol_lines */
+    size_t statement_base;                              /* Index of the first statement of the chunk in ctx */
+    int IC_base;                                        /* IC at the start of the chunk */
+    int DC_base;                                        /* DC at the start of the chunk */
+    AllocStats allocs;                                  /* Allocations of the task of the chunk (--stats) */
+    int failed;                                         /* Set if the chunk ran out of memory */
+} ParallelChunk;
+
+/* Chunks of a single pass shared with the worker threads */
+typedef struct {
+    AssemblerContext *ctx;
+    ParallelChunk *chunks;
+    int chunk_count;
+    int is_first_pass;                                  /* The chunks build their own statements */
+} ParallelJob;
+
+/* Returns the number of chunks to split count lines or statements into, less than 2 to stay serial */
+static int chunk_count(AssemblerContext *ctx, size_t count)
+{
+    size_t chunks = count / PARALLEL_MIN_CHUNK_LINES;
+    int threads = ctx->options ? ctx->options->threads : 0;
+
+    if (threads < 2)
+        return 0;
+
+    return chunks < (size_t)threads ? (int)chunks : threads;
+}
+
+/* Creates the chunks of a pass over count items, each with its own arena and lists */
+static int job_init(ParallelJob *job, AssemblerContext *ctx, int chunks, size_t count, int is_first_pass)
+{
+    int i;
+
+    job->ctx = ctx;
+    job->chunk_count = chunks;
+    job->is_first_pass = is_first_pass;
+    job->chunks = (ParallelChunk *)MALLOC(chunks * sizeof(ParallelChunk));
+    if (!job->chunks)
+        return 0;
+
+    memset(job->chunks, 0, chunks * sizeof(ParallelChunk));
+
+    for (i = 0; i < chunks; i++)
+    {
+        ParallelChunk *chunk = &job->chunks[i];
+
+        chunk->first = count * i / chunks;
+        chunk->last = count * (i + 1) / chunks;
+
+        chunk->local = *ctx;
+        chunk->local.stats.enabled = 0;
+        chunk->local.arena = arena_create(ARENA_BLOCK_SIZE);
+        chunk->local.externals = array_list_create(NULL);
+
+        /* Errors are never merged, the serial pass runs again and reports them - one is enough to stop the chunk */
+        chunk->local.errors = error_log_create(1);
+
+        if (is_first_pass)
+        {
+            chunk->local.statements = NULL;
+            chunk->local.statement_count = 0;
+            chunk->local.statement_capacity = 0;
+        }
+
+        if (!chunk->local.arena || !chunk->local.errors || !chunk->local.externals)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Releases the chunks - the arenas are merged into the context, so anything they hold stays valid */
+static void job_destroy(ParallelJob *job)
+{
+    int i;
+
+    if (!job->chunks)
+        return;
+
+    for (i = 0; i < job->chunk_count; i++)
+    {
+        ParallelChunk *chunk = &job->chunks[i];
+
+        if (chunk->local.arena)
+            arena_merge(job->ctx->arena, chunk->local.arena);
+        if (chunk->local.errors)
+            error_log_destroy(chunk->local.errors);
+        if (chunk->local.externals)
+            array_list_destroy(chunk->local.externals);
+        if (chunk->symbol_lines)
+            FREE(chunk->symbol_lines);
+        if (job->is_first_pass && chunk->local.statements)
+            FREE(chunk->local.statements);
+    }
+
+    FREE(job->chunks);
+    job->chunks = NULL;
+}
+
+/* Counts the allocations of the calling thread into its chunk, returns the statistics counted into before */
+static AllocStats *chunk_begin_allocs(ParallelChunk *chunk, AssemblerContext *ctx)
+{
+    AllocStats *allocs = stats_thread_allocs();
+
+    if (ctx->stats.enabled)
+        stats_set_thread_allocs(&chunk->allocs);
+
+    return allocs;
+}
+
+/* Adds the allocations of the chunk tasks to the statistics of the file - the tasks ran at the same time, so their peaks add up */
+static void job_count_allocs(ParallelJob *job)
+{
+    AllocStats *total = &job->ctx->stats.allocs;
+    long peak = total->bytes;
+    int i;
+
+    if (!job->ctx->stats.enabled)
+        return;
+
+    for (i = 0; i < job->chunk_count; i++)
+    {
+        AllocStats *allocs = &job->chunks[i].allocs;
+
+        total->allocs += allocs->allocs;
+        total->reallocs += allocs->reallocs;
+        total->frees += allocs->frees;
+        total->bytes += allocs->bytes;
+        peak += allocs->peak_bytes;
+    }
+
+    if (peak > total->peak_bytes)
+        total->peak_bytes = peak;
+}
+
+/* Records a line defining a symbol, with the chunk relative IC before the line */
+static void chunk_add_symbol_line(ParallelChunk *chunk, size_t line_number)
+{
+    SymbolLine *new_lines = NULL;
+    size_t new_capacity = 0;
+
+    if (chunk->symbol_count == chunk->symbol_capacity)
+    {
+        new_capacity = chunk->symbol_capacity ? chunk->symbol_capacity * ARRAY_LIST_GROWTH_FACTOR : ARRAY_LIST_INITIAL_CAPACITY;
+
+        new_lines = (SymbolLine *)REALLOC(chunk->symbol_lines, new_capacity * sizeof(SymbolLine));
+        if (!new_lines)
+        {
+            chunk->failed = 1;
+            return;
+        }
+
+        chunk->symbol_lines = new_lines;
+        chunk->symbol_capacity = new_capacity;
+    }
+
+    chunk->symbol_lines[chunk->symbol_count].line_number = line_number;
+    chunk->symbol_lines[chunk->symbol_count].IC = chunk->local.IC;
+    chunk->symbol_count++;
+}
+
+/* Worker task - tokenizes, parses and sizes the lines of a chunk, with IC and DC relative to the chunk */
+static void first_pass_chunk(void *arg, int index)
+{
+    ParallelJob *job = (ParallelJob *)arg;
+    ParallelChunk *chunk = &job->chunks[index];
+    AssemblerContext *local = &chunk->local;
+    AllocStats *allocs = chunk_begin_allocs(chunk, job->ctx);
+    Lexer lexer = {0};
+    ArrayList *tokens = NULL;
+
+    tokens = array_list_create(NULL);
+    if (!tokens)
+    {
+        chunk->failed = 1;
+        stats_set_thread_allocs(allocs);
+        return;
+    }
+
+    /* The chunk fills its own entries of the shared token line index, which is already sized for the file */
+    lexer_init(&lexer);
+    lexer.line_number = chunk->first;
+    local->token_line_count = chunk->first;
+    local->IC = 0;
+    local->DC = 0;
+
+    /* A chunk with an error is discarded anyway */
+    while (lexer.line_number < chunk->last && error_count(local->errors) == 0 && lexer_next_line(&lexer, local))
+    {
+        local->line_number = lexer.line_number;
+        lexer_tokenize_line(&lexer, local, tokens);
+
+        /* The symbol is defined later, once the address of the chunk is known */
+        if (is_label_statement(tokens) || is_entry_statement(tokens) || is_extern_statement(tokens))
+            chunk_add_symbol_line(chunk, lexer.line_number);
+
+        first_pass_statement(&lexer, local, tokens);
+
+        array_list_clear(tokens);
+    }
+
+    array_list_destroy(tokens);
+    stats_set_thread_allocs(allocs);
+}
+
+/* Worker task - moves the statements of a chunk into the context, shifted by the base addresses of the chunk */
+static void first_pass_place(void *arg, int index)
+{
+    ParallelJob *job = (ParallelJob *)arg;
+    ParallelChunk *chunk = &job->chunks[index];
+    Statement *statements = job->ctx->statements + chunk->statement_base;
+    size_t i;
+
+    for (i = 0; i < chunk->local.statement_count; i++)
+    {
+        statements[i] = chunk->local.statements[i];
+        statements[i].IC += chunk->IC_base;
+        statements[i].DC += chunk->DC_base;
+    }
+}
+
+/* Defines the symbols of all the chunks in line order, at the addresses known from the prefix sum */
+static void first_pass_define_symbols(ParallelJob *job)
+{
+    AssemblerContext *ctx = job->ctx;
+    ArrayList *tokens = NULL;
+    size_t i;
+    int c;
+
+    tokens = array_list_create(NULL);
+    if (!tokens)
+        return;
+
+    for (c = 0; c < job->chunk_count; c++)
+    {
+        ParallelChunk *chunk = &job->chunks[c];
+
+        for (i = 0; i < chunk->symbol_count; i++)
+        {
+            ctx->line_number = chunk->symbol_lines[i].line_number;
+            get_line(ctx, tokens);
+
+            ctx->line_number = chunk->symbol_lines[i].line_number;
+            ctx->IC = chunk->IC_base + chunk->symbol_lines[i].IC;
+            define_symbol(ctx, tokens);
+
+            array_list_clear(tokens);
+        }
+    }
+
+    array_list_destroy(tokens);
+}
+
+/* Undoes a parallel first pass, so the serial one starts from a clean context */
+static void first_pass_discard(AssemblerContext *ctx)
+{
+    error_log_clear(ctx->errors);
+    array_list_clear(ctx->entry_names);
+    array_list_clear(ctx->extern_names);
+    hash_map_clear(ctx->symbol_table);
+
+    ctx->token_line_count = 0;
+    ctx->statement_count = 0;
+    ctx->line_number = 0;
+    ctx->IC = INITIAL_IC;
+    ctx->DC = 0;
+}
+
+/* Runs the chunked first pass, returns 0 if it did not complete without errors */
+static int run_first_pass(ParallelJob *job, AssemblerContext *ctx, int chunks)
+{
+    Statement *new_statements = NULL;
+    size_t line_count = array_list_size(ctx->preprocessed_lines);
+    size_t statement_count = 0;
+    int IC = INITIAL_IC, DC = 0;
+    int i;
+
+    /* Size the token line index for the whole file before the chunks share it */
+    if (!lexer_index_line(ctx, line_count, NULL, 0))
+        return 0;
+
+    if (!job_init(job, ctx, chunks, line_count, 1))
+        return 0;
+
+    worker_pool_run(chunks, chunks, first_pass_chunk, NULL, job);
+    job_count_allocs(job);
+
+    for (i = 0; i < chunks; i++)
+        if (job->chunks[i].failed || error_count(job->chunks[i].local.errors) > 0)
+            return 0;
+
+    /* Exclusive prefix sum over the chunks - the base addresses of every chunk */
+    for (i = 0; i < chunks; i++)
+    {
+        ParallelChunk *chunk = &job->chunks[i];
+
+        chunk->statement_base = statement_count;
+        chunk->IC_base = IC;
+        chunk->DC_base = DC;
+
+        statement_count += chunk->local.statement_count;
+        IC += chunk->local.IC;
+        DC += chunk->local.DC;
+    }
+
+    if (statement_count > ctx->statement_capacity)
+    {
+        new_statements = (Statement *)REALLOC(ctx->statements, statement_count * sizeof(Statement));
+        if (!new_statements)
+            return 0;
+
+        ctx->statements = new_statements;
+        ctx->statement_capacity = statement_count;
+    }
+
+    /* Apply the base addresses to every statement in parallel */
+    worker_pool_run(chunks, chunks, first_pass_place, NULL, job);
+
+    ctx->statement_count = statement_count;
+    ctx->token_line_count = line_count;
+
+    first_pass_define_symbols(job);
+
+    ctx->line_number = line_count + 1;
+    ctx->IC = IC;
+    ctx->DC = DC;
+
+    return error_count(ctx->errors) == 0;
+}
+
+void parallel_first_pass(AssemblerContext *ctx)
+{
+    ParallelJob job = {0};
+    int chunks = 0;
+    int is_done = 0;
+
+    if (!ctx)
+        return;
+
+    chunks = chunk_count(ctx, array_list_size(ctx->preprocessed_lines));
+    if (chunks < 2)
+    {
+        first_pass(ctx);
+        return;
+    }
+
+    is_done = run_first_pass(&job, ctx, chunks);
+    job_destroy(&job);
+
+    /* Errors are reported in the order of the serial pass by running it again */
+    if (!is_done)
+    {
+        first_pass_discard(ctx);
+        first_pass(ctx);
+    }
+}
+
+/* Worker task - encodes the statements of a chunk into the shared image */
+static void second_pass_chunk(void *arg, int index)
+{
+    ParallelJob *job = (ParallelJob *)arg;
+    ParallelChunk *chunk = &job->chunks[index];
+    AllocStats *allocs = chunk_begin_allocs(chunk, job->ctx);
+
+    second_pass_statements(&chunk->local, chunk->first, chunk->last);
+    stats_set_thread_allocs(allocs);
+}
+
+void parallel_second_pass(AssemblerContext *ctx)
+{
+    ParallelJob job = {0};
+    unsigned int *new_image = NULL;
+    size_t words = 0;
+    size_t i;
+    int chunks = 0;
+    int c;
+
+    if (!ctx)
+        return;
+
+    chunks = chunk_count(ctx, ctx->statement_count);
+    words = ctx->IC > INITIAL_IC ? (size_t)(ctx->IC - INITIAL_IC) : 0;
+
+    /* Size the image for the whole file, so the chunks never reallocate it */
+    if (chunks >= 2 && words > ctx->image_capacity)
+    {
+        new_image = (unsigned int *)REALLOC(ctx->image, words * sizeof(unsigned int));
+        if (new_image)
+        {
+            ctx->image = new_image;
+            ctx->image_capacity = words;
+        }
+    }
+
+    if (chunks < 2 || words > ctx->image_capacity || !job_init(&job, ctx, chunks, ctx->statement_count, 0))
+    {
+        job_destroy(&job);
+        second_pass(ctx);
+        return;
+    }
+
+    /* Every chunk starts growing the image at its own first address, so the ranges never overlap */
+    for (c = 0; c < chunks; c++)
+        job.chunks[c].local.image_size = (size_t)(ctx->statements[job.chunks[c].first].IC - INITIAL_IC);
+
+    worker_pool_run(chunks, chunks, second_pass_chunk, NULL, &job);
+    job_count_allocs(&job);
+
+    /* Errors are reported in the order of the serial pass by running it again, the chunks only wrote into the image */
+    for (c = 0; c < chunks; c++)
+    {
+        if (error_count(job.chunks[c].local.errors) > 0)
+        {
+            job_destroy(&job);
+            second_pass(ctx);
+            return;
+        }
+    }
+
+    /* Merge the external references in statement order */
+    for (c = 0; c < chunks; c++)
+    {
+        AssemblerContext *local = &job.chunks[c].local;
+
+        for (i = 0; i < (size_t)array_list_size(local->externals); i++)
+            array_list_append(ctx->externals, array_list_get(local->externals, i));
+
+        /* A chunk only sets the size of the image if it wrote past its first address */
+        if (local->image_size > ctx->image_size &&
+            local->image_size > (size_t)(ctx->statements[job.chunks[c].first].IC - INITIAL_IC))
+            ctx->image_size = local->image_size;
+    }
+
+    ctx->line_number = job.chunks[chunks - 1].local.line_number;
+    job_destroy(&job);
+
+    if (error_count(ctx->errors) == 0)
+    {
+        collect_entries(ctx);
+        generate_output(ctx, 2);
+    }
+}
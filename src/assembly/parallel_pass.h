@@ -0,0 +1,39 @@
+/**
+ * @file parallel_pass.h
+ * @brief Header file for the intra-file parallel passes of the assembler (-t N).
+ * @details This file contains function prototypes for running the first and second pass of a single file on a
+ *          pool of worker threads. The preprocessed lines are split into contiguous chunks, and every chunk is
+ *          tokenized, parsed and sized on a shadow context of its own - the size of a statement only depends on
+ *          its own line. The chunk sizes are then turned into base addresses with a prefix sum over the chunks,
+ *          and the labels are defined in line order on the calling thread, once their addresses are known.
+ *          The second pass encodes disjoint ranges of statements into the shared image in parallel.
+ *
+ * Both passes produce exactly the outputs of first_pass() and second_pass(). Files too small to be split
+ * (less than PARALLEL_MIN_CHUNK_LINES lines per chunk) are assembled by the serial passes. A pass that
+ * reports any error is run again serially, so the diagnostics and the --max-errors limit are also identical.
+ * The allocations of the worker threads are counted into the statistics of the file (--stats).
+ */
+
+#ifndef PARALLEL_PASS_H
+#define PARALLEL_PASS_H
+
+#include "../main/assembler.h"
+
+#define PARALLEL_MIN_CHUNK_LINES 4096                   /* Minimum number of lines (or statements) per chunk */
+
+/**
+ * @brief Preforms the first pass of the assembler on up to options->threads worker threads.
+ * @param ctx Pointer to the assembler context.
+ * @note Leaves the context exactly as first_pass() does - the statements, the symbol table, IC and DC.
+ */
+void parallel_first_pass(AssemblerContext *ctx);
+
+/**
+ * @brief Preforms the second pass of the assembler on up to options->threads worker threads.
+ * @param ctx Pointer to the assembler context.
+ * @note The external references are merged in statement order, a pass with errors is run again by second_pass().
+ *       If assembly is successful, generates the output files (.ob, .ent, .ext).
+ */
+void parallel_second_pass(AssemblerContext *ctx);
+
+#endif /* PARALLEL_PASS_H */
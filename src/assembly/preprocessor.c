@@ -23,6 +23,12 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Free function for the macro table - a macro body is a list of its lines */
+static void free_macro_body(void *body)
+{
+    array_list_destroy((ArrayList *)body);
+}
+
 void preprocessor_init(Preprocessor *pp)
 {
     if (!pp)
@@ -30,11 +36,11 @@ void preprocessor_init(Preprocessor *pp)
 
     memset(pp, 0, sizeof(Preprocessor));
 
-    pp->current_macro = array_list_create(free_string);
+    pp->current_macro = array_list_create(NULL);
     if (!pp->current_macro) 
         return;
 
-    pp->macros = hash_map_create(free_string);
+    pp->macros = hash_map_create(free_macro_body);
     if (!pp->macros) 
     {
         array_list_destroy(pp->current_macro);
@@ -50,11 +56,7 @@ void preprocessor_destroy(Preprocessor *pp)
     if (!pp)
         return;
 
-    if (pp->raw_lines) 
-    {
-        array_list_destroy(pp->raw_lines);
-        pp->raw_lines = NULL;
-    }
+    file_source_destroy(&pp->raw_lines);
 
     if (pp->current_macro) 
     {
@@ -71,14 +73,19 @@ void preprocessor_destroy(Preprocessor *pp)
 
 int next_line(Preprocessor *pp, AssemblerContext *ctx)
 {
-    if (!pp || !pp->raw_lines)
+    if (!pp || (!pp->raw_lines.buffer && !pp->reader))
         return 0;
 
     /* Check if reached EOF */
-    if (pp->line_number >= array_list_size(pp->raw_lines))
+    if (pp->reader)
+    {
+        if (!source_reader_next(pp->reader, &pp->current_line))
+            return 0;
+    }
+    else if (pp->line_number >= pp->raw_lines.line_count)
         return 0;
-
-    pp->current_line = sv_from_str(array_list_get(pp->raw_lines, pp->line_number));
+    else
+        pp->current_line = pp->raw_lines.lines[pp->line_number];
 
     /* Check for valid line length */
     if (pp->current_line.length > MAX_LINE_LEN) 
@@ -185,11 +192,11 @@ int validate_macro(Preprocessor *pp, AssemblerContext *ctx, char *macro_def, cha
         }
 
     /* Check if name conflicts with instruction name */
-    if (find_instruction(sv.str) != NULL) 
+    if (find_instruction(sv) != NULL) 
         error_report(ctx->errors, ERR_MCRO_NAME, "%s:%d: Macro name conflicts with instruction name: '%s'", ctx->filename, DEF_LINE(pp), *macro_name_out);
 
     /* Check if name conflicts with register name */
-    else if (find_register(sv.str) != NULL)
+    else if (find_register(sv) != NULL)
         error_report(ctx->errors, ERR_MCRO_NAME, "%s:%d: Macro name conflicts with register name: '%s'", ctx->filename, DEF_LINE(pp), *macro_name_out);
 
     
@@ -201,14 +208,13 @@ int validate_macro(Preprocessor *pp, AssemblerContext *ctx, char *macro_def, cha
     else if (sv_ends_with(sv, ":")) 
         error_report(ctx->errors, ERR_MCRO_NAME, "%s:%d: Macro name may conflictswith label name: '%s'", ctx->filename, DEF_LINE(pp), *macro_name_out);
 
-    return array_list_size(ctx->errors) == 0 ? 1 : 0;
+    return error_count(ctx->errors) == 0 ? 1 : 0;
 }
 
 void define_macro(Preprocessor *pp, AssemblerContext *ctx)
 {
     char *macro_def = NULL;
     char *macro_name = NULL;
-    char *macro_body = NULL;
     char *macro_end = NULL;
     int is_valid = 0;
 
@@ -222,130 +228,164 @@ void define_macro(Preprocessor *pp, AssemblerContext *ctx)
     /* Validate the macro */
     is_valid = validate_macro(pp, ctx, macro_def, macro_end, &macro_name);
     
-    /* Create and store the macro body if valid */
-    macro_body = array_list_to_str(pp->current_macro);
-    if (macro_body) 
+    /* Store the body lines as they are if valid - the table takes the list and a new one collects the next macro */
+    if (is_valid) 
     {
-        if (is_valid) 
-            hash_map_put(pp->macros, macro_name, macro_body);
-        else 
-            FREE(macro_body);
+        hash_map_put(pp->macros, macro_name, pp->current_macro);
+        pp->current_macro = array_list_create(NULL);
     }
+    else
+        array_list_clear(pp->current_macro);
+}
 
-    /* Clean up */
-    FREE(macro_def);
-    FREE(macro_end);
-    array_list_clear(pp->current_macro);
+/* Normalizes the current line in place and returns it - a line of the reader is copied first, its block is reused */
+static char *keep_line(Preprocessor *pp, AssemblerContext *ctx)
+{
+    char *line = pp->reader ? ARENA_STRDUP(ctx->arena, pp->current_line.str) : pp->current_line.str;
+
+    if (line)
+        str_normalize(line);
+
+    return line;
+}
+
+/* Keeps a preprocessed line in the context, or hands it to the sink */
+static void emit_line(Preprocessor *pp, AssemblerContext *ctx, char *line, int is_source)
+{
+    /* A source line is normalized where it is, a macro line was normalized when the macro was defined */
+    if (is_source)
+        str_normalize(line);
+
+    if (pp->sink)
+        pp->sink(ctx, line, pp->sink_arg);
+    else
+        array_list_append(ctx->preprocessed_lines, line);
 }
 
 void expand_macro(Preprocessor *pp, AssemblerContext *ctx, const char *macro_name)
 {
-    char *macro_body = NULL;
-    char *tmp_body = NULL;
-    char *line = NULL;
-    char *token = NULL;
-    const char newline_delim = '\n';
+    ArrayList *macro_body = NULL;
+    size_t i;
 
     if (!pp || !macro_name || !ctx)
         return;
 
     /* Check if the macro exists */
-    macro_body = hash_map_get(pp->macros, macro_name);
+    macro_body = (ArrayList *)hash_map_get(pp->macros, macro_name);
     if (!macro_body)
         return;
 
-    /* Create a copy of the macro body */
-    tmp_body = STRDUP(macro_body);
-    if (!tmp_body)
-        return;
-    
-    /* Split by newlines and add each line to preprocessed_lines */
-    line = tmp_body;
-    token = strchr(line, newline_delim);
-    
-    while (token != NULL) 
-    {
-        *token = '\0';  /* Replace newline with null terminator */
-        array_list_append(ctx->preprocessed_lines, STRDUP(line));
-        line = token + 1;  /* Move to character after newline */
-        token = strchr(line, newline_delim);
-    }
-    
-    /* Add the last line if it exists */
-    if (*line != '\0') 
-        array_list_append(ctx->preprocessed_lines, STRDUP(line));
-    
-    FREE(tmp_body);
+    /* The body is already split and normalized - the passes never write into their lines, so every expansion shares them */
+    for (i = 0; i < array_list_size(macro_body); i++)
+        emit_line(pp, ctx, (char *)array_list_get(macro_body, i), 0);
 }
 
-void preprocess(AssemblerContext *ctx) 
+/* Runs the preprocessor over all the lines of its source */
+static void preprocess_lines(Preprocessor *pp, AssemblerContext *ctx)
 {
-    Preprocessor pp;
-
-    if (!ctx)
-        return;
-
-    /* Initialize the preprocessor */
-    preprocessor_init(&pp);
-
-    /* Read the file into raw_lines */
-    pp.raw_lines = file_read_lines(ctx->filename);
-
-    if (!pp.raw_lines) 
-    {
-        error_report(ctx->errors, ERR_FILE_READ, "Failed to read file: %s", ctx->filename);
-        preprocessor_destroy(&pp);
-        return;
-    }
-
     /* Process each line */
-    while (next_line(&pp, ctx))
+    while (!error_limit_reached(ctx->errors) && next_line(pp, ctx))
     {
         /* Skip empty lines and comments */
-        if (is_empty_line(pp.current_line) || is_comment(pp.current_line))
+        if (is_empty_line(pp->current_line) || is_comment(pp->current_line))
             continue;
 
-        switch (pp.state)
+        switch (pp->state)
         {
             /* Default state - process lines normally */
             case STATE_DEFAULT:
                 /* Check for macro definition or call */
-                if (is_macro_def(pp.current_line))
+                if (is_macro_def(pp->current_line))
                 {
-                    pp.state = STATE_MACRO;
-                    array_list_append(pp.current_macro, STRDUP_NORM(pp.current_line.str));
+                    pp->state = STATE_MACRO;
+                    array_list_append(pp->current_macro, keep_line(pp, ctx));
                     continue;
                 }
                 
-                if (is_macro_call(&pp, pp.current_line.str))
+                if (is_macro_call(pp, pp->current_line.str))
                 {
-                    expand_macro(&pp, ctx, pp.current_line.str);
+                    expand_macro(pp, ctx, pp->current_line.str);
                     continue;
                 }
 
                 /* Add the line to preprocessed lines */
-                array_list_append(ctx->preprocessed_lines, STRDUP_NORM(pp.current_line.str));
+                emit_line(pp, ctx, pp->current_line.str, 1);
                 break;
                 
             /* Macro state - process macro lines */
             case STATE_MACRO:
                 /* Check for macro end or continue adding lines */
-                if (is_macro_end(pp.current_line))
+                if (is_macro_end(pp->current_line))
                 {
-                    pp.state = STATE_DEFAULT;
-                    array_list_append(pp.current_macro, STRDUP_NORM(pp.current_line.str));
-                    define_macro(&pp, ctx);
+                    pp->state = STATE_DEFAULT;
+                    array_list_append(pp->current_macro, keep_line(pp, ctx));
+                    define_macro(pp, ctx);
                     continue;
                 }
-                array_list_append(pp.current_macro, STRDUP_NORM(pp.current_line.str));
+                array_list_append(pp->current_macro, keep_line(pp, ctx));
                 continue;
         }
     }
+}
+
+void preprocess(AssemblerContext *ctx) 
+{
+    Preprocessor pp;
+
+    if (!ctx)
+        return;
+
+    /* Initialize the preprocessor */
+    preprocessor_init(&pp);
+
+    /* Read the file (or the in-memory source) into raw_lines */
+    if (ctx->source ? !file_source_from_buffer(ctx->source, ctx->source_size, &pp.raw_lines) 
+                    : !file_read_source(ctx->filename, &pp.raw_lines)) 
+    {
+        error_report(ctx->errors, ERR_FILE_READ, "Failed to read file: %s", ctx->filename);
+        preprocessor_destroy(&pp);
+        return;
+    }
+
+    preprocess_lines(&pp, ctx);
+
+    /* The preprocessed lines point into the source buffer, the context keeps it */
+    if (ctx->line_buffer)
+        FREE(ctx->line_buffer);
+    ctx->line_buffer = pp.raw_lines.buffer;
+    pp.raw_lines.buffer = NULL;
 
     /* If no errors - generate IR file */
-    if (array_list_size(ctx->errors) == 0)
+    if (error_count(ctx->errors) == 0)
         generate_output(ctx, 0);
 
     /* Clean up */
     preprocessor_destroy(&pp);
-}
\ No newline at end of file
+}
+
+void preprocess_stream(AssemblerContext *ctx, PreprocessorSink sink, void *arg)
+{
+    Preprocessor pp;
+    SourceReader reader;
+
+    if (!ctx || !sink || !ctx->line_arena)
+        return;
+
+    preprocessor_init(&pp);
+
+    if (!source_reader_open(&reader, ctx->filename, ctx->source, ctx->source_size))
+    {
+        error_report(ctx->errors, ERR_FILE_READ, "Failed to read file: %s", ctx->filename);
+        preprocessor_destroy(&pp);
+        return;
+    }
+
+    pp.reader = &reader;
+    pp.sink = sink;
+    pp.sink_arg = arg;
+
+    preprocess_lines(&pp, ctx);
+
+    source_reader_close(&reader);
+    preprocessor_destroy(&pp);
+}
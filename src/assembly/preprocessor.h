@@ -12,6 +12,7 @@
 
 #include "../main/assembler.h"
 #include "../common/string_view.h"
+#include "../common/file_io.h"
 
 #define MAX_LINE_LEN 81
 #define MAX_MCRO_NAME_LEN 31
@@ -25,6 +26,9 @@
 #define DEF_LINE(pp)                                            \
     pp->line_number - array_list_size(pp->current_macro) - 1
 
+/* Receives every preprocessed line of a streaming preprocessor, the line is only valid during the call */
+typedef void (*PreprocessorSink)(AssemblerContext *ctx, char *line, void *arg);
+
 /* Preprocessor state */
 typedef enum {
     STATE_DEFAULT,
@@ -32,12 +36,15 @@ typedef enum {
 } PreprocessorState;
 
 typedef struct {
-    ArrayList *raw_lines;                   /* Array of raw lines as read from the input file */
+    SourceFile raw_lines;                   /* Raw lines as read from the input file */
     StringView current_line;                /* Current line being processed */
     size_t line_number;                     /* Current line number in the raw lines */
     PreprocessorState state;                /* Current state of the preprocessor */
     ArrayList *current_macro;               /* Array of lines in the current macro */
-    HashMap *macros;                        /* Macro table */
+    HashMap *macros;                        /* Macro table - name to an ArrayList of the body lines */
+    SourceReader *reader;                   /* Source read a line at a time, NULL if it is read into raw_lines */
+    PreprocessorSink sink;                  /* Receives the preprocessed lines, NULL to keep them in the context */
+    void *sink_arg;                         /* Argument of the sink */
 } Preprocessor;
 
 /**
@@ -115,7 +122,7 @@ int validate_macro(Preprocessor *pp, AssemblerContext *ctx, char *macro_def, cha
  * @param pp Pointer to the Preprocessor structure. 
  * @param ctx Pointer to the AssemblerContext structure.
  * @note This function extracts the macro name and body from the current macro and stores it in the macro table.
- * @note The macro name is validated and the macro body is stored in the hash map.
+ * @note The macro name is validated and the macro body is stored in the hash map as the list of its normalized lines.
  */
 void define_macro(Preprocessor *pp, AssemblerContext *ctx);
 
@@ -125,6 +132,9 @@ void define_macro(Preprocessor *pp, AssemblerContext *ctx);
  * @param ctx Pointer to the AssemblerContext structure.
  * @param macro_name The name of the macro to expand.
  * @note This function retrieves the macro body from the macro table and replaces the macro name with its body in the preprocessed lines.
+ * @note The lines of the body are appended as they are - the passes never write into the preprocessed lines, so every
+ *       expansion shares them and the body is never re-split or copied.
+ * @note With a sink every line of the body is handed to the sink instead.
  */
 void expand_macro(Preprocessor *pp, AssemblerContext *ctx, const char *macro_name);
 
@@ -132,8 +142,20 @@ void expand_macro(Preprocessor *pp, AssemblerContext *ctx, const char *macro_nam
  * @brief Preprocesses the source file by removing empty lines, comments, and expanding macros.
  * @param ctx Pointer to the AssemblerContext structure.
  * @note This functions updates the preprocessed lines field of the context with the processed lines so that they can be used in the first pass.
+ * @note The lines are normalized in place in the source buffer, which the context keeps (ctx->line_buffer) - nothing is
+ *       copied, the lines of a macro expansion are the lines of its body.
  */
 
 void preprocess(AssemblerContext *ctx);
 
+/**
+ * @brief Preprocesses the source file a line at a time, handing every preprocessed line to a sink (--stream).
+ * @param ctx Pointer to the AssemblerContext structure.
+ * @param sink The function receiving the lines, in order.
+ * @param arg The argument passed to the sink.
+ * @note The source is read a block at a time and a line is handed to the sink where it is in the block (a line of
+ *       a macro expansion where its body is kept), so neither the raw nor the preprocessed lines are kept. No IR file is generated - the sink writes it.
+ */
+void preprocess_stream(AssemblerContext *ctx, PreprocessorSink sink, void *arg);
+
 #endif /* PREPROCESSOR_H */
\ No newline at end of file
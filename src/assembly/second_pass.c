@@ -4,7 +4,8 @@
  * @details This file contains functions for the second pass of the assembler,
  *          which includes translating instructions and directives into machine code,
  *          resolving symbols, and generating output files (.ob, .ent, .ext) (if assembly is successful).
- *          The second pass also collects entry and external symbols if encountered.
+ *          The second pass also logs the references to external symbols, and resolves the entry symbols
+ *          once all the statements are encoded.
  */
 
 #include "./second_pass.h"
@@ -24,107 +25,47 @@
 
 void get_line(AssemblerContext *ctx, ArrayList *tokens)
 {
-    size_t current_line_number = 0;
+    TokenLine *span = NULL;
     size_t i = 0;
-    Token *token = NULL;
 
     if (!ctx || !tokens)
         return;
 
-    current_line_number = ctx->line_number;
-
-    /* Add the tokens from the current line to the tokens list */
-    while (i < array_list_size(ctx->tokens))
+    /* Add the tokens from the current line to the tokens list using the token line index */
+    if (ctx->line_number >= 1 && ctx->line_number <= ctx->token_line_count)
     {
-        token = (Token *)array_list_get(ctx->tokens, i);
-        
-        /* Check if the token belongs to the current line */
-        if (token->line_number < current_line_number)
-        {
-            i++;
-            continue;
-        }
-        
-        /* If the token is from a different line, break the loop */
-        if (token->line_number > current_line_number)
-            break;
-            
-        array_list_append(tokens, token);
-        i++;
+        span = &ctx->token_lines[ctx->line_number - 1];
+
+        for (i = 0; i < span->count; i++)
+            array_list_append(tokens, &span->tokens[i]);
     }
     
     ctx->line_number++;
 }
 
-void process_token(Token *token, AssemblerContext *ctx, int address, int is_extern)
+void process_token(Token *token, AssemblerContext *ctx, int address)
 {
     Symbol *symbol = NULL;
-    char *str = NULL;
-    size_t i = 0;
-    ArrayList *names_list = NULL;
-    ArrayList *target_list = NULL;
-    
+
     if (!token || !ctx)
         return;
-    
-    /* Set the names list and target list based on whether it's extern or entry */
-    names_list = is_extern ? ctx->extern_names : ctx->entry_names;
-    target_list = is_extern ? ctx->externals : ctx->entries;
-    
-    /* Get the string representation of the token */
-    str = token->sv.str;
-    str[token->sv.length] = '\0';
-    
-    /* Check if the symbol already exists in the symbol table */
-    for (i = 0; i < array_list_size(names_list); i++)
-    {
-        Symbol *list_symbol = (Symbol *)array_list_get(names_list, i);
-        if (strcmp(str, list_symbol->sv.str) == 0)
-        {
-            Symbol *symbol_copy = NULL;
-            symbol = (Symbol *)hash_map_get(ctx->symbol_table, str);
 
-            if (!symbol)
-                return;
+    /* Externals are flagged in the symbol table, so the lookup is all it takes */
+    symbol = (Symbol *)hash_map_get_sv(ctx->symbol_table, token_sv(token));
 
-            /* For entries, use the address from the symbol table.
-               For externals, use the address calculated during the second pass */
-            symbol_copy = symbol_create(token->sv, 
-                                      is_extern ? address : symbol->address, 
-                                      0, 1);
-
-            array_list_append(target_list, symbol_copy);
-            break;
-        }
-    }
+    /* Every reference to an external is logged at the address of its word */
+    if (symbol && symbol->external)
+        array_list_append(ctx->externals, symbol_create(ctx->arena, token_sv(token), address, 0, 1));
 }
 
-void log_symbol(ParsedInstruction *instruction, AssemblerContext *ctx, int IC, int is_externs, int is_entries)
+void log_symbol(ParsedInstruction *instruction, AssemblerContext *ctx, int IC)
 {
     if (!instruction || !ctx)
         return;
 
-    /* Process label if present */
-    if (is_label_statement(instruction->tokens))
-    {
-        Token *label = (Token *)array_list_get(instruction->tokens, 0);
-        
-        if (is_externs)
-            process_token(label, ctx, IC, 1);
-            
-        if (is_entries)
-            process_token(label, ctx, IC, 0);
-    }
-
     /* Process source register operand if it's an identifier */
     if (instruction->rs && instruction->rs->type == TOKEN_IDENTIFIER)
-    {
-        if (is_externs)
-            process_token(instruction->rs, ctx, IC + 1, 1);
-            
-        if (is_entries)
-            process_token(instruction->rs, ctx, IC + 1, 0);
-    }
+        process_token(instruction->rs, ctx, IC + 1);
 
     /* Process target register operand if it's an identifier */
     if (instruction->rt && instruction->rt->type == TOKEN_IDENTIFIER)
@@ -136,78 +77,111 @@ void log_symbol(ParsedInstruction *instruction, AssemblerContext *ctx, int IC, i
                                instruction->rs->type == TOKEN_IDENTIFIER))
             rt_position = IC + 2;
             
-        if (is_externs)
-            process_token(instruction->rt, ctx, rt_position, 1);
-            
-        if (is_entries)
-            process_token(instruction->rt, ctx, rt_position, 0);
+        process_token(instruction->rt, ctx, rt_position);
+    }
+}
+
+void collect_entries(AssemblerContext *ctx)
+{
+    Symbol *entry = NULL;
+    Symbol *symbol = NULL;
+    size_t i = 0;
+
+    if (!ctx)
+        return;
+
+    /* One walk over the .entry declarations, in order, resolving each against the symbol table */
+    for (i = 0; i < array_list_size(ctx->entry_names); i++)
+    {
+        entry = (Symbol *)array_list_get(ctx->entry_names, i);
+        symbol = (Symbol *)hash_map_get_sv(ctx->symbol_table, entry->sv);
+
+        /* Entries of undefined symbols are skipped, repeated declarations are listed once */
+        if (!symbol || symbol->external || symbol->entry)
+            continue;
+
+        symbol->entry = 1;
+        entry->address = symbol->address;
+        array_list_append(ctx->entries, entry);
     }
 }
 
 
-void second_pass(AssemblerContext *ctx)
+void second_pass_statements(AssemblerContext *ctx, size_t first, size_t last)
 {
-    ParsedInstruction instruction = {0};
-    ParsedDirective directive = {0};
+    Statement *statement = NULL;
+    ParsedInstruction *instruction = NULL;
     ArrayList *line = NULL;
-    size_t max_line_number = 0;
-    int IC = 100;
+    size_t i = 0;
+    int IC = 0;
     int DC = 0;
     int is_externs = 0;
-    int is_entries = 0;
+
+    if (!ctx)
+        return;
 
     line = array_list_create(NULL);
 
     if (!line)
         return;
 
-    /* Initialize the line number and get the maximum line number */
-    max_line_number = ((Token *)array_list_get(ctx->tokens, array_list_size(ctx->tokens) - 1))->line_number + 1;
-    ctx->line_number = 1;
-
-    /* Check if there are any entries or externals */
-    if (array_list_size(ctx->entry_names))
-        is_entries = 1;
-    
+    /* Check if there are any externals */
     if (array_list_size(ctx->extern_names))
         is_externs = 1;
     
-    /* Process each line until the maximum line number is reached */
-    while (ctx->line_number <= max_line_number)
+    /* Encode each statement parsed in the first pass */
+    for (i = first; i < last && i < ctx->statement_count && !error_limit_reached(ctx->errors); i++)
     {
-        /* Get the tokens for the current line */
+        statement = &ctx->statements[i];
+
+        /* Get the tokens of the statement's line */
+        ctx->line_number = statement->line_number;
         get_line(ctx, line);
 
+        /* Addresses were already assigned in the first pass */
+        IC = statement->IC;
+        DC = statement->DC;
+
         /* Instruction statement */
-        if (is_instruction_statement(line))
+        if (statement->type == STATEMENT_INSTRUCTION)
         {
-            parse_instruction(&instruction, line, ctx, 2);
+            instruction = &statement->as.instruction;
+            instruction->tokens = line;
 
-            /* If one of the operands is an identifier - check if entry or extern */
-            if ((instruction.rs && instruction.rs->type == TOKEN_IDENTIFIER) || 
-                (instruction.rt && instruction.rt->type == TOKEN_IDENTIFIER) || 
-                (is_label_statement(line)))
-            {
-                log_symbol(&instruction, ctx, IC, is_externs, is_entries);
-            }
+            /* Log the references to externals */
+            if (is_externs)
+                log_symbol(instruction, ctx, IC);
 
             /* Translate the instruction */
-            encode_instruction(&instruction, ctx, &IC);
+            encode_instruction(instruction, ctx, &IC);
+            instruction->tokens = NULL;
         }
 
         /* Directive statement */
-        if (is_directive_statement(line))
+        else if (statement->type == STATEMENT_DIRECTIVE)
         {
-            parse_directive(&directive, line, ctx);
-            encode_data(&directive, ctx, &IC, &DC);
+            statement->as.directive.tokens = line;
+            encode_data(&statement->as.directive, ctx, &IC, &DC);
+            statement->as.directive.tokens = NULL;
         }
     
         array_list_clear(line);
     }
 
+    array_list_destroy(line);
+}
+
+void second_pass(AssemblerContext *ctx)
+{
+    if (!ctx)
+        return;
+
+    second_pass_statements(ctx, 0, ctx->statement_count);
+
     /* Check if there are any errors */
-    if (array_list_size(ctx->errors) == 0)
+    if (error_count(ctx->errors) == 0)
+    {
+        collect_entries(ctx);
         generate_output(ctx, 2);
-
-    array_list_destroy(line);
-}
\ No newline at end of file
+    }
+}
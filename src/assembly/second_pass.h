@@ -12,34 +12,51 @@
 #include "../main/assembler.h"
 #include "../common/code_gen.h"
 /**
- * @brief Gets the tokens of the current line from the assembler context.
+ * @brief Gets the tokens of the current line from the assembler context using the token line index.
  * @param ctx Pointer to the assembler context.
  * @param tokens Pointer to the array list to store the tokens.
  */
 void get_line(AssemblerContext *ctx, ArrayList *tokens);
 
 /**
- * @brief Checks if a token is an identifier referenced as extern or entry, and if so stores the reference in the appropriate list.
+ * @brief Checks if a token references an external symbol, and if so stores the reference in ctx->externals.
  * @param token Pointer to the token to check.
  * @param ctx Pointer to the assembler context.
- * @param address The address of the token.
- * @param is_extern Flag indicating if the token is an extern reference.
+ * @param address The address of the word referencing the symbol.
+ * @note The symbol table entry of an external is flagged by the first pass, so the check is a single lookup.
  */
-void process_token(Token *token, AssemblerContext *ctx, int address, int is_extern);
+void process_token(Token *token, AssemblerContext *ctx, int address);
 
 /**
- * @brief Logs a symbol to the appropriate list based on its type (extern or entry).
+ * @brief Logs the references to external symbols made by the operands of an instruction.
  * @param instruction Pointer to the parsed instruction.
  * @param ctx Pointer to the assembler context.
  * @param IC The instruction counter.
- * @param is_externs Flag indicating if the symbol is an extern reference.
- * @param is_entries Flag indicating if the symbol is an entry reference.
  */
-void log_symbol(ParsedInstruction *instruction, AssemblerContext *ctx, int IC, int is_externs, int is_entries);
+void log_symbol(ParsedInstruction *instruction, AssemblerContext *ctx, int IC);
+
+/**
+ * @brief Resolves the .entry declarations against the symbol table and builds ctx->entries.
+ * @param ctx Pointer to the assembler context.
+ * @note Each defined entry is flagged in the symbol table and listed once, in the order of the declarations.
+ *       Declarations of undefined or external symbols are skipped.
+ */
+void collect_entries(AssemblerContext *ctx);
+
+/**
+ * @brief Encodes a range of the statements parsed in the first pass.
+ * @param ctx Pointer to the assembler context.
+ * @param first Index of the first statement to encode.
+ * @param last Index after the last statement to encode.
+ * @note The words are written at the addresses assigned by the first pass, so disjoint ranges can be encoded
+ *       independently. The external references are logged in ctx->externals in statement order.
+ */
+void second_pass_statements(AssemblerContext *ctx, size_t first, size_t last);
 
 /**
  * @brief Preforms the second pass of the assembler - Translating instructions and directives into machine code.
  * @param ctx Pointer to the assembler context.
+ * @note The statements parsed in the first pass are encoded directly, without re-parsing their lines.
  * @note If assembly is successful, generates the output files (.ob, .ent, .ext).
  */
 
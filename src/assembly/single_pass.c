@@ -0,0 +1,143 @@
+/**
+ * @file single_pass.c
+ * @brief Implementation of the single pass engine of the assembler.
+ * @details This file contains the single pass engine, which performs the work of the first and second pass
+ *          in one walk over the preprocessed lines. Instructions and directives are encoded as soon as they are parsed,
+ *          while every symbol reference is recorded as a fixup, to be patched after the last line once all
+ *          the symbols are known.
+ */
+
+#include "./single_pass.h"
+#include "./first_pass.h"
+#include "./second_pass.h"
+#include "../common/code_gen.h"
+#include "../common/lexer.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/parser.h"
+#include "../data_structures/array_list.h"
+
+#include <stdio.h>
+
+void resolve_fixups(AssemblerContext *ctx)
+{
+    size_t i = 0;
+    Fixup *fixup = NULL;
+    Word *word = NULL;
+    int is_externs = 0;
+
+    if (!ctx || !ctx->fixups)
+        return;
+
+    /* Check if there are any externals */
+    if (array_list_size(ctx->extern_names))
+        is_externs = 1;
+
+    for (i = 0; i < array_list_size(ctx->fixups); i++)
+    {
+        fixup = (Fixup *)array_list_get(ctx->fixups, i);
+
+        /* Log the reference if it's an extern */
+        if (is_externs)
+            process_token(fixup->operand, ctx, fixup->address);
+
+        word = &ctx->image[fixup->word_index];
+        encode_symbol(fixup->operand, ctx, word, fixup->add_mode, fixup->address);
+    }
+}
+
+void single_pass(AssemblerContext *ctx)
+{
+    Lexer lexer = {0};
+    ArrayList *tokens = NULL;
+    ParsedInstruction instruction = {0};
+    ParsedDirective directive = {0};
+    int is_instruction = 0;
+    int is_directive = 0;
+    int IC = 0;
+    int DC = 0;
+   
+    if (!ctx)
+        return;
+
+    /* Symbol references are deferred as long as the fixups list exists */
+    ctx->fixups = array_list_create(NULL);
+    if (!ctx->fixups)
+        return;
+
+    lexer_init(&lexer);
+        
+    tokens = array_list_create(NULL);
+    if (!tokens)
+        return;
+
+    ctx->line_number = 1;
+    
+    /* Iterate through each line of the file */
+    while (!error_limit_reached(ctx->errors) && lexer_next_line(&lexer, ctx))
+    {
+        /* Tokenize the current line */
+        lexer_tokenize_line(&lexer, ctx, tokens);
+
+        /* If a new symbol is encountered, define it */
+        if (is_label_statement(tokens) || is_entry_statement(tokens) || is_extern_statement(tokens))
+            define_symbol(ctx, tokens);
+        
+        /* If its an instruction parse it, encode it and update IC */
+        if ((is_instruction = is_instruction_statement(tokens)))
+        {
+            parse_instruction(&instruction, tokens, ctx, 1);
+
+            /* Encode only while the file is error free, the output is discarded otherwise */
+            if (error_count(ctx->errors) == 0)
+            {
+                IC = ctx->IC;
+                encode_instruction(&instruction, ctx, &IC);
+            }
+
+            ctx->IC += instruction.code_word_count;
+        }
+
+        /* If its a directive parse it, encode it and update DC */
+        if ((is_directive = is_directive_statement(tokens)))
+        {
+            parse_directive(&directive, tokens, ctx);
+
+            if (error_count(ctx->errors) == 0)
+            {
+                IC = ctx->IC;
+                DC = ctx->DC;
+                encode_data(&directive, ctx, &IC, &DC);
+            }
+
+            ctx->DC += directive.code_word_count;
+            ctx->IC += directive.code_word_count;
+        }
+
+        /* If the statement is neither an instruction nor a directive, report an error */
+        if (!is_instruction && !is_directive)
+            error_report(ctx->errors, ERR_INVALID_STATEMENT, "%s:%d: Invalid statement: '%.*s'", 
+                         ctx->ir_filename, lexer.line_number, (int)lexer.current_line.length, lexer.current_line.str); 
+
+        /* Clear for next line */
+        array_list_clear(tokens);
+
+        /* Update Line number and reset flags */
+        ctx->line_number++;
+        is_instruction = is_directive = 0;
+    }
+
+    /* Resolve the symbol references and the entries now that all the symbols are defined */
+    if (error_count(ctx->errors) == 0)
+    {
+        resolve_fixups(ctx);
+        collect_entries(ctx);
+    }
+
+    /* Check if there are any errors */
+    if (error_count(ctx->errors) == 0)
+        generate_output(ctx, 2);
+    
+    /* Clean up */
+    array_list_destroy(tokens);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file single_pass.h
+ * @brief Header file for the single pass engine of the assembler.
+ * @details This file contains function prototypes for the single pass engine, an alternative to the first and second pass.
+ *          The single pass engine builds the symbol table and encodes every statement while reading the lines only once.
+ *          Symbol references are recorded as fixups and patched in one sweep once the whole file was read,
+ *          which also takes care of forward references and of the entry and extern logging.
+ *          The two pass pipeline (first_pass() and second_pass()) remains the reference implementation.
+ */
+
+#ifndef SINGLE_PASS_H
+#define SINGLE_PASS_H
+
+#include "../main/assembler.h"
+
+/**
+ * @brief Resolves all the fixups recorded during the single pass.
+ * @param ctx Pointer to the assembler context.
+ * @note Patches the referenced words in the code image and logs the extern references
+ *       in the same order as the second pass does.
+ */
+void resolve_fixups(AssemblerContext *ctx);
+
+/**
+ * @brief Preforms the single pass of the assembler - Parsing, building the symbol table, encoding and resolving symbols.
+ * @param ctx Pointer to the assembler context.
+ * @note If assembly is successful, generates the output files (.ob, .ent, .ext).
+ */
+void single_pass(AssemblerContext *ctx);
+
+#endif /* SINGLE_PASS_H */
@@ -0,0 +1,244 @@
+/**
+ * @file stream_pass.c
+ * @brief Implementation of the streaming first pass of the assembler.
+ * @details This file contains the sink the streaming preprocessor hands every preprocessed line to. The sink writes
+ *          the line to the IR file, tokenizes and parses it on the line arena, and either encodes the statement or
+ *          moves the line to the context's arena for the second pass.
+ */
+
+#include "./stream_pass.h"
+#include "./first_pass.h"
+#include "./preprocessor.h"
+#include "../common/code_gen.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/lexer.h"
+#include "../common/parser.h"
+#include "../common/util.h"
+
+#include <string.h>
+
+/* State of the first pass over the streamed lines */
+typedef struct {
+    Lexer lexer;                                        /* Lexer fed with the streamed lines */
+    ArrayList *tokens;                                  /* Tokens of the current line */
+    ErrorLog *pass_errors;                              /* Errors of the first pass, reported if the preprocessor reports none */
+    OutputStream ir;                                    /* The IR file (.am), written as the lines come */
+    int has_ir;                                         /* The IR file is written */
+} StreamPass;
+
+/* Returns the copy of a token in a moved token array */
+static Token *moved_token(Token *token, Token *from, Token *to)
+{
+    return token ? to + (token - from) : NULL;
+}
+
+/* Checks if an operand is resolved by the second pass */
+static int is_symbol_operand(Token *operand)
+{
+    return operand && operand->type == TOKEN_IDENTIFIER;
+}
+
+/* Moves the current line and its tokens from the line arena to the context's arena, returns the moved tokens */
+static Token *stream_keep_line(AssemblerContext *ctx, Lexer *lexer, TokenLine *span)
+{
+    char *line = NULL;
+    Token *tokens = NULL;
+    size_t i;
+
+    line = (char *)ARENA_ALLOC(ctx->arena, lexer->current_line.length + 1);
+    tokens = (Token *)ARENA_ALLOC(ctx->arena, span->count * sizeof(Token));
+
+    if (!line || !tokens)
+        return NULL;
+
+    memcpy(line, lexer->current_line.str, lexer->current_line.length + 1);
+    memcpy(tokens, span->tokens, span->count * sizeof(Token));
+
+    /* The tokens point into the copy of the line */
+    for (i = 0; i < span->count; i++)
+        if (tokens[i].str)
+            tokens[i].str = line + (tokens[i].str - lexer->current_line.str);
+
+    return tokens;
+}
+
+/* Parses the statement of the current line and encodes it, returns 1 if it is kept for the second pass */
+static int stream_statement(StreamPass *pass, AssemblerContext *ctx)
+{
+    ParsedInstruction instruction = {0};
+    ParsedDirective directive = {0};
+    Statement *statement = NULL;
+    TokenLine *span = &ctx->token_lines[pass->lexer.line_number - 1];
+    Token *tokens = NULL;
+    int is_instruction = 0;
+    int is_directive = 0;
+    int is_kept = 0;
+    int IC = 0, DC = 0;
+
+    /* If its an instruction parse it, keep it or encode it and update IC */
+    if ((is_instruction = is_instruction_statement(pass->tokens)))
+    {
+        parse_instruction(&instruction, pass->tokens, ctx, 1);
+
+        /* Symbols may be defined later in the file, so the second pass encodes the instruction from its line */
+        if (is_symbol_operand(instruction.rs) || is_symbol_operand(instruction.rt))
+        {
+            tokens = stream_keep_line(ctx, &pass->lexer, span);
+
+            if (tokens && (statement = statement_append(ctx, STATEMENT_INSTRUCTION, pass->lexer.line_number)))
+            {
+                statement->as.instruction = instruction;
+                statement->as.instruction.tokens = NULL;
+                statement->as.instruction.label = moved_token(instruction.label, span->tokens, tokens);
+                statement->as.instruction.instruction = moved_token(instruction.instruction, span->tokens, tokens);
+                statement->as.instruction.rs = moved_token(instruction.rs, span->tokens, tokens);
+                statement->as.instruction.rt = moved_token(instruction.rt, span->tokens, tokens);
+
+                lexer_index_line(ctx, pass->lexer.line_number, tokens, span->count);
+                is_kept = 1;
+            }
+        }
+
+        /* Encode only while the file is error free, the output is discarded otherwise */
+        else if (error_count(ctx->errors) == 0)
+        {
+            IC = ctx->IC;
+            instruction.tokens = pass->tokens;
+            encode_instruction(&instruction, ctx, &IC);
+        }
+
+        ctx->IC += instruction.code_word_count;
+    }
+
+    /* If its a directive parse it, encode it and update DC - directives never reference symbols */
+    if ((is_directive = is_directive_statement(pass->tokens)))
+    {
+        parse_directive(&directive, pass->tokens, ctx);
+
+        if (error_count(ctx->errors) == 0)
+        {
+            IC = ctx->IC;
+            DC = ctx->DC;
+            directive.tokens = pass->tokens;
+            encode_data(&directive, ctx, &IC, &DC);
+        }
+
+        ctx->DC += directive.code_word_count;
+        ctx->IC += directive.code_word_count;
+    }
+
+    /* If the statement is neither an instruction nor a directive, report an error */
+    if (!is_instruction && !is_directive)
+        error_report(ctx->errors, ERR_INVALID_STATEMENT, "%s:%d: Invalid statement: '%.*s'",
+                     ctx->ir_filename, pass->lexer.line_number, (int)pass->lexer.current_line.length, pass->lexer.current_line.str);
+
+    return is_kept;
+}
+
+/* Runs the first pass on a single line */
+static void stream_first_pass_line(StreamPass *pass, AssemblerContext *ctx, char *line)
+{
+    size_t line_number = 0;
+
+    lexer_feed_line(&pass->lexer, line);
+    line_number = pass->lexer.line_number;
+    ctx->line_number = line_number;
+
+    /* Tokenize the current line */
+    lexer_tokenize_line(&pass->lexer, ctx, pass->tokens);
+
+    if (line_number <= ctx->token_line_count)
+    {
+        /* If a new symbol is encountered, define it */
+        if (is_label_statement(pass->tokens) || is_entry_statement(pass->tokens) || is_extern_statement(pass->tokens))
+            define_symbol(ctx, pass->tokens);
+
+        /* A line that is not kept is dropped from the token line index, its tokens are released with the line */
+        if (!stream_statement(pass, ctx))
+        {
+            ctx->stats.tokens += ctx->token_lines[line_number - 1].count;
+            lexer_index_line(ctx, line_number, NULL, 0);
+        }
+    }
+
+    array_list_clear(pass->tokens);
+}
+
+/* Sink of the streaming preprocessor - handles a single preprocessed line */
+static void stream_line(AssemblerContext *ctx, char *line, void *arg)
+{
+    StreamPass *pass = (StreamPass *)arg;
+    ErrorLog *errors = ctx->errors;
+
+    /* After an error of the preprocessor the first pass would not run, and the IR file is not kept */
+    if (error_count(errors) == 0)
+    {
+        if (pass->has_ir)
+            output_stream_line(&pass->ir, line, strlen(line));
+
+        /* The first pass reports into its own log */
+        ctx->errors = pass->pass_errors;
+        if (!error_limit_reached(ctx->errors))
+            stream_first_pass_line(pass, ctx, line);
+        ctx->errors = errors;
+
+        ctx->stats.lines++;
+    }
+
+    /* The line and its tokens are released */
+    arena_reset(ctx->line_arena);
+}
+
+void stream_first_pass(AssemblerContext *ctx)
+{
+    StreamPass pass;
+    const AssemblerOptions *options = NULL;
+    int is_ir = 0;
+
+    if (!ctx || !ctx->errors)
+        return;
+
+    options = ctx->options;
+    memset(&pass, 0, sizeof(StreamPass));
+    lexer_init(&pass.lexer);
+
+    pass.tokens = array_list_create(NULL);
+    pass.pass_errors = error_log_create(ctx->errors->max_errors);
+    ctx->line_arena = arena_create(STREAM_LINE_ARENA_SIZE);
+
+    if (pass.tokens && pass.pass_errors && ctx->line_arena)
+    {
+        /* The diagnostics of the first pass name the IR file, as if it was read back */
+        ctx->ir_filename = output_filename(ctx, IR_EXT);
+        is_ir = ctx->ir_filename && !(options && (options->no_am || options->no_output));
+        pass.has_ir = is_ir && output_stream_open(&pass.ir, ctx->ir_filename);
+        if (is_ir && !pass.has_ir)
+            ctx->outputs |= OUTPUT_FILE_FAILED;
+
+        preprocess_stream(ctx, stream_line, &pass);
+
+        /* Like preprocess(), the IR file is only kept if the preprocessor reported no errors */
+        if (pass.has_ir && error_count(ctx->errors) == 0)
+            ctx->outputs |= output_stream_close(&pass.ir, 1) ? OUTPUT_FILE_AM : OUTPUT_FILE_FAILED;
+        else if (pass.has_ir)
+            output_stream_close(&pass.ir, 0);
+
+        if (error_count(ctx->errors) == 0)
+            error_log_merge(ctx->errors, pass.pass_errors);
+
+        ctx->line_number = pass.lexer.line_number + 1;
+    }
+    else
+        error_report(ctx->errors, ERR_FILE_READ, "Failed to read file: %s", ctx->filename);
+
+    /* Clean up */
+    if (ctx->line_arena)
+        arena_destroy(ctx->line_arena);
+    ctx->line_arena = NULL;
+
+    if (pass.pass_errors)
+        error_log_destroy(pass.pass_errors);
+    if (pass.tokens)
+        array_list_destroy(pass.tokens);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file stream_pass.h
+ * @brief Header file for the streaming first pass of the assembler (--stream).
+ * @details This file contains the function prototype for running the preprocessor and the first pass as a single
+ *          pipeline. The source is read a block at a time, and every preprocessed line is tokenized and parsed as
+ *          soon as it is produced, on an arena that is reset after each line. Nothing of a line is kept unless the
+ *          second pass needs it:
+ *
+ *          - directives and instructions without symbol operands are encoded into the image right away
+ *          - instructions with symbol operands keep a copy of their line, tokens and parsed statement
+ *          - symbols keep a copy of their name
+ *
+ *          The peak memory of a file is then its image, its symbols and the lines that reference symbols,
+ *          instead of all of its raw lines, preprocessed lines, tokens and statements.
+ *
+ * The outputs and the diagnostics are those of preprocess() and first_pass(). The errors of the first pass are kept
+ * apart and only reported if the preprocessor reports none, as the first pass would not have run.
+ */
+
+#ifndef STREAM_PASS_H
+#define STREAM_PASS_H
+
+#include "../main/assembler.h"
+
+#define STREAM_LINE_ARENA_SIZE 4096                     /* Block size of the arena of the current line */
+
+/**
+ * @brief Preforms the preprocessor and the first pass of the assembler on the streamed lines of the file.
+ * @param ctx Pointer to the assembler context.
+ * @note Leaves the context ready for second_pass() - the statements that reference symbols, the symbol table,
+ *       the image of every other statement, IC and DC. The IR file (.am) is written while the lines are streamed.
+ */
+void stream_first_pass(AssemblerContext *ctx);
+
+#endif /* STREAM_PASS_H */
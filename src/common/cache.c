@@ -0,0 +1,256 @@
+/**
+ * @file cache.c
+ * @brief Implementation of the build cache.
+ * @details This file contains the key computation, the lookup and the store of cache entries.
+ *          Every file of an entry is written through output_write_file(), so a concurrent reader never sees a
+ *          partial file, and the index is written last - an entry without an index is a miss.
+ */
+
+/* mkdir() is POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "./cache.h"
+#include "./error.h"
+#include "./file_io.h"
+#include "./util.h"
+
+#define HASH_MASK 0xFFFFFFFFUL
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+/* Extensions of the output files, indexed by the bit of their OUTPUT_FILE_* flag */
+static const char *output_extensions[OUTPUT_FILE_COUNT] = {
+    IR_EXT, OBJ_EXT, ENT_EXT, EXT_EXT, OBJ_BIN_EXT
+};
+
+/* Two independent 32 bit hashes (FNV-1a and sdbm) over the same bytes, a 64 bit key without a 64 bit type */
+static void cache_hash(const char *data, size_t size, unsigned long *fnv, unsigned long *sdbm)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)data[i];
+
+        *fnv = ((*fnv ^ c) * FNV_PRIME) & HASH_MASK;
+        *sdbm = (c + (*sdbm << 6) + (*sdbm << 16) - *sdbm) & HASH_MASK;
+    }
+}
+
+/* Builds the key of a source - the version and options come first, so any change of them changes every key */
+static void cache_key(AssemblerContext *ctx, const char *source, size_t size, char *key)
+{
+    unsigned long fnv = FNV_OFFSET_BASIS, sdbm = 0;
+    char options[8];
+    const AssemblerOptions *opt = ctx->options;
+
+    sprintf(options, "%d%d%d", opt && opt->single_pass, opt && opt->no_am, opt && opt->binary_object);
+
+    cache_hash(ASM_VERSION, sizeof(ASM_VERSION), &fnv, &sdbm);
+    cache_hash(options, strlen(options) + 1, &fnv, &sdbm);
+    cache_hash(ctx->filename, strlen(ctx->filename) + 1, &fnv, &sdbm);
+    cache_hash(source, size, &fnv, &sdbm);
+
+    sprintf(key, "%08lx%08lx-%lx", fnv, sdbm, (unsigned long)size);
+}
+
+/* Returns the allocated path of a file of a cache entry */
+static char *cache_path(const char *dir, const char *key, const char *extension)
+{
+    char *path = (char *)MALLOC(strlen(dir) + strlen(key) + strlen(extension) + 2);
+
+    if (path)
+        sprintf(path, "%s/%s%s", dir, key, extension);
+
+    return path;
+}
+
+/* Copies a file, the destination is replaced atomically */
+static int cache_copy(const char *from, const char *to)
+{
+    OutputBuffer contents = {0};
+    int is_copied = 0;
+
+    if (!from || !to)
+        return 0;
+
+    contents.data = file_read_contents(from, &contents.length);
+    if (!contents.data)
+        return 0;
+
+    contents.capacity = contents.length + 1;
+    is_copied = output_write_file(&contents, to, 1);
+
+    output_destroy(&contents);
+    return is_copied;
+}
+
+/* Copies the output files of an entry next to the source, returns 0 if one is missing */
+static int cache_restore_outputs(AssemblerContext *ctx, const char *dir, const char *key, unsigned long outputs)
+{
+    char *from = NULL, *to = NULL;
+    int i, is_restored = 1;
+
+    for (i = 0; i < OUTPUT_FILE_COUNT && is_restored; i++)
+    {
+        if (!(outputs & (1UL << i)))
+            continue;
+
+        from = cache_path(dir, key, output_extensions[i]);
+        to = output_filename(ctx, output_extensions[i]);
+        is_restored = cache_copy(from, to);
+
+        if (from)
+            FREE(from);
+        if (to)
+            FREE(to);
+    }
+
+    return is_restored;
+}
+
+/* Reports the diagnostics kept in an index, one "<type> <message>" line each */
+static void cache_replay_errors(AssemblerContext *ctx, char *lines)
+{
+    char *line = lines, *newline = NULL, *message = NULL;
+    long type = 0;
+
+    for (; *line; line = newline + 1)
+    {
+        newline = strchr(line, '\n');
+        if (!newline)
+            break;
+
+        *newline = '\0';
+        type = strtol(line, &message, 10);
+
+        if (message != line && *message == ' ')
+            error_report(ctx->errors, (ErrorType)type, "%s", message + 1);
+    }
+}
+
+int cache_lookup(AssemblerContext *ctx, const char *dir, char *key, char **source, size_t *size)
+{
+    char *path = NULL, *index = NULL, *pos = NULL, *source_path = NULL;
+    size_t index_size = 0;
+    unsigned long outputs = 0;
+    int is_hit = 0;
+
+    if (!ctx || !dir || !key || !source || !size)
+        return 0;
+
+    *source = NULL;
+    *size = 0;
+    key[0] = '\0';
+
+    /* Read the raw source - on a miss the phases carry on with it */
+    source_path = (char *)MALLOC(strlen(ctx->filename) + strlen(ASM_EXT) + 1);
+    if (!source_path)
+        return 0;
+
+    sprintf(source_path, "%s%s", ctx->filename, ASM_EXT);
+    *source = file_read_contents(source_path, size);
+    FREE(source_path);
+
+    if (!*source)
+        return 0;
+
+    cache_key(ctx, *source, *size, key);
+
+    path = cache_path(dir, key, CACHE_INDEX_EXT);
+    if (path)
+        index = file_read_contents(path, &index_size);
+
+    /* First line - the format, second line - the outputs */
+    if (index && strncmp(index, CACHE_MAGIC " ", strlen(CACHE_MAGIC) + 1) == 0 &&
+        strtol(index + strlen(CACHE_MAGIC) + 1, &pos, 10) == CACHE_FORMAT_VERSION && *pos == '\n')
+    {
+        outputs = strtoul(pos + 1, &pos, 10);
+
+        if (*pos == '\n' && cache_restore_outputs(ctx, dir, key, outputs))
+        {
+            cache_replay_errors(ctx, pos + 1);
+            is_hit = 1;
+        }
+    }
+
+    if (path)
+        FREE(path);
+    if (index)
+        FREE(index);
+
+    return is_hit;
+}
+
+void cache_store(AssemblerContext *ctx, const char *dir, const char *key)
+{
+    OutputBuffer index;
+    char message[ERR_MSG_MAX_LEN];
+    char *from = NULL, *to = NULL, *c = NULL;
+    Error *error = NULL;
+    size_t i;
+    int is_stored = 1;
+
+    /* An entry must replay every output of the file */
+    if (!ctx || !dir || !key || !key[0] || (ctx->outputs & OUTPUT_FILE_FAILED))
+        return;
+
+    /* The directory may already exist */
+    mkdir(dir, 0777);
+
+    /* Copy the outputs first, the entry only becomes visible with its index */
+    for (i = 0; i < OUTPUT_FILE_COUNT && is_stored; i++)
+    {
+        if (!(ctx->outputs & (1U << i)))
+            continue;
+
+        from = output_filename(ctx, output_extensions[i]);
+        to = cache_path(dir, key, output_extensions[i]);
+        is_stored = cache_copy(from, to);
+
+        if (from)
+            FREE(from);
+        if (to)
+            FREE(to);
+    }
+
+    if (!is_stored)
+        return;
+
+    output_init(&index, 0);
+    output_append(&index, CACHE_MAGIC " ", strlen(CACHE_MAGIC) + 1);
+    output_decimal(&index, CACHE_FORMAT_VERSION, 0);
+    output_char(&index, '\n');
+    output_decimal(&index, (long)ctx->outputs, 0);
+    output_char(&index, '\n');
+
+    for (i = 0; i < error_record_count(ctx->errors); i++)
+    {
+        error = error_record(ctx->errors, i);
+        error_format(error, message, sizeof(message));
+
+        output_decimal(&index, (long)error->type, 0);
+        output_char(&index, ' ');
+
+        /* A message is a single line of the index */
+        for (c = message; *c; c++)
+            output_char(&index, *c == '\n' ? ' ' : *c);
+
+        output_char(&index, '\n');
+    }
+
+    to = cache_path(dir, key, CACHE_INDEX_EXT);
+    if (to)
+    {
+        output_write_file(&index, to, 1);
+        FREE(to);
+    }
+
+    output_destroy(&index);
+}
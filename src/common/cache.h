@@ -0,0 +1,49 @@
+/**
+ * @file cache.h
+ * @brief Header file for the build cache (--cache DIR).
+ * @details This file contains the function prototypes of an on-disk cache of assembly results. The key of a source
+ *          is a hash of its raw bytes, its name, the assembler version and the options that change the output.
+ *          An entry holds a copy of every output file written for the source and its diagnostics, so an unchanged
+ *          source is served without running any phase.
+ *
+ * Entry layout - every file is named by the key of the source:
+ *
+ *   DIR/<key>.am, .ob, .ent, .ext, .obb    copies of the output files that were written
+ *   DIR/<key>.idx                          written last: the format line, the OUTPUT_FILE_* mask of the outputs,
+ *                                          then one "<error type> <message>" line per diagnostic
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+#include "../main/assembler.h"
+
+#define CACHE_MAGIC "ASMCACHE"
+#define CACHE_FORMAT_VERSION 1
+#define CACHE_INDEX_EXT ".idx"
+#define CACHE_KEY_MAX 48                                /* Enough for the hex digits of the key */
+
+/**
+ * @brief Looks a source up in the cache, replaying its outputs and diagnostics on a hit.
+ * @param ctx Pointer to the assembler context of the source.
+ * @param dir The cache directory.
+ * @param key Filled with the key of the source, for cache_store() (at least CACHE_KEY_MAX bytes).
+ * @param source Set to the raw source on a miss, so it is not read twice (NULL if it could not be read).
+ * @param size Set to the size of the raw source.
+ * @return 1 on a hit - the output files are written and the diagnostics are in ctx->errors, 0 on a miss.
+ * @note The caller is responsible for freeing the source using FREE().
+ */
+int cache_lookup(AssemblerContext *ctx, const char *dir, char *key, char **source, size_t *size);
+
+/**
+ * @brief Stores the results of an assembled source in the cache.
+ * @param ctx Pointer to the assembled context, its output files already written.
+ * @param dir The cache directory, created if it does not exist.
+ * @param key The key of the source, from cache_lookup().
+ * @note Failures are silent - the source is simply assembled again next time.
+ */
+void cache_store(AssemblerContext *ctx, const char *dir, const char *key);
+
+#endif /* CACHE_H */
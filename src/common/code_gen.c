@@ -2,7 +2,7 @@
  * @file code_gen.c
  * @brief Implementation of code generation functions.
  * @details This file contains functions for encoding instructions and directives into machine code.
- *         It includes functions for creating and destroying words, encoding operands, and manipulating fields in words,
+ *         It includes functions for getting words of the image, encoding operands, and manipulating fields in words,
  *         mostyly via bitwise operations.
  */
 
@@ -20,139 +20,191 @@
 #define SET_BITS(word, value, mask, pos) \
     (word) = ((word) & ~(mask)) | (((value) << (pos)) & (mask))
 
-Word *word_create(unsigned int value)
+Fixup *fixup_create(Arena *arena, Token *operand, long word_index, AddressingMode add_mode, int address)
 {
-    Word *word = NULL;
+    Fixup *fixup = NULL;
+
+    if (!operand)
+        return NULL;
 
-    word = (Word *)MALLOC(sizeof(Word));
+    fixup = (Fixup *)ARENA_ALLOC(arena, sizeof(Fixup));
 
-    if (!word)
+    if (!fixup)
         return NULL;
 
-    word->value = value;
-    word->address = 0;
+    fixup->operand = operand;
+    fixup->word_index = word_index;
+    fixup->add_mode = add_mode;
+    fixup->address = address;
 
-    return word;
+    return fixup;
 }
 
-void word_destroy(void *word)
+void fixup_destroy(void *fixup)
 {
-    Word *w = (Word *)word;
+    Fixup *f = (Fixup *)fixup;
 
-    if (!word)
+    if (!fixup)
         return;
 
-    FREE(w);
+    FREE(f);
 }
 
-void encode_operand(Token *operand, Word *word, int is_source, int is_relative)
+Word *image_word(AssemblerContext *ctx, int address)
 {
-    RegisterInfo *reg_info = NULL;
-    char *reg_name = NULL;
+    size_t index = 0, new_capacity = 0;
+    Word *new_image = NULL;
 
-    if (!operand || !word)
-        return;
+    if (!ctx || address < INITIAL_IC)
+        return NULL;
+
+    index = address - INITIAL_IC;
 
-    /* Register Handling */
-    if (operand->type == TOKEN_REGISTER)
+    /* Grow the image to reach the address */
+    if (index >= ctx->image_capacity)
     {
-        /* Get the register name and find its info */
-        reg_name = operand->sv.str;
-        reg_name[operand->sv.length] = '\0';
-        reg_info = find_register(reg_name);
+        new_capacity = ctx->image_capacity ? ctx->image_capacity : IMAGE_INITIAL_CAPACITY;
+        while (new_capacity <= index)
+            new_capacity *= IMAGE_GROWTH_FACTOR;
 
-        if (reg_info)
-        {
-            if (is_source)
-            {
-                word_set_rs_add_mod(word, ADD_MOD_REGISTER);
-                word_set_rs_operand(word, reg_info->reg);
-            }
-            else
-            {
-                word_set_rt_add_mod(word, ADD_MOD_REGISTER);
-                word_set_rt_operand(word, reg_info->reg);
-            }
-        }
-    }   
+        new_image = (Word *)REALLOC(ctx->image, new_capacity * sizeof(Word));
+        if (!new_image)
+            return NULL;
+
+        ctx->image = new_image;
+        ctx->image_capacity = new_capacity;
+    }
 
-    /* Immediate Handling */
-    else if (operand->type == TOKEN_IMM)
+    /* Clear the words up to the address */
+    if (index >= ctx->image_size)
     {
-        if (is_source)
-            word_set_rs_add_mod(word, ADD_MOD_IMMEDIATE);
-        else
-            word_set_rt_add_mod(word, ADD_MOD_IMMEDIATE);
+        memset(ctx->image + ctx->image_size, 0, (index + 1 - ctx->image_size) * sizeof(Word));
+        ctx->image_size = index + 1;
     }
 
-    /* Identifier Handling */
-    else if (operand->type == TOKEN_IDENTIFIER)
+    return &ctx->image[index];
+}
+
+/* The addressing mode an operand is encoded with - registers and immediates by their token, identifiers by the ampersand */
+static AddressingMode encoded_mode(Token *operand, AddressingMode add_mode)
+{
+    if (!operand)
+        return ADD_MOD_NONE;
+
+    switch (operand->type)
     {
-        if (is_relative)
-        {
-            if (is_source)
-                word_set_rs_add_mod(word, ADD_MOD_RELATIVE);
-            else
-                word_set_rt_add_mod(word, ADD_MOD_RELATIVE);
-        }
-        else 
-        {
-            if (is_source)
-                word_set_rs_add_mod(word, ADD_MOD_DIRECT);
-            else
-                word_set_rt_add_mod(word, ADD_MOD_DIRECT);
-        }
+        case TOKEN_REGISTER:
+            return ADD_MOD_REGISTER;
+
+        case TOKEN_IMM:
+            return ADD_MOD_IMMEDIATE;
+
+        case TOKEN_IDENTIFIER:
+            return add_mode == ADD_MOD_RELATIVE ? ADD_MOD_RELATIVE : ADD_MOD_DIRECT;
+
+        default:
+            return ADD_MOD_NONE;
     }
 }
 
+/* The register number field of an operand, 0 if it is not a register */
+static Word register_field(Token *operand, int pos)
+{
+    RegisterInfo *reg_info = NULL;
+
+    if (!operand || operand->type != TOKEN_REGISTER)
+        return 0;
+
+    reg_info = find_register(token_sv(operand));
+
+    return reg_info ? (Word)reg_info->reg << pos : 0;
+}
+
 void encode_first_word(ParsedInstruction *instruction, AssemblerContext *ctx, int *IC)
 {
-    InstructionInfo *info = NULL;
+    const FirstWord *entry = NULL;
     Word *word = NULL;
-    char *instruction_name = NULL;
 
     if (!instruction || !ctx)
         return;
 
-    /* Get instruction info from table */
-    instruction_name = instruction->instruction->sv.str;
-    instruction_name[instruction->instruction->sv.length] = '\0';
-    info = find_instruction(instruction_name);
+    /* The opcode, funct, ARE and both addressing modes come from a single table entry */
+    entry = first_word(instruction->index, encoded_mode(instruction->rs, instruction->rs_add_mode),
+                       encoded_mode(instruction->rt, instruction->rt_add_mode));
 
-    if (!info)
+    if (!entry)
         return;
 
-    /* Create an empty word */
-    word = word_create(0);
+    /* Get the (empty) word at the instruction's address */
+    word = image_word(ctx, *IC);
+    if (!word)
+        return;
 
-    /* Set the opcode and funct fields */
-    word_set_are(word, ARE_ABSOLUTE);
+    /* Only the register numbers are left */
+    *word = entry->word | register_field(instruction->rs, SRC_OPERAND_POS) | register_field(instruction->rt, DST_OPERAND_POS);
+}
 
-    if (instruction->instruction)
+int encode_symbol(Token *operand, AssemblerContext *ctx, Word *word, AddressingMode add_mode, int current_IC)
+{
+    size_t address = 0;
+    Symbol *symbol = NULL;
+
+    if (!operand || !ctx || !word)
+        return 0;
+
+    /* Get the symbol from the symbol table */
+    symbol = hash_map_get_sv(ctx->symbol_table, token_sv(operand));
+
+    if (!symbol)
     {
-        word_set_opcode(word, info->opcode);
-        word_set_funct(word, info->funct);
+        error_report(ctx->errors, ERR_SYMBOL_NOT_FOUND, "%s:%lu: Symbol '%.*s' not found in symbol table", 
+            ctx->ir_filename, (unsigned long)operand->line_number, (int)operand->length, operand->str);
+        return 0;
     }
 
-    /* Encode operands - might generate multiple words */
-    if (instruction->rs)
-        encode_operand(instruction->rs, word, 1, instruction->rs_add_mode == ADD_MOD_RELATIVE);
-    
+    if (add_mode == ADD_MOD_DIRECT)
+    {
+        address = symbol->address;
 
-    if (instruction->rt)
-        encode_operand(instruction->rt, word, 0, instruction->rt_add_mode == ADD_MOD_RELATIVE);
-    
-    /* Set the address */
-    word->address = *IC;
-    array_list_append(ctx->code_img, word);
+        /*  Validate the address is within range */
+        if (address > UINT24_MAX) 
+        {
+            error_report(ctx->errors, ERR_ADD_OUT_OF_BOUNDS, 
+               "%s:%lu: Symbol address %lu exceeds maximum allowed value of %lu", 
+               ctx->ir_filename, (unsigned long)operand->line_number, address, UINT24_MAX);
+        }
+
+        /* Set the address in the word */
+        word_from_immediate(word, address);
+
+        if (symbol->external)
+            word_set_are(word, ARE_EXTERNAL);
+        else
+            word_set_are(word, ARE_RELOCATABLE);
+    }
+    else if (add_mode == ADD_MOD_RELATIVE)
+    {
+        /*  Calculate relative address */
+        address = symbol->address - current_IC + 1;
+
+        /*  Validate the offset is within 21-bit signed range */
+        if ((long)address > INT21_MAX || (long)address < INT21_MIN) 
+        {
+            error_report(ctx->errors, ERR_ADD_OUT_OF_BOUNDS, 
+               "%s:%lu: Relative address offset %ld exceeds allowed range (%d to %d)", 
+               ctx->ir_filename, (unsigned long)operand->line_number, (long)address, INT21_MIN, INT21_MAX);
+        }
+
+        word_from_immediate(word, address);
+        word_set_are(word, ARE_ABSOLUTE);
+    }
+
+    return 1;
 }
 
 void encode_operand_extra(Token *operand, AssemblerContext *ctx, Word *word, AddressingMode add_mode, int current_IC)
 {
     unsigned int imm = 0;
-    size_t address = 0;
-    Symbol *symbol = NULL;
-    char *symbol_name = NULL;
     long value = 0;
 
     if (!operand || !ctx || !word)
@@ -161,14 +213,14 @@ void encode_operand_extra(Token *operand, AssemblerContext *ctx, Word *word, Add
     /* Handle extra word for immediate */
     if (operand->type == TOKEN_IMM)
     {
-        value = atoi(operand->sv.str);
+        sv_to_long(token_sv(operand), &value);
 
         /* Validate immediate value is within 21-bit signed range */
         if (value > INT21_MAX || value < INT21_MIN) 
         {
             error_report(ctx->errors, ERR_IMM_OUT_OF_BOUNDS, 
                "%s:%lu: Immediate value %ld exceeds allowed range (%d to %d)", 
-               ctx->ir_filename, operand->line_number, value, INT21_MAX, INT21_MIN);
+               ctx->ir_filename, (unsigned long)operand->line_number, value, INT21_MAX, INT21_MIN);
         }
 
         imm = value;
@@ -179,59 +231,13 @@ void encode_operand_extra(Token *operand, AssemblerContext *ctx, Word *word, Add
 
     else if (operand->type == TOKEN_IDENTIFIER)
     {   
-        /* Get the symbol from the symbol table */
-        symbol_name = operand->sv.str;
-        symbol_name[operand->sv.length] = '\0';
-        symbol = hash_map_get(ctx->symbol_table, symbol_name);
+        /* Single pass - the symbol may not be defined yet, patch the word once the file was read */
+        if (ctx->fixups)
+            array_list_append(ctx->fixups, fixup_create(ctx->arena, operand, current_IC - INITIAL_IC, add_mode, current_IC));
 
-        if (!symbol)
-        {
-            error_report(ctx->errors, ERR_SYMBOL_NOT_FOUND, "%s:%d:Symbol '%s' not found in symbol table", 
-                ctx->ir_filename, ctx->line_number, symbol_name);
-            return;
-        }
-
-        if (add_mode == ADD_MOD_DIRECT)
-        {
-            address = symbol->address;
-
-            /*  Validate the address is within range */
-            if (address > UINT24_MAX) 
-            {
-                error_report(ctx->errors, ERR_ADD_OUT_OF_BOUNDS, 
-                   "%s:%lu: Symbol address %lu exceeds maximum allowed value of %lu", 
-                   ctx->ir_filename, operand->line_number, address, UINT24_MAX);
-            }
-
-            /* Set the address in the word */
-            word_from_immediate(word, address);
-
-            if (symbol->external)
-                word_set_are(word, ARE_EXTERNAL);
-            else
-                word_set_are(word, ARE_RELOCATABLE);
-        }
-        else if (add_mode == ADD_MOD_RELATIVE)
-        {
-            /*  Calculate relative address */
-            address = symbol->address - current_IC + 1;
-
-            /*  Validate the offset is within 21-bit signed range */
-            if ((long)address > INT21_MAX || (long)address < INT21_MIN) 
-            {
-                error_report(ctx->errors, ERR_ADD_OUT_OF_BOUNDS, 
-                   "%s:%lu: Relative address offset %ld exceeds allowed range (%d to %d)", 
-                   ctx->ir_filename, operand->line_number, (long)address, INT21_MIN, INT21_MAX);
-            }
-
-            word_from_immediate(word, address);
-            word_set_are(word, ARE_ABSOLUTE);
-        }
+        else
+            encode_symbol(operand, ctx, word, add_mode, current_IC);
     }
-
-    /* Append the word to the code image */
-    word->address = current_IC;
-    array_list_append(ctx->code_img, word);
 }
 
 void encode_instruction(ParsedInstruction *instruction, AssemblerContext *ctx, int *IC)
@@ -250,7 +256,7 @@ void encode_instruction(ParsedInstruction *instruction, AssemblerContext *ctx, i
     {
         if (instruction->rs->type == TOKEN_IMM || instruction->rs->type == TOKEN_IDENTIFIER)
         {
-            word = word_create(0);
+            word = image_word(ctx, *IC);
             encode_operand_extra(instruction->rs, ctx, word, instruction->rs_add_mode, *IC);
             (*IC)++;
         }
@@ -261,13 +267,41 @@ void encode_instruction(ParsedInstruction *instruction, AssemblerContext *ctx, i
     {
         if (instruction->rt->type == TOKEN_IMM || instruction->rt->type == TOKEN_IDENTIFIER)
         {
-            word = word_create(0);
+            word = image_word(ctx, *IC);
             encode_operand_extra(instruction->rt, ctx, word, instruction->rt_add_mode, *IC);
             (*IC)++;
         }
     }
 }
 
+/* Writes the values of a .data list into the image in one go, returns 0 if the list does not hold count values */
+static int encode_data_list(char *list, int count, AssemblerContext *ctx, int *IC, int *DC)
+{
+    Word *words = NULL;
+    long value = 0;
+    int status = DATA_VALUE_MORE;
+    int n = 0;
+
+    /* Grow the image once for the whole list */
+    if (count <= 0 || !image_word(ctx, *IC + count - 1))
+        return 0;
+
+    words = image_word(ctx, *IC);
+
+    for (n = 0; n < count && status == DATA_VALUE_MORE; n++)
+    {
+        status = parse_data_value(&list, &value);
+        words[n] = (value & WORD_MASK) | WORD_DATA_FLAG;
+    }
+
+    if (n != count || status != DATA_VALUE_LAST)
+        return 0;
+
+    *IC += count;
+    *DC += count;
+    return 1;
+}
+
 void encode_data(ParsedDirective *directive, AssemblerContext *ctx, int *IC, int *DC)
 {
     Word *word = NULL;
@@ -290,7 +324,10 @@ void encode_data(ParsedDirective *directive, AssemblerContext *ctx, int *IC, int
     
     token = (Token *)array_list_get(directive->tokens, i);
 
-    /* Data directive */
+    /* Data directive, a list already validated by the first pass is written straight into the image */
+    if (token->type == TOKEN_DIR_DATA && encode_data_list(token->str + token->length, directive->code_word_count, ctx, IC, DC))
+        return;
+
     if (token->type == TOKEN_DIR_DATA)
     {
         for (; i < array_list_size(directive->tokens); i++)
@@ -299,19 +336,18 @@ void encode_data(ParsedDirective *directive, AssemblerContext *ctx, int *IC, int
 
             if (token->type == TOKEN_IMM)
             {
-                value = atoi(token->sv.str);
+                sv_to_long(token_sv(token), &value);
                 
                 if (value > INT21_MAX || value < INT21_MIN) {
                     error_report(ctx->errors, ERR_IMM_OUT_OF_BOUNDS, 
                                 "%s:%lu: Data value %ld exceeds 24-bit range (%d to %d)", 
-                                ctx->ir_filename, token->line_number, value, INT21_MIN, INT21_MAX);
+                                ctx->ir_filename, (unsigned long)token->line_number, value, INT21_MIN, INT21_MAX);
                 }
                 
-                /* A new word per immediate value */
-                word = word_create(0);
+                /* A data word per immediate value */
+                word = image_word(ctx, *IC);
                 data_from_immediate(word, value);
-                array_list_append(ctx->data_img, word);
-                word->address = *IC;
+                word_set_data(word);
                 (*DC)++;
                 (*IC)++;
             }
@@ -322,36 +358,36 @@ void encode_data(ParsedDirective *directive, AssemblerContext *ctx, int *IC, int
     else
     if (token->type == TOKEN_DIR_STRING)
     {
-        char *str = NULL;
+        const char *str = NULL;
         size_t length = 0;
 
         /* Skip the .string token and " */
         i += 2;
 
-        /* Get the string literal */
+        /* Get the string literal - none for "", the line is not written to */
         token = (Token *)array_list_get(directive->tokens, i);
-        str = token->sv.str;
-        str[token->sv.length] = '\0';
+        if (token->type == TOKEN_STR_LIT)
+        {
+            str = token->str;
+            length = token->length;
+        }
 
-        length = strlen(str);
-        
         for (i = 0; i < length; i++)
         {
-            /* A word per character */
-            word = word_create(0);
+            /* A data word per character */
+            word = image_word(ctx, *IC);
             data_from_immediate(word, str[i]);
-            array_list_append(ctx->data_img, word);
-            word->address = *IC;
+            word_set_data(word);
             (*DC)++;
             (*IC)++;
         }
 
         /* Add a null terminator */
-        word = word_create(0);
-        word->address = *IC;
+        word = image_word(ctx, *IC);
+        data_from_immediate(word, 0);
+        word_set_data(word);
         (*DC)++;
         (*IC)++;
-        array_list_append(ctx->data_img, word);
     }
 }
 
@@ -360,7 +396,7 @@ void word_set_opcode(Word *word, int opcode)
     if (!word)
         return;
 
-    SET_BITS(word->value, opcode, OPCODE_MASK, OPCODE_POS);
+    SET_BITS(*word, opcode, OPCODE_MASK, OPCODE_POS);
 }
 
 void word_set_rs_add_mod(Word *word, unsigned int mode)
@@ -368,7 +404,7 @@ void word_set_rs_add_mod(Word *word, unsigned int mode)
     if (!word)
         return;
 
-    SET_BITS(word->value, mode, SRC_ADD_MODE_MASK, SRC_ADD_MODE_POS);
+    SET_BITS(*word, mode, SRC_ADD_MODE_MASK, SRC_ADD_MODE_POS);
 }
 
 void word_set_rs_operand(Word *word, unsigned int operand)
@@ -376,7 +412,7 @@ void word_set_rs_operand(Word *word, unsigned int operand)
     if (!word)
         return;
 
-    SET_BITS(word->value, operand, SRC_OPERAND_MASK, SRC_OPERAND_POS);
+    SET_BITS(*word, operand, SRC_OPERAND_MASK, SRC_OPERAND_POS);
 }
 
 void word_set_rt_add_mod(Word *word, unsigned int mode)
@@ -384,7 +420,7 @@ void word_set_rt_add_mod(Word *word, unsigned int mode)
     if (!word)
         return;
 
-    SET_BITS(word->value, mode, DST_ADD_MODE_MASK, DST_ADD_MODE_POS);
+    SET_BITS(*word, mode, DST_ADD_MODE_MASK, DST_ADD_MODE_POS);
 }
 
 void word_set_rt_operand(Word *word, unsigned int operand)
@@ -392,7 +428,7 @@ void word_set_rt_operand(Word *word, unsigned int operand)
     if (!word)
         return;
 
-    SET_BITS(word->value, operand, DST_OPERAND_MASK, DST_OPERAND_POS);
+    SET_BITS(*word, operand, DST_OPERAND_MASK, DST_OPERAND_POS);
 }
 
 void word_set_funct(Word *word, unsigned int funct)
@@ -400,7 +436,7 @@ void word_set_funct(Word *word, unsigned int funct)
     if (!word)
         return;
 
-    SET_BITS(word->value, funct, FUNCT_MASK, FUNCT_POS);
+    SET_BITS(*word, funct, FUNCT_MASK, FUNCT_POS);
 }
 
 void word_set_are(Word *word, unsigned int are)
@@ -408,7 +444,7 @@ void word_set_are(Word *word, unsigned int are)
     if (!word)
         return;
 
-    SET_BITS(word->value, are, ARE_MASK, ARE_POS);
+    SET_BITS(*word, are, ARE_MASK, ARE_POS);
 }
 
 void word_from_immediate(Word *word, int immediate)
@@ -416,7 +452,15 @@ void word_from_immediate(Word *word, int immediate)
     if (!word)
         return;
 
-    word->value = (immediate << IMM_SHIFT) & IMM_MASK;
+    *word = (immediate << IMM_SHIFT) & IMM_MASK;
+}
+
+void word_set_data(Word *word)
+{
+    if (!word)
+        return;
+
+    *word |= WORD_DATA_FLAG;
 }
 
 void data_from_immediate(Word *word, int immediate)
@@ -424,5 +468,5 @@ void data_from_immediate(Word *word, int immediate)
     if (!word)
         return;
 
-    word->value = immediate & WORD_MASK;
+    *word = immediate & WORD_MASK;
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
  * @file code_gen.h
  * @brief Header file for code generation functions.
  * @details This file contains function prototypes for encoding instructions and directives into machine code.
- *         It includes functions for creating and destroying words, encoding operands, and manipulating fields in words.
+ *         It includes functions for getting words of the image, encoding operands, and manipulating fields in words.
  *         The code generation functions are used in the assembler to convert high-level instructions into machine code.
  */
 
@@ -12,31 +12,55 @@
 #include "../common/isa.h"
 #include "../common/parser.h"
 
-/* Word structure */
-/* This structure represents A 24-bit word used in the assembler. */
-/* It contains the value of the word and its address in memory. */
+/* Word type */
+/* A 24-bit word used in the assembler, an element of the image (ctx->image) which is indexed by address - INITIAL_IC. */
 /* The value is stored as an unsigned integer which is larger than 24 bits and masked to 24 bits. */
-/* 8 upper bits will always be 0. */
+/* Of the 8 upper bits only WORD_DATA_FLAG is used, it marks the words of the data image. */
+
+typedef unsigned int Word;
+
+#define WORD_DATA_FLAG (1U << WORD_BITS)
+
+/* Image setup */
+#define IMAGE_INITIAL_CAPACITY 256
+#define IMAGE_GROWTH_FACTOR 2
+
+/* Fixup structure */
+/* A symbol reference whose word is patched once the whole file was read (single pass only). */
 
 typedef struct {
-    unsigned int value;
-    int address;
-} Word;
+    Token *operand;                     /* The identifier operand referencing the symbol */
+    long word_index;                    /* Index of the word to patch in ctx->image */
+    AddressingMode add_mode;            /* Addressing mode of the operand (direct or relative) */
+    int address;                        /* Address of the word to patch */
+} Fixup;
+
+/**
+ * @brief Creates a new fixup.
+ * @param arena The arena to allocate the fixup from, NULL to allocate it on the heap.
+ * @param operand The token referencing the symbol.
+ * @param word_index Index of the word to patch in the code image.
+ * @param add_mode The addressing mode of the operand.
+ * @param address The address of the word.
+ * @return Pointer to the newly created fixup.
+ * @note Heap fixups must be freed by the caller using fixup_destroy(), arena fixups are released with the arena.
+ */
+Fixup *fixup_create(Arena *arena, Token *operand, long word_index, AddressingMode add_mode, int address);
 
 /**
- * @brief Creates a new word with the specified value.
- * @param value The value of the word.
- * @return Pointer to the newly created word.
- * @note The caller is responsible for freeing the word using word_destroy().
+ * @brief Destroys a fixup and frees its memory.
+ * @param fixup Pointer to the fixup to destroy.
  */
-Word *word_create(unsigned int value);
+void fixup_destroy(void *fixup);
 
 /**
- * @brief Destroys a word and frees its memory.
- * @param word Pointer to the word to destroy.
- * @note Frees the word structure and its contents.
+ * @brief Gets the image word at an address, growing the image if needed.
+ * @param ctx Pointer to the assembler context.
+ * @param address The address of the word (at least INITIAL_IC).
+ * @return Pointer to the word, cleared if the image was grown to reach it, or NULL on failure.
+ * @note The pointer is valid until the image grows again.
  */
-void word_destroy(void *word);
+Word *image_word(AssemblerContext *ctx, int address);
 
 /**
  * @brief Encodes a ParsedInstruction into between 1 and 3 machine words.
@@ -57,22 +81,12 @@ void encode_instruction(ParsedInstruction *instruction, AssemblerContext *ctx, i
  */
 void encode_data(ParsedDirective *directive, AssemblerContext *ctx, int *IC, int *DC);
 
-/**
- * @brief Encodes an operand into a word.
- * @param operand Pointer to the operand token to encode.
- * @param word Pointer to the word to modify.
- * @param is_source Flag indicating if the operand is a source operand.
- * @param is_relative Flag indicating if the operand uses relative addressing.
- * @note This function sets the appropriate addressing mode and operand value in the word.
- */
-
-void encode_operand(Token *operand, Word *word, int is_source, int is_relative);
-
 /**
  * @brief Encodes the first word that a parsed instruction will generate.
  * @param instruction Pointer to the parsed instruction to encode.
  * @param ctx Pointer to the assembler context.
  * @param IC Pointer to the instruction counter.
+ * @note The word is the first_word_table[] entry of the instruction and its operands' modes, with the register numbers OR-ed in.
  */
 void encode_first_word(ParsedInstruction *instruction, AssemblerContext *ctx, int *IC);
 
@@ -80,9 +94,21 @@ void encode_first_word(ParsedInstruction *instruction, AssemblerContext *ctx, in
 /**
  * @brief Encodes an operand into a word with additional information.
  * @param operand Pointer to the operand token to encode.
+ * @note If ctx->fixups exists, identifier operands are not resolved but recorded as fixups instead.
  */
 void encode_operand_extra(Token *operand, AssemblerContext *ctx, Word *word, AddressingMode add_mode, int current_IC);
 
+/**
+ * @brief Resolves a symbol operand into its extra word.
+ * @param operand Pointer to the identifier operand token.
+ * @param ctx Pointer to the assembler context.
+ * @param word Pointer to the word to modify.
+ * @param add_mode The addressing mode of the operand (direct or relative).
+ * @param current_IC The address of the word.
+ * @return 1 if the symbol was found, 0 otherwise (an error is reported).
+ */
+int encode_symbol(Token *operand, AssemblerContext *ctx, Word *word, AddressingMode add_mode, int current_IC);
+
 
 /* Field manipulation functions */
 /**
@@ -144,6 +170,13 @@ void word_set_are(Word *word, unsigned int are);
 
 void word_from_immediate(Word *word, int immediate);
 
+/**
+ * @brief Marks a word as a word of the data image.
+ * @param word Pointer to the word to modify.
+ * @note The flag is above the 24 bits of the word, so it is never written to the object files.
+ */
+void word_set_data(Word *word);
+
 /**
  * @brief Encodes an immediate value from a directive statement into a word.
  * @param word Pointer to the word to modify.
@@ -1,10 +1,11 @@
 /**
  * @file error.c
  * @brief Implementation of error handling functions.
- * @details This file contains functions for creating, destroying, and reporting errors.
- *          It includes functions for printing error messages and reporting errors
- *          to an array list. The error handling system is designed to be flexible and
- *          extensible, allowing for easy addition of new error types and messages.
+ * @details This file contains functions for reporting, formatting and printing errors.
+ *          A reported error only captures the arguments of its format into the arena of the log, the message
+ *          is formatted when it is printed. Errors are grouped into families - the same type, format and
+ *          arguments but the line number - found through an open addressing table, so repeated errors of
+ *          generated or badly broken sources are folded into a single record with a count.
  */
 
 #include "./error.h"
@@ -13,6 +14,12 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+
+#define HASH_MASK 0xFFFFFFFFUL
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+#define FAMILIES_INITIAL_CAPACITY 64
 
 /* Error types string LUT */
 static const char *error_type_str[] = {
@@ -49,83 +56,490 @@ static const char *error_type_str[] = {
     "Multiple Commas",
     "Syntax Number of Operands",
     "Syntax Addressing Mode",
-    "Symbol Not Found"
+    "Symbol Not Found",
+    "Link Object",
+    "Link Undefined Symbol",
+    "Link Duplicate Entry",
+    "Run Fault",
+    "Run External Symbol"
 };
 
-Error *error_create(ErrorType type, const char *message, va_list args) 
+/* FNV-1a over a run of bytes, continuing from a previous hash */
+static unsigned long hash_bytes(unsigned long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        hash = ((hash ^ bytes[i]) * FNV_PRIME) & HASH_MASK;
+
+    return hash;
+}
+
+/* Index of the line number argument of a "%s:%d: " (or %lu, %ld) location prefix, -1 if there is none */
+static int format_line_arg(const char *fmt)
+{
+    const char *c = fmt + 4;
+
+    if (strncmp(fmt, "%s:%", 4) != 0)
+        return -1;
+
+    if (*c == 'l')
+        c++;
+
+    return (*c == 'd' || *c == 'u') && c[1] == ':' ? 1 : -1;
+}
+
+/* Hash of a family - the type, the format and the arguments but the line number */
+static unsigned long family_hash(ErrorType type, const char *fmt, const ErrorArg *args, int count, int line_arg)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    int i;
+
+    hash = hash_bytes(hash, &type, sizeof(type));
+    hash = hash_bytes(hash, fmt, strlen(fmt));
+
+    for (i = 0; i < count; i++)
+    {
+        if (i == line_arg)
+            continue;
+
+        hash = hash_bytes(hash, &args[i].number, sizeof(args[i].number));
+        if (args[i].text)
+            hash = hash_bytes(hash, args[i].text, (size_t)args[i].number);
+    }
+
+    return hash;
+}
+
+/* Checks if a record belongs to the family of the given error */
+static int is_same_family(const Error *error, ErrorType type, const char *fmt, const ErrorArg *args, int count)
+{
+    int i;
+
+    if (error->type != type || error->arg_count != count || (error->format != fmt && strcmp(error->format, fmt) != 0))
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (i == error->line_arg)
+            continue;
+
+        if (error->args[i].number != args[i].number || !error->args[i].text != !args[i].text)
+            return 0;
+
+        if (args[i].text && memcmp(error->args[i].text, args[i].text, (size_t)args[i].number) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Returns the slot of a family in the table - either holding its last record or empty */
+static size_t family_slot(const ErrorLog *log, unsigned long hash, ErrorType type, const char *fmt,
+                          const ErrorArg *args, int count)
+{
+    size_t mask = log->family_capacity - 1;
+    size_t slot = hash & mask;
+    Error *error = NULL;
+
+    while (log->families[slot])
+    {
+        error = (Error *)array_list_get(log->records, log->families[slot] - 1);
+
+        if (error->family == hash && is_same_family(error, type, fmt, args, count))
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/* Doubles the table of families, returns 0 on failure */
+static int families_grow(ErrorLog *log)
 {
+    size_t *old_families = log->families;
+    size_t old_capacity = log->family_capacity;
+    size_t i, slot, capacity = old_capacity ? old_capacity * 2 : FAMILIES_INITIAL_CAPACITY;
     Error *error = NULL;
 
-    if (!message) 
+    log->families = (size_t *)MALLOC(capacity * sizeof(size_t));
+    if (!log->families)
+    {
+        log->families = old_families;
+        return 0;
+    }
+
+    memset(log->families, 0, capacity * sizeof(size_t));
+    log->family_capacity = capacity;
+
+    /* Every family is found through its last record */
+    for (i = 0; i < old_capacity; i++)
+    {
+        if (!old_families[i])
+            continue;
+
+        error = (Error *)array_list_get(log->records, old_families[i] - 1);
+        for (slot = error->family & (capacity - 1); log->families[slot]; slot = (slot + 1) & (capacity - 1))
+            ;
+        log->families[slot] = old_families[i];
+    }
+
+    if (old_families)
+        FREE(old_families);
+
+    return 1;
+}
+
+/* Adds an error with captured arguments to a log, returns the record it was stored in or folded into */
+static Error *error_log_add(ErrorLog *log, ErrorType type, const char *fmt, const ErrorArg *args, int count)
+{
+    int line_arg = format_line_arg(fmt);
+    long line = line_arg >= 0 && line_arg < count ? args[line_arg].number : 0;
+    unsigned long hash = family_hash(type, fmt, args, count, line_arg);
+    Error *last = NULL, *error = NULL;
+    char *text = NULL;
+    size_t slot;
+    int i;
+
+    log->total++;
+
+    /* Past the limit errors are only counted */
+    if (log->max_errors && log->total > log->max_errors)
         return NULL;
-    
-    error = (Error *)MALLOC(sizeof(Error));
-    
-    if (!error) 
+
+    if ((log->family_count + 1) * 2 > log->family_capacity && !families_grow(log))
+        return NULL;
+
+    slot = family_slot(log, hash, type, fmt, args, count);
+
+    if (log->families[slot])
+    {
+        last = (Error *)array_list_get(log->records, log->families[slot] - 1);
+
+        /* The same error again, or one more of a family that is already shown enough */
+        if (line_arg < 0 || line == last->args[line_arg].number || last->shown >= ERR_REPEAT_LIMIT)
+        {
+            last->repeats++;
+            if (line_arg >= 0)
+                last->last_line = line;
+            return last;
+        }
+    }
+
+    error = (Error *)arena_alloc(log->arena, sizeof(Error));
+    if (!error)
+        return NULL;
+
+    error->args = count ? (ErrorArg *)arena_alloc(log->arena, count * sizeof(ErrorArg)) : NULL;
+    if (count && !error->args)
         return NULL;
 
-    /* Format the message with the provided arguments */
     error->type = type;
-    vsprintf(error->message, message, args);
-    error->message[sizeof(error->message) - 1] = '\0'; 
+    error->format = fmt;
+    error->arg_count = count;
+    error->line_arg = line_arg;
+    error->family = hash;
+    error->shown = last ? last->shown + 1 : 1;
+    error->repeats = 0;
+    error->last_line = line;
+
+    /* The string arguments are copied, they may not outlive the caller */
+    for (i = 0; i < count; i++)
+    {
+        error->args[i] = args[i];
+
+        if (!args[i].text)
+            continue;
+
+        text = (char *)arena_alloc(log->arena, (size_t)args[i].number + 1);
+        if (!text)
+            return NULL;
+
+        memcpy(text, args[i].text, (size_t)args[i].number);
+        text[args[i].number] = '\0';
+        error->args[i].text = text;
+    }
+
+    array_list_append(log->records, error);
+
+    if (!last)
+        log->family_count++;
+    log->families[slot] = array_list_size(log->records);
 
     return error;
 }
 
-void error_destroy(void *error) 
+ErrorLog *error_log_create(unsigned long max_errors)
 {
-    Error *err = (Error *)error;
+    ErrorLog *log = (ErrorLog *)MALLOC(sizeof(ErrorLog));
+
+    if (!log)
+        return NULL;
+
+    memset(log, 0, sizeof(ErrorLog));
+    log->max_errors = max_errors;
+    log->arena = arena_create(ERR_ARENA_BLOCK_SIZE);
+    log->records = array_list_create(NULL);
 
-    if (!error) 
+    if (!log->arena || !log->records)
+    {
+        error_log_destroy(log);
+        return NULL;
+    }
+
+    return log;
+}
+
+void error_log_destroy(ErrorLog *log)
+{
+    if (!log)
         return;
-    
-    FREE(err);
-}  
 
+    if (log->records)
+        array_list_destroy(log->records);
+    if (log->arena)
+        arena_destroy(log->arena);
+    if (log->families)
+        FREE(log->families);
 
-void error_print(void *error) 
+    FREE(log);
+}
+
+void error_log_clear(ErrorLog *log)
 {
-    Error *err = (Error *)error;
+    if (!log)
+        return;
 
-    if (!error) 
+    array_list_clear(log->records);
+    arena_reset(log->arena);
+
+    if (log->families)
+        memset(log->families, 0, log->family_capacity * sizeof(size_t));
+
+    log->family_count = 0;
+    log->total = 0;
+}
+
+void error_log_merge(ErrorLog *dst, const ErrorLog *src)
+{
+    unsigned long total = 0;
+    Error *error = NULL, *merged = NULL;
+    size_t i;
+
+    if (!dst || !src)
         return;
-    
-    fprintf(stderr, "[%s] %s\n", error_type_str[err->type], err->message);
+
+    total = dst->total + src->total;
+
+    for (i = 0; i < error_record_count(src); i++)
+    {
+        error = error_record(src, i);
+        merged = error_log_add(dst, error->type, error->format, error->args, error->arg_count);
+
+        /* Keep the occurrences that were folded into the record */
+        if (merged && error->repeats)
+        {
+            merged->repeats += error->repeats;
+            merged->last_line = error->last_line;
+        }
+    }
+
+    dst->total = total;
 }
 
-void error_report(ArrayList *errors, ErrorType type, const char *fmt, ...) 
+unsigned long error_count(const ErrorLog *log)
 {
-    va_list args = {0};
-    Error *error = NULL;
+    return log ? log->total : 0;
+}
+
+size_t error_record_count(const ErrorLog *log)
+{
+    return log ? (size_t)array_list_size(log->records) : 0;
+}
+
+Error *error_record(const ErrorLog *log, size_t index)
+{
+    return log ? (Error *)array_list_get(log->records, index) : NULL;
+}
+
+int error_limit_reached(const ErrorLog *log)
+{
+    return log && log->max_errors && log->total >= log->max_errors;
+}
+
+/* Appends to a message, truncating it to the buffer */
+static void message_append(char *buffer, size_t size, size_t *length, const char *text, size_t count)
+{
+    if (*length + count >= size)
+        count = size - 1 - *length;
+
+    memcpy(buffer + *length, text, count);
+    *length += count;
+}
+
+size_t error_format(const Error *error, char *buffer, size_t size)
+{
+    char number[128];
+    const char *c = NULL;
+    const ErrorArg *arg = NULL;
+    size_t length = 0;
+    int i = 0;
+
+    if (!error || !buffer || size == 0)
+        return 0;
+
+    for (c = error->format; *c; c++)
+    {
+        if (*c != '%' || !c[1])
+        {
+            message_append(buffer, size, &length, c, 1);
+            continue;
+        }
+
+        if (*++c == '%')
+        {
+            message_append(buffer, size, &length, c, 1);
+            continue;
+        }
 
-    if (!errors) 
+        /* Skip the precision and the length, the captured argument already has them */
+        if (c[0] == '.' && c[1] == '*')
+            c += 2;
+        if (*c == 'l')
+            c++;
+
+        if (i >= error->arg_count)
+            break;
+
+        arg = &error->args[i++];
+
+        if (*c == 's')
+        {
+            message_append(buffer, size, &length, arg->text, (size_t)arg->number);
+            continue;
+        }
+
+        if (*c == 'u')
+            sprintf(number, "%lu", (unsigned long)arg->number);
+        else if (*c == 'c')
+            sprintf(number, "%c", (int)arg->number);
+        else
+            sprintf(number, "%ld", arg->number);
+
+        message_append(buffer, size, &length, number, strlen(number));
+    }
+
+    /* The occurrences folded into the record */
+    if (error->repeats)
+    {
+        if (error->line_arg < 0 || error->last_line == error->args[error->line_arg].number)
+            sprintf(number, " (reported %lu more time%s)", error->repeats, error->repeats == 1 ? "" : "s");
+        else
+            sprintf(number, " (and %lu more like it, up to line %ld)", error->repeats, error->last_line);
+
+        message_append(buffer, size, &length, number, strlen(number));
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
+
+void error_print(const Error *error)
+{
+    char message[ERR_MSG_MAX_LEN];
+
+    if (!error)
+        return;
+
+    error_format(error, message, sizeof(message));
+    fprintf(stderr, "[%s] %s\n", error_type_name(error->type), message);
+}
+
+const char *error_type_name(ErrorType type)
+{
+    return error_type_str[type];
+}
+
+void error_report(ErrorLog *log, ErrorType type, const char *fmt, ...)
+{
+    ErrorArg args[ERR_MAX_ARGS];
+    va_list ap;
+    const char *c = NULL;
+    long precision = 0;
+    int count = 0, is_long = 0;
+
+    if (!log || !fmt)
         return;
 
-    /* Create a new error */
-    va_start(args, fmt);
-    error = error_create(type, fmt, args);
-    va_end(args);
+    /* Capture the arguments in the order of the conversions of the format */
+    va_start(ap, fmt);
+    for (c = fmt; *c && count < ERR_MAX_ARGS; c++)
+    {
+        if (*c != '%' || !c[1])
+            continue;
+
+        if (*++c == '%')
+            continue;
+
+        precision = -1;
+        if (c[0] == '.' && c[1] == '*')
+        {
+            precision = va_arg(ap, int);
+            c += 2;
+        }
+
+        is_long = *c == 'l';
+        if (is_long)
+            c++;
+
+        args[count].text = NULL;
 
-    /* add to the list */
-    array_list_append(errors, error);
+        switch (*c)
+        {
+            case 's':
+                args[count].text = va_arg(ap, const char *);
+                if (!args[count].text)
+                    args[count].text = "(null)";
+
+                /* %.*s stops at the precision or the terminator, whichever comes first */
+                for (args[count].number = 0; (precision < 0 || args[count].number < precision) &&
+                                             args[count].text[args[count].number]; args[count].number++)
+                    ;
+                break;
+
+            case 'u':
+                args[count].number = is_long ? (long)va_arg(ap, unsigned long) : (long)va_arg(ap, unsigned int);
+                break;
+
+            default:
+                args[count].number = is_long ? va_arg(ap, long) : (long)va_arg(ap, int);
+                break;
+        }
+
+        count++;
+    }
+    va_end(ap);
+
+    error_log_add(log, type, fmt, args, count);
 }
 
 
-void error_report_all(ArrayList *errors)
+void error_report_all(ErrorLog *log)
 {
     size_t i;
-    Error *error = NULL;
 
-    if (!errors || array_list_size(errors) == 0) 
+    if (!log || error_record_count(log) == 0) 
         return;
 
     fprintf(stderr, "================================================ ERROR REPORT =================================================\n");
-    for (i = 0; i < array_list_size(errors); i++) {
-        error = (Error *)array_list_get(errors, i);
-        if (error) 
-            error_print(error);
-    }
+    for (i = 0; i < error_record_count(log); i++)
+        error_print(error_record(log, i));
+
+    if (error_limit_reached(log))
+        fprintf(stderr, "Stopped after %lu errors (--max-errors)\n", log->max_errors);
     fprintf(stderr, "===============================================================================================================\n");
 
-    array_list_clear(errors);
+    error_log_clear(log);
 }
@@ -1,8 +1,8 @@
 /**
  *  @file error.h
  *  @brief Header file for error handling in the assembler. 
- *  @details This file contains the definition of the Error structure, error types, 
- * *          and function prototypes for creating, destroying, and reporting errors.
+ *  @details This file contains the definition of the Error and ErrorLog structures, error types,
+ *          and function prototypes for reporting, formatting and printing errors.
  *  @note The error handling system is designed to be flexible and extensible, allowing
  *        for easy addition of new error types and messages.
  */
@@ -14,8 +14,12 @@
 #include <stdarg.h>
 
 #include "../data_structures/array_list.h"
+#include "../data_structures/arena.h"
 
-#define ERR_MSG_MAX_LEN 256
+#define ERR_MSG_MAX_LEN 256                     /* Size of the buffer a message is formatted into */
+#define ERR_MAX_ARGS 8                          /* Maximum number of arguments of a format */
+#define ERR_REPEAT_LIMIT 8                      /* Records of a family before its next occurrences are folded */
+#define ERR_ARENA_BLOCK_SIZE 4096
 
 /* Error types */
 
@@ -73,56 +77,152 @@ typedef enum {
     ERR_SYNTAX_NUM_OPERANDS,
     ERR_SYNTAX_ADD_MOD,
 
-    ERR_SYMBOL_NOT_FOUND
+    ERR_SYMBOL_NOT_FOUND,
+
+    /* Linker errors */
+    ERR_LINK_OBJECT,
+    ERR_LINK_UNDEFINED,
+    ERR_LINK_DUPLICATE,
+
+    /* Simulator errors */
+    ERR_RUN_FAULT,
+    ERR_RUN_EXTERNAL
 } ErrorType;
 
 
+/* Error argument structure */
+/* A single argument of the format of a diagnostic, as captured when it is reported */
+
+typedef struct {
+    long number;                                /* Value of an integer argument, length of a string argument */
+    const char *text;                           /* Copy of a string argument, NULL for an integer argument */
+} ErrorArg;
+
 /* Error structure */
+/* A compact diagnostic - the format and its arguments, only formatted into a message when printed */
+
 typedef struct {
-    ErrorType type;
-    char message[ERR_MSG_MAX_LEN];
+    ErrorType type;                             /* Type of the error */
+    const char *format;                         /* printf like format of the message, a string literal */
+    ErrorArg *args;                             /* The captured arguments of the format */
+    int arg_count;                              /* Number of arguments */
+    int line_arg;                               /* Index of the line number argument, -1 if the message has no location */
+    unsigned long family;                       /* Hash of everything but the line number */
+    int shown;                                  /* Number of records of the family, up to and including this one */
+    unsigned long repeats;                      /* Number of later occurrences folded into this record */
+    long last_line;                             /* Line of the last occurrence folded into this record */
 } Error;
 
+/* Error log structure */
+/* The diagnostics of a single file, in report order */
+
+typedef struct {
+    Arena *arena;                               /* Arena owning the records and their string arguments */
+    ArrayList *records;                         /* List of Error records */
+    size_t *families;                           /* Open addressing table - 1 + index of the last record of every family */
+    size_t family_capacity;                     /* Capacity of families, a power of 2 */
+    size_t family_count;                        /* Number of families */
+    unsigned long total;                        /* Number of reported errors, folded and dropped ones included */
+    unsigned long max_errors;                   /* Errors reported before the file is stopped, 0 for no limit */
+} ErrorLog;
+
 /* Function prototypes */
 /**
- * @brief Creates a new error.
- * @param type The type of the error.
- * @param message The error message format string.
- * @param args The variable argument list for the error message.
- * @return Pointer to the newly created error.
- * @note The caller is responsible for freeing the error using error_destroy().
+ * @brief Creates a new error log.
+ * @param max_errors Number of errors after which error_limit_reached() is true, 0 for no limit.
+ * @return Pointer to the newly created error log, or NULL on failure.
+ * @note The caller is responsible for freeing the log using error_log_destroy().
  */
-Error *error_create(ErrorType type, const char *message, va_list args);
+ErrorLog *error_log_create(unsigned long max_errors);
 
 /**
- * @brief Destroys an error and frees its memory.
- * @param error Pointer to the error to destroy.
- * @note Frees the error structure and its contents.
+ * @brief Destroys an error log and all of its records.
+ * @param log Pointer to the error log to destroy.
  */
-void error_destroy(void *error);
+void error_log_destroy(ErrorLog *log);
+
+/**
+ * @brief Removes all the records of an error log, keeping its storage.
+ * @param log Pointer to the error log to clear.
+ */
+void error_log_clear(ErrorLog *log);
+
+/**
+ * @brief Reports the records of an error log into another one, in order.
+ * @param dst Pointer to the error log receiving the records.
+ * @param src Pointer to the error log to merge, it is left unchanged.
+ */
+void error_log_merge(ErrorLog *dst, const ErrorLog *src);
+
+/**
+ * @brief Returns the number of reported errors.
+ * @param log Pointer to the error log.
+ * @return The number of reported errors, including the ones folded into another record or dropped by the limit.
+ */
+unsigned long error_count(const ErrorLog *log);
+
+/**
+ * @brief Returns the number of records of an error log.
+ * @param log Pointer to the error log.
+ * @return The number of records, each one printed as a single message.
+ */
+size_t error_record_count(const ErrorLog *log);
+
+/**
+ * @brief Returns a record of an error log.
+ * @param log Pointer to the error log.
+ * @param index Index of the record, in report order.
+ * @return Pointer to the record, owned by the log.
+ */
+Error *error_record(const ErrorLog *log, size_t index);
+
+/**
+ * @brief Checks if the error limit of a log was reached.
+ * @param log Pointer to the error log.
+ * @return 1 if the file should not be assembled any further (--max-errors), 0 otherwise.
+ */
+int error_limit_reached(const ErrorLog *log);
+
+/**
+ * @brief Formats the message of an error.
+ * @param error Pointer to the error to format.
+ * @param buffer The buffer to format the message into, always null terminated.
+ * @param size Size of the buffer, the message is truncated to fit.
+ * @return The length of the formatted message.
+ * @note A record with folded occurrences ends with their count.
+ */
+size_t error_format(const Error *error, char *buffer, size_t size);
 
 /**
  * @brief Prints the error message to stderr.
  * @param error Pointer to the error to print.
  */
-void error_print(void *error);
+void error_print(const Error *error);
+
+/**
+ * @brief Returns the name of an error type, as printed in the error report.
+ * @param type The type of the error.
+ * @return The name of the error type.
+ */
+const char *error_type_name(ErrorType type);
 
 /**
- * @brief Reports an error and adds it to the list of errors.
- * @param errors Pointer to the list of errors.
+ * @brief Reports an error and adds it to the log.
+ * @param log Pointer to the error log.
  * @param type The type of the error.
- * @param fmt The format string for the error message.
- * @param ... The variable arguments for the error message.
- * @note The error is created and added to the list of errors.array_list
- *       This function does not print the error message.
+ * @param fmt The format string for the error message - a string literal, it is kept as is until printed.
+ * @param ... The variable arguments for the error message (%d, %ld, %lu, %c, %s and %.*s).
+ * @note Only the arguments are captured, the message is formatted when printed. An error that differs from an
+ *       earlier one only by its line number is folded into the last of them after ERR_REPEAT_LIMIT records,
+ *       and an identical one is always folded. Errors past the limit of the log are only counted.
  */
-void error_report(ArrayList *errors, ErrorType type, const char *fmt, ...);
+void error_report(ErrorLog *log, ErrorType type, const char *fmt, ...);
 
 /**
- * @brief Prints all errors in the list and clears the list.
- * @param errors Pointer to the list of errors.
- * @note This function prints all errors in the list and frees them.
+ * @brief Prints all errors in the log and clears the log.
+ * @param log Pointer to the error log.
+ * @note Ends with a note if the file was stopped by the error limit.
  */
-void error_report_all();
+void error_report_all(ErrorLog *log);
 
-#endif /* ERROR_H */
\ No newline at end of file
+#endif /* ERROR_H */
@@ -16,17 +16,93 @@
 #include "../main/assembler.h"
 #include "../assembly/first_pass.h"
 
-ArrayList *file_read_lines(const char *filename)
+/* Splits the buffer into lines in place, a last line without a newline is a line as well */
+static int file_split_lines(SourceFile *source)
+{
+    char *pos = source->buffer, *end = source->buffer + source->size, *newline = NULL;
+    size_t count = 0;
+
+    /* Count the lines first so the views are allocated once */
+    while (pos < end && (newline = (char *)memchr(pos, '\n', end - pos)) != NULL)
+    {
+        count++;
+        pos = newline + 1;
+    }
+
+    if (pos < end)
+        count++;
+
+    source->lines = (StringView *)MALLOC((count ? count : 1) * sizeof(StringView));
+    if (!source->lines)
+        return 0;
+
+    /* Replace every newline with a null terminator and record the line */
+    for (pos = source->buffer; pos < end; pos = newline + 1)
+    {
+        newline = (char *)memchr(pos, '\n', end - pos);
+        if (!newline)
+            newline = end;
+
+        *newline = '\0';
+        source->lines[source->line_count].str = pos;
+        source->lines[source->line_count].length = newline - pos;
+        source->line_count++;
+    }
+
+    return 1;
+}
+
+char *file_read_contents(const char *path, size_t *size)
 {
     FILE *file = NULL;
-    ArrayList *lines = NULL;
-    int c;
-    long pos;
+    long file_size = 0;
+    char *buffer = NULL;
+
+    if (!path || !size)
+        return NULL;
+
+    file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    
+    /* Get the file size */
+    if (fseek(file, 0, SEEK_END) != 0 || (file_size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    /* Read the whole file at once - one extra byte for the terminator */
+    buffer = (char *)MALLOC((size_t)file_size + 1);
+    if (!buffer)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    *size = fread(buffer, 1, (size_t)file_size, file);
+    buffer[*size] = '\0';
+
+    if (ferror(file))
+    {
+        FREE(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    return buffer;
+}
+
+int file_read_source(const char *filename, SourceFile *source)
+{
     char *full_path = NULL;
     size_t full_path_len = 0;
 
-    if (!filename) 
-        return NULL;
+    if (!filename || !source) 
+        return 0;
+
+    memset(source, 0, sizeof(SourceFile));
 
     /* add extension */
     full_path_len = strlen(filename) + strlen(ASM_EXT) + 1;
@@ -34,246 +110,744 @@ ArrayList *file_read_lines(const char *filename)
     /* Complete the full path with extension */
     full_path = (char *)MALLOC(full_path_len);
     if (!full_path)
-        return NULL;
+        return 0;
     
     strcpy(full_path, filename);
     strcat(full_path, ASM_EXT);
 
-    file = fopen(full_path, "r");
-    if (!file)
+    /* The extra byte after the contents terminates a last line without a newline */
+    source->buffer = file_read_contents(full_path, &source->size);
+    if (!source->buffer)
     {   
         error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", full_path);
         FREE(full_path);
-        return NULL;
+        return 0;
     } 
-    
-    lines = array_list_create(free_string);
-    
-    if (!lines) 
+
+    if (!file_split_lines(source))
     {
-        fclose(file);
+        file_source_destroy(source);
         FREE(full_path);
-        return NULL;
+        return 0;
+    }
+
+    FREE(full_path);
+    return 1;
+}
+
+int file_source_from_buffer(const char *buffer, size_t size, SourceFile *source)
+{
+    if (!buffer || !source)
+        return 0;
+
+    memset(source, 0, sizeof(SourceFile));
+
+    /* The lines are split in place, so the source is copied - one extra byte for the terminator */
+    source->buffer = (char *)MALLOC(size + 1);
+    if (!source->buffer)
+        return 0;
+
+    memcpy(source->buffer, buffer, size);
+    source->size = size;
+    source->buffer[size] = '\0';
+
+    if (!file_split_lines(source))
+    {
+        file_source_destroy(source);
+        return 0;
+    }
+
+    return 1;
+}
+
+void file_source_destroy(SourceFile *source)
+{
+    if (!source)
+        return;
+
+    if (source->lines)
+        FREE(source->lines);
+
+    if (source->buffer)
+        FREE(source->buffer);
+
+    memset(source, 0, sizeof(SourceFile));
+}
+
+/* Reads the next bytes of a source into a block, returns the number of bytes read */
+static size_t source_reader_fill(SourceReader *reader, char *block, size_t size)
+{
+    size_t count = 0;
+
+    if (reader->file)
+        return fread(block, 1, size, reader->file);
+
+    count = reader->source_size - reader->source_offset;
+    if (count > size)
+        count = size;
+
+    memcpy(block, reader->source + reader->source_offset, count);
+    reader->source_offset += count;
+
+    return count;
+}
+
+int source_reader_open(SourceReader *reader, const char *filename, const char *source, size_t size)
+{
+    char *full_path = NULL;
+
+    if (!reader || (!filename && !source))
+        return 0;
+
+    memset(reader, 0, sizeof(SourceReader));
+
+    if (source)
+    {
+        reader->source = source;
+        reader->source_size = size;
     }
+    else
+    {
+        full_path = (char *)MALLOC(strlen(filename) + strlen(ASM_EXT) + 1);
+        if (!full_path)
+            return 0;
 
+        strcpy(full_path, filename);
+        strcat(full_path, ASM_EXT);
 
-    for(;;) 
+        reader->file = fopen(full_path, "rb");
+        FREE(full_path);
+
+        if (!reader->file)
+            return 0;
+    }
+
+    /* One extra byte for the terminator of a last line without a newline */
+    reader->buffer = (char *)MALLOC(SOURCE_READER_BLOCK_SIZE + 1);
+    if (!reader->buffer)
     {
-        size_t i = 0;
-        size_t len = 0;
-        char *line = NULL;
-        
-        /* Mark the current position */
-        pos = ftell(file);
-
-        /* Check if we reached EOF */
-        if (pos == -1) 
+        source_reader_close(reader);
+        return 0;
+    }
+
+    reader->capacity = SOURCE_READER_BLOCK_SIZE;
+    return 1;
+}
+
+int source_reader_next(SourceReader *reader, StringView *line)
+{
+    char *newline = NULL, *new_buffer = NULL;
+    size_t count = 0;
+
+    if (!reader || !reader->buffer || !line)
+        return 0;
+
+    for (;;)
+    {
+        /* A whole line in the block */
+        newline = (char *)memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        if (newline)
         {
-            array_list_destroy(lines);
-            fclose(file);
-            FREE(full_path);
-            return NULL;
+            *newline = '\0';
+            line->str = reader->buffer + reader->start;
+            line->length = newline - line->str;
+            reader->start = newline + 1 - reader->buffer;
+            return 1;
         }
-        
-        /* Count characters until newline or EOF */
-        while ((c = fgetc(file)) != EOF && c != '\n') 
-            len++;
-        
-        /* If reached EOF with no characters - break */
-        if (c == EOF && len == 0)
-            break;
-            
-        /* Allocate exactly the right amount of memory (plus null terminator) */
-        line = (char *)MALLOC(len + 1);
-        if (!line)  
+
+        /* A last line without a newline */
+        if (reader->is_eof)
         {
-            array_list_destroy(lines);
-            fclose(file);
-            FREE(full_path);
-            return NULL;
+            if (reader->start >= reader->end)
+                return 0;
+
+            reader->buffer[reader->end] = '\0';
+            line->str = reader->buffer + reader->start;
+            line->length = reader->end - reader->start;
+            reader->start = reader->end;
+            return 1;
         }
 
-        /* Go back to the start of the line */
-        if (fseek(file, pos, SEEK_SET) != 0)  
+        /* Move the start of the line to the front of the block, grow it if the line fills it */
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+
+        if (reader->end == reader->capacity)
         {
-            FREE(line);
-            array_list_destroy(lines);
-            fclose(file);
-            FREE(full_path);
-            return NULL;
+            new_buffer = (char *)REALLOC(reader->buffer, reader->capacity * 2 + 1);
+            if (!new_buffer)
+                return 0;
+
+            reader->buffer = new_buffer;
+            reader->capacity *= 2;
         }
-        
-        /* Read the line into the allocated buffer */
-        while (i < len && (c = fgetc(file)) != EOF) 
-            line[i++] = (char)c;
-        
-        line[len] = '\0';
-        
-        /* Skip the newline that was already read */
-        if (c != EOF) 
-            fgetc(file);
-        
-        /* Add line to the list */
-        array_list_append(lines, line);
+
+        count = source_reader_fill(reader, reader->buffer + reader->end, reader->capacity - reader->end);
+        reader->end += count;
+        reader->is_eof = count == 0;
     }
+}
 
-    fclose(file);
-    FREE(full_path);
-    return lines;
+void source_reader_close(SourceReader *reader)
+{
+    if (!reader)
+        return;
+
+    if (reader->file)
+        fclose(reader->file);
+
+    if (reader->buffer)
+        FREE(reader->buffer);
+
+    memset(reader, 0, sizeof(SourceReader));
+}
+
+/* Hex digits LUT */
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Two decimal digits LUT - entry n holds the digits of n (00 - 99) */
+static const char decimal_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Makes room for at least extra more bytes in the buffer */
+static char *output_reserve(OutputBuffer *out, size_t extra)
+{
+    char *new_data = NULL;
+    size_t new_capacity = 0;
+
+    if (out->length + extra <= out->capacity)
+        return out->data + out->length;
+
+    new_capacity = out->capacity ? out->capacity : OUTPUT_BUFFER_INITIAL_CAPACITY;
+    while (new_capacity < out->length + extra)
+        new_capacity *= OUTPUT_BUFFER_GROWTH_FACTOR;
+
+    new_data = (char *)REALLOC(out->data, new_capacity);
+    if (!new_data)
+        return NULL;
+
+    out->data = new_data;
+    out->capacity = new_capacity;
+    return out->data + out->length;
 }
 
-void write_word_to_file(FILE *file, void *item)
+void output_init(OutputBuffer *out, size_t capacity)
 {
-    Word *word = (Word *)item;
-    fprintf(file, "%07d %06x\n", word->address, word->value);
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(OutputBuffer));
+
+    if (capacity)
+        output_reserve(out, capacity);
 }
 
-void write_symbol_to_file(FILE *file, void *item)
+void output_destroy(OutputBuffer *out)
 {
-    Symbol *symbol = (Symbol *)item;
-    fprintf(file, "%.*s %07u\n", (int)symbol->sv.length, symbol->sv.str, symbol->address);
+    if (!out)
+        return;
+
+    if (out->data)
+        FREE(out->data);
+
+    memset(out, 0, sizeof(OutputBuffer));
+}
+
+void output_append(OutputBuffer *out, const char *str, size_t length)
+{
+    char *dst = NULL;
+
+    if (!out || !str || !(dst = output_reserve(out, length)))
+        return;
+
+    memcpy(dst, str, length);
+    out->length += length;
+}
+
+void output_char(OutputBuffer *out, char c)
+{
+    char *dst = NULL;
+
+    if (!out || !(dst = output_reserve(out, 1)))
+        return;
+
+    *dst = c;
+    out->length++;
+}
+
+void output_decimal(OutputBuffer *out, long value, int width)
+{
+    char digits[OUTPUT_MAX_DIGITS];
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    int count = 0;
+
+    if (!out)
+        return;
+
+    /* Convert two digits at a time, from the end */
+    while (magnitude >= 100)
+    {
+        const char *pair = decimal_pairs + (magnitude % 100) * 2;
+        digits[OUTPUT_MAX_DIGITS - ++count] = pair[1];
+        digits[OUTPUT_MAX_DIGITS - ++count] = pair[0];
+        magnitude /= 100;
+    }
+
+    if (magnitude >= 10)
+    {
+        digits[OUTPUT_MAX_DIGITS - ++count] = decimal_pairs[magnitude * 2 + 1];
+        digits[OUTPUT_MAX_DIGITS - ++count] = decimal_pairs[magnitude * 2];
+    }
+    else
+        digits[OUTPUT_MAX_DIGITS - ++count] = (char)('0' + magnitude);
+
+    /* Same as printf's zero padding - the sign counts in the width */
+    if (value < 0)
+    {
+        output_char(out, '-');
+        width--;
+    }
+
+    while (width-- > count)
+        output_char(out, '0');
+
+    output_append(out, digits + OUTPUT_MAX_DIGITS - count, count);
 }
 
-void create_output_file(AssemblerContext *ctx, const char *extension, ArrayList *data_list, void (*write_func)(FILE*, void*))
+void output_hex(OutputBuffer *out, unsigned long value, int width)
+{
+    char digits[OUTPUT_MAX_DIGITS];
+    int count = 0;
+
+    if (!out)
+        return;
+
+    do
+    {
+        digits[OUTPUT_MAX_DIGITS - ++count] = hex_digits[value & 0xF];
+        value >>= 4;
+    } while (value);
+
+    while (width-- > count)
+        output_char(out, '0');
+
+    output_append(out, digits + OUTPUT_MAX_DIGITS - count, count);
+}
+
+void output_u32(OutputBuffer *out, unsigned long value)
+{
+    char bytes[OBJ_BIN_FIELD_SIZE];
+
+    bytes[0] = (char)(value & 0xFF);
+    bytes[1] = (char)((value >> 8) & 0xFF);
+    bytes[2] = (char)((value >> 16) & 0xFF);
+    bytes[3] = (char)((value >> 24) & 0xFF);
+
+    output_append(out, bytes, OBJ_BIN_FIELD_SIZE);
+}
+
+/* Renames a written temporary file over its destination, or removes it if it was not written */
+static int output_replace(const char *tmp_filename, const char *filename, int is_written)
+{
+    /* Replace the destination, some platforms do not rename over an existing file */
+    if (is_written && rename(tmp_filename, filename) != 0)
+    {
+        remove(filename);
+        is_written = rename(tmp_filename, filename) == 0;
+    }
+
+    if (!is_written)
+    {
+        error_report(NULL, ERR_FILE_OPEN, "Failed to write file: %s", filename);
+        remove(tmp_filename);
+    }
+
+    return is_written;
+}
+
+int output_write_file(OutputBuffer *out, const char *filename, int is_binary)
 {
     FILE *file = NULL;
-    char *output_filename = NULL;
-    char *ext = NULL;
-    size_t i = 0;
-    size_t ext_len = strlen(extension);
+    char *tmp_filename = NULL;
+    int is_written = 0;
 
-    if (!ctx || !ctx->filename || !data_list || array_list_size(data_list) == 0|| !write_func)
+    if (!out || !filename)
+        return 0;
+
+    /* Write next to the destination first so a reader never sees a partial file */
+    tmp_filename = (char *)MALLOC(strlen(filename) + strlen(TMP_EXT) + 1);
+    if (!tmp_filename)
+        return 0;
+
+    strcpy(tmp_filename, filename);
+    strcat(tmp_filename, TMP_EXT);
+
+    file = fopen(tmp_filename, is_binary ? "wb" : "w");
+    if (!file)
+    {
+        error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", tmp_filename);
+        FREE(tmp_filename);
+        return 0;
+    }
+
+    /* An empty buffer has no data to pass to fwrite */
+    is_written = out->length == 0 || fwrite(out->data, 1, out->length, file) == out->length;
+    is_written = fclose(file) == 0 && is_written;
+    is_written = output_replace(tmp_filename, filename, is_written);
+
+    FREE(tmp_filename);
+    return is_written;
+}
+
+int output_stream_open(OutputStream *stream, const char *filename)
+{
+    if (!stream || !filename)
+        return 0;
+
+    memset(stream, 0, sizeof(OutputStream));
+
+    stream->filename = STRDUP(filename);
+    stream->tmp_filename = (char *)MALLOC(strlen(filename) + strlen(TMP_EXT) + 1);
+    if (!stream->filename || !stream->tmp_filename)
+    {
+        output_stream_close(stream, 0);
+        return 0;
+    }
+
+    strcpy(stream->tmp_filename, filename);
+    strcat(stream->tmp_filename, TMP_EXT);
+
+    stream->file = fopen(stream->tmp_filename, "w");
+    if (!stream->file)
+    {
+        error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", stream->tmp_filename);
+        output_stream_close(stream, 0);
+        return 0;
+    }
+
+    output_init(&stream->buffer, OUTPUT_STREAM_FLUSH_SIZE);
+    return 1;
+}
+
+/* Writes the buffered output of a stream to its file */
+static void output_stream_flush(OutputStream *stream)
+{
+    if (stream->buffer.length && fwrite(stream->buffer.data, 1, stream->buffer.length, stream->file) != stream->buffer.length)
+        stream->is_failed = 1;
+
+    stream->buffer.length = 0;
+}
+
+void output_stream_line(OutputStream *stream, const char *line, size_t length)
+{
+    if (!stream || !stream->file)
         return;
 
+    output_append(&stream->buffer, line, length);
+    output_char(&stream->buffer, '\n');
+
+    if (stream->buffer.length >= OUTPUT_STREAM_FLUSH_SIZE)
+        output_stream_flush(stream);
+}
+
+int output_stream_close(OutputStream *stream, int keep)
+{
+    int is_kept = 0;
+
+    if (!stream)
+        return 0;
+
+    if (stream->file && keep)
+    {
+        output_stream_flush(stream);
+        is_kept = output_replace(stream->tmp_filename, stream->filename, fclose(stream->file) == 0 && !stream->is_failed);
+    }
+    else if (stream->file)
+    {
+        fclose(stream->file);
+        remove(stream->tmp_filename);
+    }
+
+    output_destroy(&stream->buffer);
+
+    if (stream->filename)
+        FREE(stream->filename);
+    if (stream->tmp_filename)
+        FREE(stream->tmp_filename);
+
+    memset(stream, 0, sizeof(OutputStream));
+    return is_kept;
+}
+
+void write_word_to_file(OutputBuffer *out, int address, Word word)
+{
+    output_decimal(out, address, 7);
+    output_char(out, ' ');
+    output_hex(out, word & WORD_MASK, 6);
+    output_char(out, '\n');
+}
+
+void write_symbol_to_file(OutputBuffer *out, void *item)
+{
+    Symbol *symbol = (Symbol *)item;
+
+    output_append(out, symbol->sv.str, symbol->sv.length);
+    output_char(out, ' ');
+    output_decimal(out, (unsigned int)symbol->address, 7);
+    output_char(out, '\n');
+}
+
+void output_object(OutputBuffer *out, AssemblerContext *ctx)
+{
+    size_t i;
+
+    /* Header - code and data lengths */
+    output_append(out, "     ", 5);
+    output_decimal(out, ctx->IC - INITIAL_IC - ctx->DC, 0);
+    output_char(out, ' ');
+    output_decimal(out, ctx->DC, 0);
+    output_char(out, '\n');
+
+    /* Both code and data sections - the code words first */
+    for (i = 0; i < ctx->image_size; i++)
+        if (!(ctx->image[i] & WORD_DATA_FLAG))
+            write_word_to_file(out, INITIAL_IC + i, ctx->image[i]);
+
+    for (i = 0; i < ctx->image_size; i++)
+        if (ctx->image[i] & WORD_DATA_FLAG)
+            write_word_to_file(out, INITIAL_IC + i, ctx->image[i]);
+}
+
+char *output_filename(AssemblerContext *ctx, const char *extension)
+{
+    char *filename = NULL;
+    char *ext = NULL;
+
+    if (!ctx || !ctx->filename || !extension)
+        return NULL;
+
     /* Allocate memory for filename with extension */
-    output_filename = (char *)MALLOC(strlen(ctx->filename) + ext_len + 1);
-    if (!output_filename)
-        return;
+    filename = (char *)MALLOC(strlen(ctx->filename) + strlen(extension) + 1);
+    if (!filename)
+        return NULL;
 
     /* Copy base filename and remove original extension */
-    output_filename = strcpy(output_filename, ctx->filename);
-    ext = strrchr(output_filename, '.');
+    strcpy(filename, ctx->filename);
+    ext = strrchr(filename, '.');
     if (ext)
         *ext = '\0';
 
     /* Add new extension */
-    strcat(output_filename, extension);
+    strcat(filename, extension);
+    return filename;
+}
 
-    /* Open file for writing */
-    file = fopen(output_filename, "w");
-    if (!file)
+int create_output_file(AssemblerContext *ctx, const char *extension, ArrayList *data_list, WriteFunction write_func)
+{
+    OutputBuffer out;
+    char *filename = NULL;
+    size_t i = 0;
+    int is_written = 0;
+
+    if (!ctx || !ctx->filename || !data_list || array_list_size(data_list) == 0|| !write_func)
+        return 0;
+
+    filename = output_filename(ctx, extension);
+    if (!filename)
+        return 0;
+
+    /* Format all the items into the buffer, then write the file at once */
+    output_init(&out, array_list_size(data_list) * OUTPUT_LINE_ESTIMATE);
+
+    for (i = 0; i < array_list_size(data_list); i++)
+        write_func(&out, array_list_get(data_list, i));
+
+    is_written = output_write_file(&out, filename, 0);
+
+    output_destroy(&out);
+    FREE(filename);
+    return is_written;
+}
+
+/* Writes the symbols of a list as (string table offset, address) pairs, advancing the string table offset */
+static void write_binary_symbols(OutputBuffer *out, ArrayList *symbols, unsigned long *name_offset)
+{
+    size_t i;
+
+    for (i = 0; i < array_list_size(symbols); i++)
     {
-        FREE(output_filename);
-        error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", output_filename);
-        return;
+        Symbol *symbol = (Symbol *)array_list_get(symbols, i);
+
+        output_u32(out, *name_offset);
+        output_u32(out, symbol->address);
+        *name_offset += symbol->sv.length + 1;
     }
+}
 
-    /* Write each item using the provided function */
-    for (i = 0; i < array_list_size(data_list); i++)
+/* Writes the null terminated names of a list to the string table */
+static void write_binary_names(OutputBuffer *out, ArrayList *symbols)
+{
+    size_t i;
+
+    for (i = 0; i < array_list_size(symbols); i++)
     {
-        void *item = array_list_get(data_list, i);
-        write_func(file, item);
+        Symbol *symbol = (Symbol *)array_list_get(symbols, i);
+
+        output_append(out, symbol->sv.str, symbol->sv.length);
+        output_char(out, '\0');
     }
+}
 
-    fclose(file);
-    FREE(output_filename);
+int create_binary_object_file(AssemblerContext *ctx)
+{
+    OutputBuffer out;
+    size_t i, code_count, data_count, entry_count, extern_count;
+    unsigned long names_size = 0;
+    char *filename = NULL;
+    int is_written = 0;
+
+    if (!ctx)
+        return 0;
+
+    filename = output_filename(ctx, OBJ_BIN_EXT);
+    if (!filename)
+        return 0;
+
+    data_count = ctx->DC;
+    code_count = ctx->image_size - data_count;
+    entry_count = array_list_size(ctx->entries);
+    extern_count = array_list_size(ctx->externals);
+
+    /* Size of the string table, padded to a whole field */
+    for (i = 0; i < entry_count; i++)
+        names_size += ((Symbol *)array_list_get(ctx->entries, i))->sv.length + 1;
+
+    for (i = 0; i < extern_count; i++)
+        names_size += ((Symbol *)array_list_get(ctx->externals, i))->sv.length + 1;
+
+    names_size = (names_size + OBJ_BIN_FIELD_SIZE - 1) / OBJ_BIN_FIELD_SIZE * OBJ_BIN_FIELD_SIZE;
+
+    output_init(&out, OBJ_BIN_HEADER_SIZE + names_size + 
+                (ctx->image_size + 2 * (entry_count + extern_count)) * OBJ_BIN_FIELD_SIZE);
+
+    /* Header */
+    output_append(&out, OBJ_BIN_MAGIC, OBJ_BIN_FIELD_SIZE);
+    output_u32(&out, OBJ_BIN_VERSION);
+    output_u32(&out, INITIAL_IC);
+    output_u32(&out, code_count);
+    output_u32(&out, data_count);
+    output_u32(&out, entry_count);
+    output_u32(&out, extern_count);
+    output_u32(&out, names_size);
+
+    /* The image as it is, data words keep their flag */
+    for (i = 0; i < ctx->image_size; i++)
+        output_u32(&out, ctx->image[i] & (WORD_MASK | WORD_DATA_FLAG));
+
+    /* Entries and externals tables, the names offsets continue from the entries to the externals */
+    names_size = 0;
+    write_binary_symbols(&out, ctx->entries, &names_size);
+    write_binary_symbols(&out, ctx->externals, &names_size);
+
+    /* String table */
+    write_binary_names(&out, ctx->entries);
+    write_binary_names(&out, ctx->externals);
+
+    while (out.length % OBJ_BIN_FIELD_SIZE)
+        output_char(&out, '\0');
+
+    is_written = output_write_file(&out, filename, 1);
+
+    output_destroy(&out);
+    FREE(filename);
+    return is_written;
 }
 
-void generate_output(AssemblerContext *ctx, int mode)
+/* Records an output file in ctx->outputs if it was written, OUTPUT_FILE_FAILED otherwise */
+static void output_record(AssemblerContext *ctx, unsigned int file, int is_written)
+{
+    ctx->outputs |= is_written ? file : OUTPUT_FILE_FAILED;
+}
+
+/* Writes the output files of generate_output() */
+static void generate_output_files(AssemblerContext *ctx, int mode)
 {
-    if (!ctx || !ctx->filename)
-        return;
 
     /* Generate IR files (.am) */
     if (mode == 0)
     {
+        OutputBuffer out;
         size_t i;
-        char *output_filename = NULL;
-        char *ext = NULL;
-        FILE *file = NULL;
 
-        /* Create IR file */
-        output_filename = (char *)MALLOC(strlen(ctx->filename) + 4);
-        if (!output_filename)
+        /* The passes read the lines from memory - the name is still kept for diagnostics */
+        ctx->ir_filename = output_filename(ctx, IR_EXT);
+        if (!ctx->ir_filename || (ctx->options && (ctx->options->no_am || ctx->options->no_output)))
             return;
 
-        output_filename = strcpy(output_filename, ctx->filename);
-        ext = strrchr(output_filename, '.');
-        if (ext)
-            *ext = '\0';
-
-        strcat(output_filename, IR_EXT);
-
-        file = fopen(output_filename, "w");
-        if (!file)
-        {
-            error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", output_filename);
-            FREE(output_filename);
-            return;
-        }
+        output_init(&out, array_list_size(ctx->preprocessed_lines) * OUTPUT_LINE_ESTIMATE);
 
         for (i = 0; i < array_list_size(ctx->preprocessed_lines); i++)
         {
             char *line = (char *)array_list_get(ctx->preprocessed_lines, i);
-            fprintf(file, "%s\n", line);
+            output_append(&out, line, strlen(line));
+            output_char(&out, '\n');
         }
 
-        fclose(file);
-        ctx->ir_filename = output_filename;
+        output_record(ctx, OUTPUT_FILE_AM, output_write_file(&out, ctx->ir_filename, 0));
+        output_destroy(&out);
     }
 
+    /* The results stay in the context */
+    if (ctx->options && ctx->options->no_output)
+        return;
+
     /* Generate object file (.ob) with code and data */
-    if (array_list_size(ctx->code_img))
+    if (ctx->image_size > (size_t)ctx->DC)
     {
-        size_t i;
-        FILE *file = NULL;
-        char *output_filename = NULL;
-        char *ext = NULL;
+        OutputBuffer out;
+        char *filename = output_filename(ctx, OBJ_EXT);
 
-        /* Create object file */
-        output_filename = (char *)MALLOC(strlen(ctx->filename) + 4);
-        if (!output_filename)
+        if (!filename)
             return;
 
-        output_filename = strcpy(output_filename, ctx->filename);
-        ext = strrchr(output_filename, '.');
-        if (ext)
-            *ext = '\0';
+        output_init(&out, (ctx->image_size + 1) * OUTPUT_LINE_ESTIMATE);
+        output_object(&out, ctx);
+        output_record(ctx, OUTPUT_FILE_OB, output_write_file(&out, filename, 0));
 
-        strcat(output_filename, OBJ_EXT);
+        output_destroy(&out);
+        FREE(filename);
 
-        file = fopen(output_filename, "w");
-        if (!file)
-        {
-            error_report(NULL, ERR_FILE_OPEN, "Failed to open file: %s", output_filename);
-            FREE(output_filename);
-            return;
-        }
-
-        fprintf(file, "     %d %d\n", ctx->IC - INITIAL_IC - ctx->DC, ctx->DC);
-        /* For object files, write both code and data sections */
-        for (i = 0; i < array_list_size(ctx->code_img); i++)
-        {
-            Word *word = (Word *)array_list_get(ctx->code_img, i);
-            write_word_to_file(file, word);
-        }
-
-        for (i = 0; i < array_list_size(ctx->data_img); i++)
-        {
-            Word *word = (Word *)array_list_get(ctx->data_img, i);
-            write_word_to_file(file, word);
-        }
-
-        fclose(file);
-        FREE(output_filename);
+        /* Generate binary object file (.obb) */
+        if (ctx->options && ctx->options->binary_object)
+            output_record(ctx, OUTPUT_FILE_OBB, create_binary_object_file(ctx));
     }
 
     /* Generate entries file (.ent) */
     if (array_list_size(ctx->entries))
-        create_output_file(ctx, ENT_EXT, ctx->entries, write_symbol_to_file);
+        output_record(ctx, OUTPUT_FILE_ENT, create_output_file(ctx, ENT_EXT, ctx->entries, write_symbol_to_file));
     
 
     /* Generate externals file (.ext) */
     if (array_list_size(ctx->externals))
-        create_output_file(ctx, EXT_EXT, ctx->externals, write_symbol_to_file);
+        output_record(ctx, OUTPUT_FILE_EXT, create_output_file(ctx, EXT_EXT, ctx->externals, write_symbol_to_file));
+}
+
+void generate_output(AssemblerContext *ctx, int mode)
+{
+    if (!ctx || !ctx->filename)
+        return;
+
+    stats_phase_begin(&ctx->stats, PHASE_OUTPUT);
+    generate_output_files(ctx, mode);
+    stats_phase_end(&ctx->stats);
 }
@@ -14,6 +14,8 @@
 #include <stdio.h>
 #include "../data_structures/array_list.h"
 #include "../main/assembler.h"
+#include "./string_view.h"
+#include "./code_gen.h"
 
 /* File extensions for different output files */
 #define ASM_EXT ".as"
@@ -21,34 +23,280 @@
 #define OBJ_EXT ".ob"
 #define ENT_EXT ".ent"
 #define EXT_EXT ".ext"
+#define TMP_EXT ".tmp"
+#define OBJ_BIN_EXT ".obb"
+
+/* Output files written for the context, kept in ctx->outputs */
+#define OUTPUT_FILE_AM (1U << 0)
+#define OUTPUT_FILE_OB (1U << 1)
+#define OUTPUT_FILE_ENT (1U << 2)
+#define OUTPUT_FILE_EXT (1U << 3)
+#define OUTPUT_FILE_OBB (1U << 4)
+#define OUTPUT_FILE_COUNT 5
+#define OUTPUT_FILE_FAILED (1U << OUTPUT_FILE_COUNT)  /* One of the output files could not be written */
+
+/* Binary object file (.obb) */
+/* All the fields are 32 bit little endian, so the images can be mapped as uint32_t arrays on little endian hosts.
+ *
+ *   offset  field
+ *   0       magic "ASMO"
+ *   4       format version (OBJ_BIN_VERSION)
+ *   8       address of the first code word (INITIAL_IC)
+ *   12      number of code words
+ *   16      number of data words
+ *   20      number of entries
+ *   24      number of externals
+ *   28      size of the string table in bytes
+ *   32      the image - one 24 bit word in each 32 bit field, at consecutive addresses from the first address.
+ *           Code and data words are interleaved, bit 24 (WORD_DATA_FLAG) is set in the data words
+ *           entries, then externals - 2 fields each: offset of the name in the string table, address
+ *           string table - null terminated names, padded with zeros to a multiple of 4 bytes
+ */
+#define OBJ_BIN_MAGIC "ASMO"
+#define OBJ_BIN_VERSION 2
+#define OBJ_BIN_HEADER_SIZE 32
+#define OBJ_BIN_FIELD_SIZE 4
+
+/* Output buffer setup */
+#define OUTPUT_BUFFER_INITIAL_CAPACITY 4096
+#define OUTPUT_BUFFER_GROWTH_FACTOR 2
+#define OUTPUT_LINE_ESTIMATE 16             /* Bytes per output line to reserve up front ("0000100 3c0004\n" is 15) */
+#define OUTPUT_MAX_DIGITS 24                /* Enough for the digits of any unsigned long */
+
+/* Output buffer - a whole output file is formatted in memory and written with a single fwrite */
+typedef struct {
+    char *data;                             /* Formatted output */
+    size_t length;                          /* Number of bytes used */
+    size_t capacity;                        /* Allocated capacity */
+} OutputBuffer;
 
 /* Function pointer type for writing different types of data to files */
-typedef void (*WriteFunction) (FILE *, void *);
+typedef void (*WriteFunction) (OutputBuffer *, void *);
+
+/* Source file read into a single buffer, split into lines in place */
+typedef struct {
+    char *buffer;                           /* File contents, every newline replaced by a null terminator */
+    size_t size;                            /* Number of bytes read */
+    StringView *lines;                      /* Views of the lines into the buffer (null terminated as well) */
+    size_t line_count;                      /* Number of lines */
+} SourceFile;
+
+/* Source reader setup */
+#define SOURCE_READER_BLOCK_SIZE 65536
+#define OUTPUT_STREAM_FLUSH_SIZE 65536
+
+/* Source file read a block at a time (--stream), only the block holding the current line is kept */
+typedef struct {
+    FILE *file;                             /* The source file, NULL for an in-memory source */
+    const char *source;                     /* The in-memory source */
+    size_t source_size;                     /* Size of the in-memory source */
+    size_t source_offset;                   /* Bytes of the in-memory source already read */
+    char *buffer;                           /* The block, the current line is null terminated in it */
+    size_t capacity;                        /* Allocated capacity of the block */
+    size_t start;                           /* Start of the bytes that were not handed out yet */
+    size_t end;                             /* End of the bytes read into the block */
+    int is_eof;                             /* Nothing is left to read */
+} SourceReader;
+
+/* Output file written while it is formatted - the buffer is flushed to the temporary file as it fills */
+typedef struct {
+    OutputBuffer buffer;                    /* Formatted output that was not flushed yet */
+    FILE *file;                             /* The temporary file */
+    char *filename;                         /* Name of the destination */
+    char *tmp_filename;                     /* Name of the temporary file */
+    int is_failed;                          /* A write failed, the file is not kept */
+} OutputStream;
+
+/**
+ * @brief Reads a whole file into a single buffer.
+ * @param path The path of the file to read.
+ * @param size Set to the number of bytes read.
+ * @return The allocated contents, null terminated (the terminator is not counted in size), or NULL on failure.
+ * @note The caller is responsible for freeing the contents using FREE().
+ */
+char *file_read_contents(const char *path, size_t *size);
+
+/**
+ * @brief Reads a source (.as) file into a single buffer and splits it into lines.
+ * @param filename The name of the file to read, without the extension.
+ * @param source The source file to fill.
+ * @return 1 on success, 0 on failure.
+ * @note The whole file is read with a single fread, the lines are views into the buffer and are not allocated one by one.
+ * @note The caller is responsible for freeing the source using file_source_destroy().
+ */
+int file_read_source(const char *filename, SourceFile *source);
+
+/**
+ * @brief Copies an in-memory source into a single buffer and splits it into lines, like file_read_source().
+ * @param buffer The source text, does not have to be null terminated.
+ * @param size The size of the source text in bytes.
+ * @param source The source file to fill.
+ * @return 1 on success, 0 on failure.
+ * @note The caller is responsible for freeing the source using file_source_destroy().
+ */
+int file_source_from_buffer(const char *buffer, size_t size, SourceFile *source);
+
+/**
+ * @brief Frees the buffer and lines of a source file.
+ * @param source The source file to free.
+ */
+void file_source_destroy(SourceFile *source);
+
+/**
+ * @brief Opens a source (.as) file, or an in-memory source, for reading a line at a time.
+ * @param reader The reader to open.
+ * @param filename The base name of the source file, its extension is added.
+ * @param source The in-memory source to read instead of the file, NULL to read the file.
+ * @param size The size of the in-memory source in bytes.
+ * @return 1 on success, 0 if the file could not be opened.
+ * @note The caller is responsible for closing the reader using source_reader_close().
+ */
+int source_reader_open(SourceReader *reader, const char *filename, const char *source, size_t size);
+
+/**
+ * @brief Reads the next line of a source.
+ * @param reader The reader.
+ * @param line Set to the line, without its newline and null terminated.
+ * @return 1 if a line was read, 0 at the end of the source.
+ * @note The line is only valid until the next call, a line longer than the block grows the block.
+ */
+int source_reader_next(SourceReader *reader, StringView *line);
+
+/**
+ * @brief Closes a source reader and frees its block.
+ * @param reader The reader to close.
+ */
+void source_reader_close(SourceReader *reader);
+
+/**
+ * @brief Initializes an output buffer.
+ * @param out The output buffer to initialize.
+ * @param capacity Number of bytes to reserve up front, 0 to reserve on the first write.
+ * @note The caller is responsible for freeing the buffer using output_destroy().
+ */
+void output_init(OutputBuffer *out, size_t capacity);
+
+/**
+ * @brief Frees the memory of an output buffer.
+ * @param out The output buffer to free.
+ */
+void output_destroy(OutputBuffer *out);
 
 /**
- * @brief Reads a file and returns its lines as an ArrayList of char*.
- * @param filename The name of the file to read.
- * @return An ArrayList containing the lines of the file. Each line is a char*.
- * @note The caller is responsible for freeing the ArrayList and its contents.
+ * @brief Appends a string to the output buffer.
+ * @param out The output buffer.
+ * @param str The string to append, it does not have to be null terminated.
+ * @param length The number of characters to append.
  */
+void output_append(OutputBuffer *out, const char *str, size_t length);
 
-ArrayList *file_read_lines(const char *filename);
+/**
+ * @brief Appends a single character to the output buffer.
+ * @param out The output buffer.
+ * @param c The character to append.
+ */
+void output_char(OutputBuffer *out, char c);
+
+/**
+ * @brief Appends a decimal number, zero padded to width like printf's "%0*ld".
+ * @param out The output buffer.
+ * @param value The value to append.
+ * @param width Minimum width of the number, including the sign.
+ */
+void output_decimal(OutputBuffer *out, long value, int width);
+
+/**
+ * @brief Appends a lowercase hex number, zero padded to width like printf's "%0*lx".
+ * @param out The output buffer.
+ * @param value The value to append.
+ * @param width Minimum width of the number.
+ */
+void output_hex(OutputBuffer *out, unsigned long value, int width);
+
+/**
+ * @brief Writes the buffer to a file with a single fwrite.
+ * @param out The output buffer to write.
+ * @param filename The name of the file to create.
+ * @param is_binary 1 to write the bytes as they are, 0 to write a text file.
+ * @return 1 on success, 0 on failure.
+ * @note The buffer is written to filename + ".tmp" first and then renamed over filename, 
+ *       so the file is either the old one or complete.
+ */
+int output_write_file(OutputBuffer *out, const char *filename, int is_binary);
+
+/**
+ * @brief Opens an output stream to a text file.
+ * @param stream The stream to open.
+ * @param filename The name of the file to create.
+ * @return 1 on success, 0 on failure.
+ * @note Like output_write_file(), the file is written to filename + ".tmp" and only renamed when it is closed.
+ */
+int output_stream_open(OutputStream *stream, const char *filename);
+
+/**
+ * @brief Writes a line to an output stream, followed by a newline.
+ * @param stream The stream to write to.
+ * @param line The line to write.
+ * @param length The length of the line.
+ * @note The buffer is flushed to the file once it holds OUTPUT_STREAM_FLUSH_SIZE bytes.
+ */
+void output_stream_line(OutputStream *stream, const char *line, size_t length);
+
+/**
+ * @brief Closes an output stream.
+ * @param stream The stream to close.
+ * @param keep 1 to rename the file into place, 0 to remove it.
+ * @return 1 if the file was kept, 0 otherwise.
+ */
+int output_stream_close(OutputStream *stream, int keep);
+
+/**
+ * @brief Appends a 32 bit little endian field to the output buffer.
+ * @param out The output buffer.
+ * @param value The value to append, only its low 32 bits are written.
+ */
+void output_u32(OutputBuffer *out, unsigned long value);
+
+/**
+ * @brief Writes the binary object file (.obb) of the assembled file.
+ * @param ctx The assembler context.
+ * @return 1 if the file was written, 0 otherwise.
+ * @note See the layout above OBJ_BIN_MAGIC.
+ */
+int create_binary_object_file(AssemblerContext *ctx);
 
 /**
- * @brief Writes an encoded word to a file.
- * @param file The file to write to.
- * @param item The word to write.
+ * @brief Writes an encoded word to an output buffer.
+ * @param out The output buffer to write to.
+ * @param address The address of the word.
+ * @param word The word to write.
  * @note The word is written in the format: <address> <value>.
  */
-void write_word_to_file(FILE *file, void *item);
+void write_word_to_file(OutputBuffer *out, int address, Word word);
 
 /**
- * @brief Writes a symbol to a file.
- * @param file The file to write to.
+ * @brief Writes a symbol to an output buffer.
+ * @param out The output buffer to write to.
  * @param item The symbol to write.
  * @note The symbol is written in the format: <symbol_name> <address>.
  */
-void write_symbol_to_file(FILE *file, void *item);
+void write_symbol_to_file(OutputBuffer *out, void *item);
+
+/**
+ * @brief Formats the contents of the object file (.ob) - the header, the code words and then the data words.
+ * @param out The output buffer to append to.
+ * @param ctx The assembler context.
+ */
+void output_object(OutputBuffer *out, AssemblerContext *ctx);
+
+/**
+ * @brief Builds the name of an output file from the source file name.
+ * @param ctx The assembler context.
+ * @param extension The file extension (e.g., ".am",".ob", ".ent", ".ext").
+ * @return The allocated file name, or NULL on failure.
+ * @note The caller is responsible for freeing the returned name.
+ */
+char *output_filename(AssemblerContext *ctx, const char *extension);
 
 /**
  * @brief Creates an output file with the specified extension and writes data to it.
@@ -56,14 +304,19 @@ void write_symbol_to_file(FILE *file, void *item);
  * @param extension The file extension (e.g., ".am",".ob", ".ent", ".ext").
  * @param data_list The list of data to write to the file.
  * @param write_func The function to write the data to the file.
+ * @return 1 if the file was written, 0 otherwise (nothing is written for an empty list).
  * @note The function will create a new file with the specified extension and write the data to it.
  */
-void create_output_file(AssemblerContext *ctx, const char *extension, ArrayList *data_list, WriteFunction write_func);
+int create_output_file(AssemblerContext *ctx, const char *extension, ArrayList *data_list, WriteFunction write_func);
 
 /**
  * @brief Generates output files based on the assembler context.
  * @param ctx The assembler context.
  * @param mode The mode of output generation (0 for preprocessing, 2 for final output).
+ * @note In preprocessing mode the .am file is not written if the no_am option is set, only ctx->ir_filename is set.
+ * @note The binary object file (.obb) is written next to the .ob file if the binary_object option is set.
+ * @note With the no_output option no file is written at all, the results are left in the context.
+ * @note Every file written is recorded in ctx->outputs (OUTPUT_FILE_*), a file that could not be written sets OUTPUT_FILE_FAILED.
  */
 void generate_output(AssemblerContext *ctx, int mode);
 
@@ -14,29 +14,60 @@
 #include <string.h>
 #include "./string_view.h"  
 
-/* Macros for easy size of look up tables */
-#define TABLE_SIZE(type, name) \
-    (sizeof(name) / sizeof(type))
-
+/* The instruction set - name, opcode, funct, number of operands, allowed source and destination modes */
+/* Expanded once into instruction_set[] and once into first_word_table[], so both always agree */
+#define INSTRUCTION_LIST(X) \
+    X("mov", OPCODE_MOV, FUNCT_NONE, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER) \
+    X("cmp", OPCODE_CMP, FUNCT_NONE, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER) \
+    X("add", OPCODE_ADD, FUNCT_ADD, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER) \
+    X("sub", OPCODE_SUB, FUNCT_SUB, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER) \
+    X("lea", OPCODE_LEA, FUNCT_NONE, 2, ADD_DIRECT, ADD_DIRECT | ADD_REGISTER) \
+    X("clr", OPCODE_CLR, FUNCT_CLR, 1, 0, ADD_DIRECT | ADD_REGISTER) \
+    X("not", OPCODE_NOT, FUNCT_NOT, 1, 0, ADD_DIRECT | ADD_REGISTER) \
+    X("inc", OPCODE_INC, FUNCT_INC, 1, 0, ADD_DIRECT | ADD_REGISTER) \
+    X("dec", OPCODE_DEC, FUNCT_DEC, 1, 0, ADD_DIRECT | ADD_REGISTER) \
+    X("jmp", OPCODE_JMP, FUNCT_JMP, 1, 0, ADD_DIRECT | ADD_RELATIVE) \
+    X("bne", OPCODE_BNE, FUNCT_BNE, 1, 0, ADD_DIRECT | ADD_RELATIVE) \
+    X("jsr", OPCODE_JSR, FUNCT_JSR, 1, 0, ADD_DIRECT | ADD_RELATIVE) \
+    X("red", OPCODE_RED, FUNCT_NONE, 1, 0, ADD_DIRECT | ADD_REGISTER) \
+    X("prn", OPCODE_PRN, FUNCT_NONE, 1, 0, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER) \
+    X("rts", OPCODE_RTS, FUNCT_NONE, 0, 0, 0) \
+    X("stop", OPCODE_STOP, FUNCT_NONE, 0, 0, 0)
 
 /* Instruction set LUT */
+#define INSTRUCTION_INFO(name, opcode, funct, operands, src, dst) {name, opcode, funct, operands, src, dst},
+
 InstructionInfo instruction_set[] = {
-    {"mov", OPCODE_MOV, FUNCT_NONE, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER},
-    {"cmp", OPCODE_CMP, FUNCT_NONE, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER},
-    {"add", OPCODE_ADD, FUNCT_ADD, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER},
-    {"sub", OPCODE_SUB, FUNCT_SUB, 2, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER, ADD_DIRECT | ADD_REGISTER},
-    {"lea", OPCODE_LEA, FUNCT_NONE, 2, ADD_DIRECT, ADD_DIRECT | ADD_REGISTER},
-    {"clr", OPCODE_CLR, FUNCT_CLR, 1, 0, ADD_DIRECT | ADD_REGISTER},
-    {"not", OPCODE_NOT, FUNCT_NOT, 1, 0, ADD_DIRECT | ADD_REGISTER},
-    {"inc", OPCODE_INC, FUNCT_INC, 1, 0, ADD_DIRECT | ADD_REGISTER},
-    {"dec", OPCODE_DEC, FUNCT_DEC, 1, 0, ADD_DIRECT | ADD_REGISTER},
-    {"jmp", OPCODE_JMP, FUNCT_JMP, 1, 0, ADD_DIRECT | ADD_RELATIVE},
-    {"bne", OPCODE_BNE, FUNCT_BNE, 1, 0, ADD_DIRECT | ADD_RELATIVE},
-    {"jsr", OPCODE_JSR, FUNCT_JSR, 1, 0, ADD_DIRECT | ADD_RELATIVE},
-    {"red", OPCODE_RED, FUNCT_NONE, 1, 0, ADD_DIRECT | ADD_REGISTER},
-    {"prn", OPCODE_PRN, FUNCT_NONE, 1, 0, ADD_IMMEDIATE | ADD_DIRECT | ADD_REGISTER},
-    {"rts", OPCODE_RTS, FUNCT_NONE, 0, 0, 0},
-    {"stop", OPCODE_STOP, FUNCT_NONE, 0, 0, 0}
+    INSTRUCTION_LIST(INSTRUCTION_INFO)
+};
+
+/* A mode index is legal if the allowed modes have its bit - the bits of the allowed masks follow the ADD_MOD_* values */
+#define MODE_LEGAL(allowed, index) ((index) > 0 && ((allowed) & (1 << ((index) - 1))))
+
+/* The addressing mode field of a mode index, no operand leaves the field 0 */
+#define MODE_FIELD(index, pos) ((index) > 0 ? (unsigned int)((index) - 1) << (pos) : 0U)
+
+/* A single entry - the word without the register numbers, and the legality of both modes */
+#define FIRST_WORD(opcode, funct, src, dst, s, d) \
+    { ((unsigned int)(opcode) << OPCODE_POS) | MODE_FIELD(s, SRC_ADD_MODE_POS) | MODE_FIELD(d, DST_ADD_MODE_POS) | \
+      ((unsigned int)(funct) << FUNCT_POS) | (ARE_ABSOLUTE << ARE_POS), \
+      (MODE_LEGAL(src, s) ? FIRST_WORD_SRC_LEGAL : 0) | (MODE_LEGAL(dst, d) ? FIRST_WORD_DST_LEGAL : 0) }
+
+/* All the destination modes for a source mode */
+#define FIRST_WORD_ROW(opcode, funct, src, dst, s) \
+    { FIRST_WORD(opcode, funct, src, dst, s, 0), FIRST_WORD(opcode, funct, src, dst, s, 1), \
+      FIRST_WORD(opcode, funct, src, dst, s, 2), FIRST_WORD(opcode, funct, src, dst, s, 3), \
+      FIRST_WORD(opcode, funct, src, dst, s, 4) }
+
+/* All the mode pairs of an instruction */
+#define FIRST_WORDS(name, opcode, funct, operands, src, dst) \
+    { FIRST_WORD_ROW(opcode, funct, src, dst, 0), FIRST_WORD_ROW(opcode, funct, src, dst, 1), \
+      FIRST_WORD_ROW(opcode, funct, src, dst, 2), FIRST_WORD_ROW(opcode, funct, src, dst, 3), \
+      FIRST_WORD_ROW(opcode, funct, src, dst, 4) },
+
+/* First word LUT, indexed by instruction and by the ADD_MOD_INDEX() of the source and destination modes */
+const FirstWord first_word_table[INSTRUCTION_COUNT][ADD_MOD_COUNT][ADD_MOD_COUNT] = {
+    INSTRUCTION_LIST(FIRST_WORDS)
 };
 
 /* Register set LUT */
@@ -46,8 +77,8 @@ RegisterInfo register_table[] = {
     };
 
 /* Directive set LUT */
-char *directives[] = {
-    "data", "string", "entry", "extern"
+DirectiveInfo directive_table[] = {
+    {"data", DIR_DATA}, {"string", DIR_STRING}, {"entry", DIR_ENTRY}, {"extern", DIR_EXTERN}
 };
 
 /* Addressing modes string LUT */
@@ -61,18 +92,57 @@ char *special_chars[] = {
 };
 
 
-int is_instruction(StringView sv) 
+/* Checks that the StringView is exactly the given keyword */
+static int keyword_eq(StringView sv, const char *keyword, size_t length)
+{
+    return sv.length == length && memcmp(sv.str, keyword, length) == 0;
+}
+
+/* Picks between the (at most two) instructions sharing a first letter, after checking the whole name */
+static int pick_instruction(StringView sv, int first, int second)
 {
-    size_t i;
+    if (keyword_eq(sv, instruction_set[first].name, 3))
+        return first;
+
+    if (second != INS_NONE && keyword_eq(sv, instruction_set[second].name, 3))
+        return second;
+
+    return INS_NONE;
+}
 
+/* Classifies an instruction name by its length and first letter, then one exact compare */
+static int instruction_index(StringView sv)
+{
     if (!sv.str)
-        return 0;
+        return INS_NONE;
 
-    for (i = 0; i < TABLE_SIZE(InstructionInfo, instruction_set); i++) 
-        if (strncmp(sv.str, instruction_set[i].name, sv.length) == 0)
-            return 1;
+    if (sv.length == 4)
+        return keyword_eq(sv, "stop", 4) ? INS_STOP : INS_NONE;
 
-    return 0;
+    if (sv.length != 3)
+        return INS_NONE;
+
+    switch (sv.str[0])
+    {
+        case 'a': return pick_instruction(sv, INS_ADD, INS_NONE);
+        case 'b': return pick_instruction(sv, INS_BNE, INS_NONE);
+        case 'c': return pick_instruction(sv, INS_CMP, INS_CLR);
+        case 'd': return pick_instruction(sv, INS_DEC, INS_NONE);
+        case 'i': return pick_instruction(sv, INS_INC, INS_NONE);
+        case 'j': return pick_instruction(sv, INS_JMP, INS_JSR);
+        case 'l': return pick_instruction(sv, INS_LEA, INS_NONE);
+        case 'm': return pick_instruction(sv, INS_MOV, INS_NONE);
+        case 'n': return pick_instruction(sv, INS_NOT, INS_NONE);
+        case 'p': return pick_instruction(sv, INS_PRN, INS_NONE);
+        case 'r': return pick_instruction(sv, INS_RED, INS_RTS);
+        case 's': return pick_instruction(sv, INS_SUB, INS_NONE);
+        default:  return INS_NONE;
+    }
+}
+
+int is_instruction(StringView sv) 
+{
+    return instruction_index(sv) != INS_NONE;
 }
 
 char *get_addressing_mode_str(AddressingMode mode) 
@@ -99,73 +169,89 @@ char *get_addressing_mode_str(AddressingMode mode)
     }
 }
 
-InstructionInfo *find_instruction(char *name) 
+InstructionInfo *find_instruction(StringView sv) 
 {
-    size_t i;
-    
-    if (!name)
-        return NULL;
-
-    for (i = 0; i < TABLE_SIZE(InstructionInfo, instruction_set); i++)
-        if (strcmp(name, instruction_set[i].name) == 0)
-            return &instruction_set[i];
+    int index = instruction_index(sv);
 
-    return NULL;
+    return index == INS_NONE ? NULL : &instruction_set[index];
 }
 
-int is_register(StringView sv) 
+int find_instruction_index(StringView sv)
 {
-    size_t i;
+    return instruction_index(sv);
+}
 
-    if (!sv.str)
-        return 0;
+const FirstWord *first_word(int instruction, AddressingMode src, AddressingMode dst)
+{
+    if (instruction < 0 || instruction >= INSTRUCTION_COUNT ||
+        ADD_MOD_INDEX(src) < 0 || ADD_MOD_INDEX(src) >= ADD_MOD_COUNT ||
+        ADD_MOD_INDEX(dst) < 0 || ADD_MOD_INDEX(dst) >= ADD_MOD_COUNT)
+        return NULL;
 
-    for (i = 0; i < TABLE_SIZE(RegisterInfo, register_table); i++) 
-        if (strncmp(sv.str, register_table[i].name, sv.length) == 0)
-            return 1;
+    return &first_word_table[instruction][ADD_MOD_INDEX(src)][ADD_MOD_INDEX(dst)];
+}
 
-    return 0;
+int is_register(StringView sv) 
+{
+    return find_register(sv) != NULL;
 }
 
-RegisterInfo *find_register(char *name) 
+RegisterInfo *find_register(StringView sv) 
 {
-    size_t i;
-    
-    if (!name)
+    /* Registers are exactly 'r' followed by a digit 0-7 */
+    if (!sv.str || sv.length != 2 || sv.str[0] != 'r' || sv.str[1] < '0' || sv.str[1] > '7')
         return NULL;
 
-    for (i = 0; i < TABLE_SIZE(RegisterInfo, register_table); i++)
-        if (strcmp(name, register_table[i].name) == 0)
-            return &register_table[i];
-
-    return NULL;
+    return &register_table[sv.str[1] - '0'];
 }
 
-Directive is_directive(StringView sv) 
+DirectiveInfo *find_directive(StringView sv) 
 {
-    size_t i;
+    DirectiveInfo *info = NULL;
 
     if (!sv.str)
-        return 0;
+        return NULL;
 
-    for (i = 0; i < TABLE_SIZE(char *, directives); i++) 
-        if (strncmp(sv.str, directives[i], sv.length) == 0)
-            return i + 1;
+    /* The directive names have distinct lengths, except "string" and "extern" */
+    switch (sv.length)
+    {
+        case 4:
+            info = &directive_table[DIR_DATA];
+            break;
 
-    return 0;
+        case 5:
+            info = &directive_table[DIR_ENTRY];
+            break;
+
+        case 6:
+            info = sv.str[0] == 's' ? &directive_table[DIR_STRING] : &directive_table[DIR_EXTERN];
+            break;
+
+        default:
+            return NULL;
+    }
+
+    return keyword_eq(sv, info->name, sv.length) ? info : NULL;
+}
+
+Directive is_directive(StringView sv) 
+{
+    DirectiveInfo *info = find_directive(sv);
+
+    return info ? info->dir + 1 : 0;
 }   
 
 int is_special_char(StringView sv) 
 {
-    size_t i;
-
-    if (!sv.str)
+    if (!sv.str || sv.length != 1)
         return 0;
 
-    for (i = 0; i < TABLE_SIZE(char *, special_chars); i++) 
-        if (strncmp(sv.str, special_chars[i], sv.length) == 0)
+    switch (sv.str[0])
+    {
+        case ',': case '.': case ':': case '&': case '#': case '"':
             return 1;
 
-    return 0;
+        default:
+            return 0;
+    }
 }
-        
@@ -118,6 +118,42 @@ typedef enum {
     DIR_EXTERN
 } Directive;
 
+/* Index of the instruction in instruction_set[] */
+#define INS_MOV  0
+#define INS_CMP  1
+#define INS_ADD  2
+#define INS_SUB  3
+#define INS_LEA  4
+#define INS_CLR  5
+#define INS_NOT  6
+#define INS_INC  7
+#define INS_DEC  8
+#define INS_JMP  9
+#define INS_BNE  10
+#define INS_JSR  11
+#define INS_RED  12
+#define INS_PRN  13
+#define INS_RTS  14
+#define INS_STOP 15
+#define INS_NONE -1
+#define INSTRUCTION_COUNT 16
+
+/* Addressing modes of the first word table, ADD_MOD_NONE (no operand) is index 0 */
+#define ADD_MOD_INDEX(mode) ((mode) + 1)
+#define ADD_MOD_COUNT 5
+
+/* Legality bits of a first word table entry */
+#define FIRST_WORD_SRC_LEGAL 1
+#define FIRST_WORD_DST_LEGAL 2
+
+/* First word table entry */
+/* The first word of an instruction for a pair of addressing modes - only the register numbers are missing */
+
+typedef struct {
+    unsigned int word;                      /* Opcode, addressing modes, funct and ARE set */
+    unsigned int legal;                     /* FIRST_WORD_SRC_LEGAL / FIRST_WORD_DST_LEGAL if the instruction allows the mode */
+} FirstWord;
+
 /* Instruction information structure */
 typedef struct {
     char *name;                             /* Instruction name */
@@ -143,6 +179,7 @@ typedef struct {
 /* Global variables */
 /* LUT's for all the above structures */
 extern InstructionInfo instruction_set[];
+extern const FirstWord first_word_table[INSTRUCTION_COUNT][ADD_MOD_COUNT][ADD_MOD_COUNT];
 extern RegisterInfo register_table[];
 extern DirectiveInfo directive_table[];
 extern char *AddressingMode_names[];
@@ -165,7 +202,7 @@ int is_register(StringView sv);
 /**
  * @brief Checks if the given string is a valid directive.
  * @param sv The string to check.
- * @return 1 if the string is a valid directive, i.e exists in the directive_table[] and 0 otherwise.
+ * @return The directive plus one if the string is a valid directive, i.e exists in the directive_table[] and 0 otherwise.
  */
 Directive is_directive(StringView sv);
 
@@ -180,15 +217,40 @@ int is_special_char(StringView sv);
  * @brief Checks if the given string is the name of an instruction.
  * @param sv The string to check.
  * @return The instruction information if the string is a valid instruction, NULL otherwise.
+ * @note The name must match exactly, a prefix of an instruction name is not an instruction.
+ */
+InstructionInfo *find_instruction(StringView sv);
+
+/**
+ * @brief Returns the index of an instruction in instruction_set[].
+ * @param sv The name of the instruction.
+ * @return The index (INS_MOV to INS_STOP), INS_NONE if sv is not an instruction.
+ */
+int find_instruction_index(StringView sv);
+
+/**
+ * @brief Returns the first word table entry of an instruction for a pair of addressing modes.
+ * @param instruction The index of the instruction in instruction_set[].
+ * @param src The addressing mode of the source operand, ADD_MOD_NONE if there is none.
+ * @param dst The addressing mode of the destination operand, ADD_MOD_NONE if there is none.
+ * @return The entry, NULL if the instruction or a mode is out of range.
+ * @note The table is built at compile time from instruction_set[], so this is a single indexed load.
  */
-InstructionInfo *find_instruction(char *name);
+const FirstWord *first_word(int instruction, AddressingMode src, AddressingMode dst);
 
 /**
  * @brief Checks if the given string is the name of a register.
  * @param sv The string to check.
  * @return The register information if the string is a valid register, NULL otherwise.
  */
-RegisterInfo *find_register(char *name);
+RegisterInfo *find_register(StringView sv);
+
+/**
+ * @brief Checks if the given string is the name of a directive (without the dot).
+ * @param sv The string to check.
+ * @return The directive information if the string is a valid directive, NULL otherwise.
+ */
+DirectiveInfo *find_directive(StringView sv);
 
 /**
  * @brief Returns the string representation of the given addressing mode.
@@ -13,6 +13,7 @@
 #include "./isa.h"
 #include "./util.h"
 #include "./error.h"
+#include "./parser.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -41,6 +42,41 @@ char *token_type_str[] = {
     "Extern"  
 };  
 
+/* Character classes used to find token boundaries */
+#define CHAR_WORD    0  /* Part of a multi-char token */
+#define CHAR_SPACE   1  /* Separates tokens */
+#define CHAR_SPECIAL 2  /* A single char token, see special_chars[] */
+
+#define W CHAR_WORD
+#define S CHAR_SPACE
+#define P CHAR_SPECIAL
+
+/* Character class LUT, indexed by the (unsigned) character */
+static const unsigned char char_class[256] = {
+    W, W, W, W, W, W, W, W, W, S, W, W, W, W, W, W,  /* 0x00 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x10 */
+    S, W, P, P, W, W, P, W, W, W, W, W, P, W, P, W,  /* 0x20 */
+    W, W, W, W, W, W, W, W, W, W, P, W, W, W, W, W,  /* 0x30 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x40 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x50 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x60 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x70 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x80 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0x90 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0xA0 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0xB0 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0xC0 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0xD0 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,  /* 0xE0 */
+    W, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W   /* 0xF0 */
+};
+
+#undef W
+#undef S
+#undef P
+
+#define CHAR_CLASS(c) (char_class[(unsigned char)(c)])
+
 char *get_type_str(TokenType type) 
 {
     if (type < 0 || type >= sizeof(token_type_str) / sizeof(token_type_str[0]))
@@ -49,33 +85,29 @@ char *get_type_str(TokenType type)
     return token_type_str[type];
 }
 
-Token *token_create(StringView sv, size_t line_number) 
+void token_init(Token *token, StringView sv, size_t line_number) 
 {
-    Token *token = NULL;
-    
-    if (!sv.str)
-        return NULL;
-    
-    token = (Token *)MALLOC(sizeof(Token));
     if (!token)
-        return NULL;
+        return;
     
-    token->sv = sv;
+    token->str = sv.str;
+    token->length = (unsigned short)sv.length;
     token->type = TOKEN_UNKNOWN;
-    token->line_number = line_number;
+    token->line_number = (unsigned int)line_number;
     token_identify(token);
-
-    return token;
 }
 
-void token_destroy(void *token) 
+StringView token_sv(const Token *token)
 {
-    Token *t = (Token *)token;
-    
-    if (!t)
-        return;
-    
-    FREE(t);
+    StringView sv = {0};
+
+    if (!token)
+        return sv;
+
+    sv.str = token->str;
+    sv.length = token->length;
+
+    return sv;
 }
 
 int is_identifier(StringView sv) 
@@ -104,16 +136,16 @@ void token_identify(Token *token)
     if (!token)
         return;
     
-    if (token->sv.length == 0)
+    if (token->length == 0)
         return;
 
     if (token->type != TOKEN_UNKNOWN)
         return;
 
     /* Check for special characters */
-    if (is_special_char(token->sv)) 
+    if (is_special_char(token_sv(token))) 
     {
-        switch (token->sv.str[0]) 
+        switch (token->str[0]) 
         {
             case ',':
                 token->type = TOKEN_COMMA;
@@ -136,14 +168,18 @@ void token_identify(Token *token)
         }
     }
 
+    /* Numbers and other words not starting with a letter are never keywords nor identifiers, their type comes from the context */
+    else if (!isalpha((unsigned char)token->str[0]))
+        return;
+
     /* Check for keywords */
-    else if (is_instruction(token->sv))
+    else if (is_instruction(token_sv(token)))
         token->type = TOKEN_INSTRUCTION;
     
-    else if (is_register(token->sv))
+    else if (is_register(token_sv(token)))
         token->type = TOKEN_REGISTER;
 
-    else if ((dir = is_directive(token->sv)))
+    else if ((dir = is_directive(token_sv(token))))
     {
         switch (dir - 1)
         {
@@ -167,7 +203,7 @@ void token_identify(Token *token)
         }
     }
 
-    else if (is_identifier(token->sv))
+    else if (is_identifier(token_sv(token)))
         token->type = TOKEN_IDENTIFIER;
             
 }
@@ -198,20 +234,17 @@ void identify_context(ArrayList *tokens, AssemblerContext *ctx)
         if (prev && prev->type == TOKEN_COLON && token->type == TOKEN_DOT)
         {
             StringView sv = {0};
-            sv = prev->sv;
+            sv = token_sv(prev);
 
             if (sv.str[sv.length] == '.')
                 error_report(ctx->errors, ERR_LABEL_MISSING_SPACE, "%s:%lu: Invalid label name - Missing whitespace between colon and directive",
-                             ctx->ir_filename, prev->line_number);
+                             ctx->ir_filename, (unsigned long)prev->line_number);
         }            
 
         /* Identify Immediate values */
         else if (next && token->type == TOKEN_HASH)
             next->type = TOKEN_IMM;
 
-        else if (prev && token->type == TOKEN_COMMA && prev->type == TOKEN_IMM)
-            token->type = TOKEN_IMM;
-
         /* Identify String Literals */
         else if (prev && token->type == TOKEN_COMMA && prev->type == TOKEN_STR_LIT)
             token->type = TOKEN_STR_LIT;
@@ -266,62 +299,156 @@ int lexer_next_line(Lexer *lexer, AssemblerContext *ctx)
     return 1;
 }
 
-void lexer_tokenize_line(Lexer *lexer, AssemblerContext *ctx, ArrayList *tokens)
+void lexer_feed_line(Lexer *lexer, char *line)
 {
-    Token *token = NULL;
-    StringView sv = {0};
-    size_t i = 0;
-    size_t start = 0;
-
-    if (!lexer)
+    if (!lexer || !line)
         return;
-    
-    while (i < lexer->current_line.length) 
+
+    lexer->current_line = sv_from_str(line);
+    lexer->cursor = 0;
+    lexer->line_number++;
+}
+
+int lexer_index_line(AssemblerContext *ctx, size_t line_number, Token *tokens, size_t count)
+{
+    TokenLine *new_lines = NULL;
+    size_t new_capacity = 0;
+    size_t i;
+
+    if (!ctx || line_number == 0)
+        return 0;
+
+    /* Grow the index if needed */
+    if (line_number > ctx->token_line_capacity)
+    {
+        new_capacity = ctx->token_line_capacity ? ctx->token_line_capacity : ARRAY_LIST_INITIAL_CAPACITY;
+        
+        while (new_capacity < line_number)
+            new_capacity *= ARRAY_LIST_GROWTH_FACTOR;
+
+        new_lines = (TokenLine *)REALLOC(ctx->token_lines, new_capacity * sizeof(TokenLine));
+        if (!new_lines)
+            return 0;
+
+        ctx->token_lines = new_lines;
+        ctx->token_line_capacity = new_capacity;
+    }
+
+    /* Lines without a recorded span are empty */
+    for (i = ctx->token_line_count; i < line_number - 1; i++)
+    {
+        ctx->token_lines[i].tokens = NULL;
+        ctx->token_lines[i].count = 0;
+    }
+
+    ctx->token_lines[line_number - 1].tokens = tokens;
+    ctx->token_lines[line_number - 1].count = count;
+
+    if (line_number > ctx->token_line_count)
+        ctx->token_line_count = line_number;
+
+    return 1;
+}
+
+/* Finds the token boundaries of a line - only counts them if line_tokens is NULL, otherwise also initializes them */
+static size_t lexer_scan_line(char *line, size_t length, Token *line_tokens, size_t line_number)
+{
+    size_t i = 0, start = 0, count = 0;
+
+    while (i < length) 
     {
         /* Skip whitespace */
-        while (i < lexer->current_line.length && (lexer->current_line.str[i] == ' ' || lexer->current_line.str[i] == '\t'))
+        while (i < length && CHAR_CLASS(line[i]) == CHAR_SPACE)
             i++;
 
         /* Check for end of line */
-        if (i >= lexer->current_line.length) 
+        if (i >= length) 
             break;
 
-        /* Check for single char tokens */
-        if (is_special_char(sv_from_parts(lexer->current_line.str + i, 1)))
-        {
-            sv = sv_from_str(lexer->current_line.str + i);
-            sv.length = 1;
-            
-            token = token_create(sv, lexer->line_number);
+        /* Single char tokens end right away, multi-char tokens at the next space or special char */
+        start = i++;
 
-            if (!token)
-                return;
-                
-            array_list_append(tokens, token);               
-            array_list_append(ctx->tokens, token);
-            i++;
-            continue;
-        }       
-        
-        /* Check for multi-char tokens */
-        start = i;
+        if (CHAR_CLASS(line[start]) == CHAR_WORD)
+            while (i < length && CHAR_CLASS(line[i]) == CHAR_WORD)
+                i++;
+
+        /* Set the token */
+        if (line_tokens)
+            token_init(&line_tokens[count], sv_from_parts(line + start, i - start), line_number);
 
-        while (i < lexer->current_line.length && 
-               !is_special_char(sv_from_parts(lexer->current_line.str + i, 1)) &&
-               lexer->current_line.str[i] != ' ' && lexer->current_line.str[i] != '\t')
+        count++;
+    } 
+
+    return count;
+}
+
+/* Returns the length of the line up to the directive of a well formed .data list, 0 for any other line */
+static size_t lexer_data_prefix(char *line, size_t length)
+{
+    size_t i = 0, start = 0;
+
+    while (i < length && CHAR_CLASS(line[i]) == CHAR_SPACE)
+        i++;
+
+    /* Optional label - a word and a colon */
+    start = i;
+    while (i < length && CHAR_CLASS(line[i]) == CHAR_WORD)
+        i++;
+
+    if (i > start)
+    {
+        while (i < length && CHAR_CLASS(line[i]) == CHAR_SPACE)
             i++;
 
+        if (i >= length || line[i] != ':')
+            return 0;
 
-        /* Set the token */
-        sv = sv_from_str(lexer->current_line.str + start);
-        sv.length = i - start;
+        for (i++; i < length && CHAR_CLASS(line[i]) == CHAR_SPACE; i++)
+            ;
+    }
 
-        token = token_create(sv, lexer->line_number);
+    /* The directive, separated from its values */
+    if (length - i < 6 || strncmp(line + i, ".data", 5) != 0 || CHAR_CLASS(line[i + 5]) != CHAR_SPACE)
+        return 0;
 
-        /* Add the token to the list */
-        array_list_append(tokens, token);
-        array_list_append(ctx->tokens, token);
-    } 
+    /* The values are parsed from the line by count_data_values() and encode_data() */
+    return count_data_values(line + i + 5) ? i + 5 : 0;
+}
+
+void lexer_tokenize_line(Lexer *lexer, AssemblerContext *ctx, ArrayList *tokens)
+{
+    Token *token = NULL;
+    Token *line_tokens = NULL;
+    size_t i = 0;
+    size_t count = 0;
+    size_t length = 0;
+
+    if (!lexer)
+        return;
+
+    /* A well formed .data list stays text, only the label and the directive are tokens */
+    length = lexer_data_prefix(lexer->current_line.str, lexer->current_line.length);
+    if (!length)
+        length = lexer->current_line.length;
+
+    /* Count the tokens first, so the line's tokens are allocated as one array (released with a streamed line) */
+    count = lexer_scan_line(lexer->current_line.str, length, NULL, 0);
+
+    if (count)
+    {
+        line_tokens = (Token *)ARENA_ALLOC(ctx->line_arena ? ctx->line_arena : ctx->arena, count * sizeof(Token));
+        if (!line_tokens)
+            return;
+
+        lexer_scan_line(lexer->current_line.str, length, line_tokens, lexer->line_number);
+    }
+
+    /* Add the tokens to the list */
+    for (i = 0; i < count; i++)
+        array_list_append(tokens, &line_tokens[i]);
+
+    /* Record the line's tokens in the token line index */
+    lexer_index_line(ctx, lexer->line_number, line_tokens, count);
 
     /* Identify token types from context */
     identify_context(tokens, ctx);
@@ -333,11 +460,11 @@ void lexer_tokenize_line(Lexer *lexer, AssemblerContext *ctx, ArrayList *tokens)
         if (token->type == TOKEN_UNKNOWN)
         {
             token->type = TOKEN_INVALID;
-            token->sv.str = NULL;
-            token->sv.length = 0;
+            token->str = NULL;
+            token->length = 0;
             
             error_report(ctx->errors, ERR_INVALID_TOKEN, "%s:%lu: Invalid token '%.*s'", 
-                        ctx->ir_filename, token->line_number, (int)token->sv.length, token->sv.str);
+                        ctx->ir_filename, (unsigned long)token->line_number, (int)token->length, token->str);
         }
     }
 }
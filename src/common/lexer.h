@@ -44,10 +44,12 @@ typedef enum {
 } TokenType;
 
 /* Token structure */
-typedef struct {
-    TokenType type;                     /* Type of the token */
-    StringView sv;                      /* String view of the token */
-    size_t line_number;                 /* Line number where the token was found */
+/* Tokens are stored by value, the tokens of a line are contiguous in the context's arena (see TokenLine). */
+typedef struct Token {
+    char *str;                          /* Start of the token in its line */
+    unsigned int line_number;           /* Line number where the token was found */
+    unsigned short length;              /* Length of the token (a line is at most MAX_LINE_LEN characters) */
+    unsigned char type;                 /* Type of the token (TokenType) */
 } Token;
 
 /* Lexer structure */
@@ -67,20 +69,19 @@ typedef struct {
 char *get_type_str(TokenType type);
 
 /**
- * @brief Creates a new token.
+ * @brief Initializes a token and identifies its type.
+ * @param token Pointer to the token to initialize.
  * @param sv The string view of the token.
  * @param line_number The line number where the token was found.
- * @return Pointer to the newly created token.
- * @note The caller is responsible for freeing the token using token_destroy().
  */
-Token *token_create(StringView sv, size_t line_number);
+void token_init(Token *token, StringView sv, size_t line_number);
 
 /**
- * @brief Destroys a token and frees its memory.
- * @param token Pointer to the token to destroy.
- * @note Frees the token structure and its contents.
+ * @brief Gets the text of a token.
+ * @param token Pointer to the token.
+ * @return The string view of the token.
  */
-void token_destroy(void *token);
+StringView token_sv(const Token *token);
 
 /**
  * @brief Identifies the type of the token.
@@ -120,11 +121,33 @@ void identify_context(ArrayList *tokens, AssemblerContext *ctx);
  */
 int lexer_next_line(Lexer *lexer, AssemblerContext *ctx);
 
+/**
+ * @brief Makes a line handed over by a streaming preprocessor the next line of the lexer.
+ * @param lexer Pointer to the lexer.
+ * @param line The preprocessed line, it has to live until the line is tokenized and parsed.
+ * @note Like lexer_next_line(), this function updates the current line and line number in the lexer.
+ */
+void lexer_feed_line(Lexer *lexer, char *line);
+
+/**
+ * @brief Records the tokens of a line in the token line index.
+ * @param ctx Pointer to the assembler context.
+ * @param line_number The (1 based) line number of the span.
+ * @param tokens The tokens of the line, NULL if there are none.
+ * @param count Number of tokens in the line.
+ * @return 1 on success, 0 on failure.
+ * @note The index grows as needed and is freed in asm_ctx_destroy().
+ */
+int lexer_index_line(AssemblerContext *ctx, size_t line_number, struct Token *tokens, size_t count);
+
 /**
  * @brief Tokenizes the current line and adds tokens to the list.
  * @param lexer Pointer to the lexer.
  * @param ctx Pointer to the assembler context.
  * @param tokens Pointer to the list of tokens to add to.
+ * @note The line's tokens are stored as one array in the context's arena and recorded in the token line index.
+ * @note The values of a well formed .data list are not tokenized, the passes parse them straight from the line
+ *       (see count_data_values()). A list with any error is fully tokenized, so its diagnostics are unchanged.
  */
 void lexer_tokenize_line(Lexer *lexer , AssemblerContext *ctx, ArrayList *tokens);
 
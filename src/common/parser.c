@@ -12,10 +12,43 @@
 #include "../common/util.h"
 #include "../common/isa.h"
 
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 
+Statement *statement_append(AssemblerContext *ctx, StatementType type, size_t line_number)
+{
+    Statement *new_statements = NULL;
+    Statement *statement = NULL;
+    size_t new_capacity = 0;
+
+    if (!ctx)
+        return NULL;
+
+    /* Grow the statements array if needed */
+    if (ctx->statement_count == ctx->statement_capacity)
+    {
+        new_capacity = ctx->statement_capacity ? ctx->statement_capacity * ARRAY_LIST_GROWTH_FACTOR : ARRAY_LIST_INITIAL_CAPACITY;
+
+        new_statements = (Statement *)REALLOC(ctx->statements, new_capacity * sizeof(Statement));
+        if (!new_statements)
+            return NULL;
+
+        ctx->statements = new_statements;
+        ctx->statement_capacity = new_capacity;
+    }
+
+    statement = &ctx->statements[ctx->statement_count++];
+    memset(statement, 0, sizeof(Statement));
+    statement->type = type;
+    statement->line_number = line_number;
+    statement->IC = ctx->IC;
+    statement->DC = ctx->DC;
+
+    return statement;
+}
+
 void parsed_instruction_init(ParsedInstruction *instruction)
 {
     if (!instruction)
@@ -23,6 +56,7 @@ void parsed_instruction_init(ParsedInstruction *instruction)
 
     instruction->label = NULL;
     instruction->instruction = NULL;
+    instruction->index = INS_NONE;
     instruction->rs = NULL;
     instruction->rs_add_mode = ADD_MOD_NONE;
     instruction->rt = NULL;
@@ -72,6 +106,7 @@ void parse_instruction(ParsedInstruction *instruction, ArrayList *tokens, Assemb
     /* Check for instruction token */
     instruction->operand_count = count_operands(tokens);
     instruction->instruction = (Token *)array_list_get(tokens, i);
+    instruction->index = find_instruction_index(token_sv(instruction->instruction));
     i++;
 
     /* Iterate through the tokens */
@@ -142,7 +177,7 @@ void parse_instruction(ParsedInstruction *instruction, ArrayList *tokens, Assemb
         if (instruction->operand_count == 2 && comma_count != 1)
             error_report(ctx->errors, ERR_INST_ILLEGAL_NUM_COMMA, "%s:%lu: Invalid number of commas in instruction '%.*s'",
                      ctx->ir_filename, ctx->line_number,
-                     (int)instruction->instruction->sv.length, instruction->instruction->sv.str);
+                     (int)instruction->instruction->length, instruction->instruction->str);
     }
 }
 
@@ -195,7 +230,7 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
     else 
     {
         error_report(ctx->errors, ERR_DIR_DOT_MISSING, "%s:%lu: Invalid directive statement - a dot is missing before the directive",
-                     ctx->ir_filename, token->line_number);
+                     ctx->ir_filename, (unsigned long)token->line_number);
         return;
                      
     }
@@ -216,50 +251,62 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
             if (next->type == TOKEN_COMMA)
             {
                 error_report(ctx->errors, ERR_DIR_STR_ILLEGAL_COMMA, "%s:%lu: Illegal comma in string directive - string directive cannot start with a comma",
-                             ctx->ir_filename, token->line_number);
+                             ctx->ir_filename, (unsigned long)token->line_number);
                 return;
             }
             
             else if (next->type != TOKEN_QUOTE)
             {
                 error_report(ctx->errors, ERR_DIR_STR_MISSING_QUOTE, "%s:%lu: Invalid string directive - expected a quote at the beginning of the string",
-                             ctx->ir_filename, token->line_number);
+                             ctx->ir_filename, (unsigned long)token->line_number);
                 return;
             }
 
 
         }
         
-        /* Updated DC */
-        for (i = 0; i < array_list_size(tokens); i++)
-        {
-            token = (Token *)array_list_get(tokens, i);
-            if (token->type == TOKEN_STR_LIT)
-                directive->code_word_count += strlen(token->sv.str);
-        }
-
         token = (Token *)array_list_get(tokens, array_list_size(tokens) - 1);
 
         /* Check for illegal commas and quotes at the end */
         if (token->type == TOKEN_COMMA)
         {
             error_report(ctx->errors, ERR_DIR_STR_ILLEGAL_COMMA, "%s:%lu: Illegal comma in string directive - string directive cannot end with a comma",
-                         ctx->ir_filename, token->line_number);
+                         ctx->ir_filename, (unsigned long)token->line_number);
             return;
         }
 
-        else if (token->type != TOKEN_QUOTE)
+        else if (token->type != TOKEN_QUOTE || token == next)
         {
             error_report(ctx->errors, ERR_DIR_STR_MISSING_QUOTE, "%s:%lu: Illegal token in string directive - expected a quote at the end of the string",
-                         ctx->ir_filename, token->line_number);
+                         ctx->ir_filename, (unsigned long)token->line_number);
             return;
         }
-                         
+
+        /* A single literal between the quotes - whitespace or a quote splits it into several tokens */
+        if (array_list_size(tokens) - i > 3 ||
+            (array_list_size(tokens) - i == 3 && ((Token *)array_list_get(tokens, i + 1))->type != TOKEN_STR_LIT))
+        {
+            error_report(ctx->errors, ERR_DIR_STR_MISSING_QUOTE, "%s:%lu: Invalid string directive - a string cannot contain whitespace, commas or quotes",
+                         ctx->ir_filename, (unsigned long)token->line_number);
+            return;
+        }
+
+        /* Updated DC - the characters of the literal (none for "") and the terminator */
+        if (array_list_size(tokens) - i == 3)
+            directive->code_word_count = (int)((Token *)array_list_get(tokens, i + 1))->length;
+
+        directive->code_word_count++;
     }
 
     /* Data directive */
     else if (directive->directive->type == TOKEN_DIR_DATA)
     {
+        /* Fast path - a well formed list is counted straight from the line, without walking its tokens */
+        directive->code_word_count = count_data_values(directive->directive->str + directive->directive->length);
+        if (directive->code_word_count)
+            return;
+
+        /* Otherwise the tokens are checked one by one, reporting the first error */
         for (i = 0; i < array_list_size(tokens); i++)
         { 
             Token *next = NULL;
@@ -273,9 +320,9 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
                 if (next && i != array_list_size(tokens)&& next->type != TOKEN_COMMA)
                 {
                     error_report(ctx->errors, ERR_DIR_DATA_ILLEGAL_COMMA, "%s:%lu: Missining comma between elements in data directive - expected comma after '%.*s', instead got '%.*s'",
-                                 ctx->ir_filename, token->line_number, 
-                                 (int)token->sv.length, token->sv.str,
-                                    (int)next->sv.length, next->sv.str);
+                                 ctx->ir_filename, (unsigned long)token->line_number, 
+                                 (int)token->length, token->str,
+                                    (int)next->length, next->str);
                     return;
                 }
 
@@ -293,7 +340,7 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
                 if (next && next->type == TOKEN_COMMA)
                 {
                     error_report(ctx->errors, ERR_DIR_MULTY_COMMAS, "%s:%lu: Multiple consecutive commas in data directive",
-                                 ctx->ir_filename, token->line_number);
+                                 ctx->ir_filename, (unsigned long)token->line_number);
                     return;
                 }
             }
@@ -304,7 +351,7 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
                 if (next->type == TOKEN_COMMA)
                 {
                     error_report(ctx->errors, ERR_DIR_DATA_ILLEGAL_COMMA, "%s:%lu: Illegal comma in data directive - integer list cannot start with a comma",
-                                 ctx->ir_filename, token->line_number);
+                                 ctx->ir_filename, (unsigned long)token->line_number);
                     return;                              
 
                 }
@@ -314,7 +361,7 @@ void parse_directive(ParsedDirective *directive, ArrayList *tokens, AssemblerCon
             {
                 if (token->type == TOKEN_COMMA)
                     error_report(ctx->errors, ERR_DIR_DATA_ILLEGAL_COMMA, "%s:%lu: Illegal comma in data directive - integer list cannot end with a comma",
-                                 ctx->ir_filename, token->line_number);
+                                 ctx->ir_filename, (unsigned long)token->line_number);
                 return;
             }
         }
@@ -472,26 +519,17 @@ int is_directive_statement(ArrayList *tokens)
 
 int validate_immediate(Token *token, AssemblerContext *ctx) 
 {
-    char *str = NULL;
-    char *endptr = NULL;
     long value;
     
     if (!token || !ctx || token->type != TOKEN_IMM)
         return 0;
     
-    str = STRDUP(token->sv.str);
-    if (!str) 
-        return 0;
-    
-    /* Check if it's a valid number (can have leading +/- sign) */
-    value = strtol(str, &endptr, DEC_BASE);
-    
-    if (*endptr != '\0') 
+    /* Check if it's a valid number (can have leading +/- sign), straight from the token */
+    if (!sv_to_long(token_sv(token), &value)) 
     {
         error_report(ctx->errors, ERR_INVALID_IMM, 
-                 "%s:%lu: Invalid immediate value '%s'", 
-                 ctx->ir_filename, token->line_number, str);
-        FREE(str);
+                 "%s:%lu: Invalid immediate value '%.*s'", 
+                 ctx->ir_filename, (unsigned long)token->line_number, (int)token->length, token->str);
         return 0;
     }
     
@@ -499,72 +537,122 @@ int validate_immediate(Token *token, AssemblerContext *ctx)
     if (value < INT21_MIN || value > INT21_MAX) 
     {
         error_report(ctx->errors, ERR_IMM_OUT_OF_BOUNDS, 
-                 "%s:%lu: Immediate value %ld is out of range (-2^20 to 2^20-1)", 
-                 ctx->ir_filename, token->line_number, value);
-        FREE(str);
+                 "%s:%lu: Immediate value %.*s is out of range (-2^20 to 2^20-1)", 
+                 ctx->ir_filename, (unsigned long)token->line_number, (int)token->length, token->str);
         return 0;
     }
     
-    FREE(str);
     return 1;
 }
 
 /* Validates a numeric value in a data directive */
 int validate_data_value(Token *token, AssemblerContext *ctx) 
 {
-    char *str;
     long value = 0;
     
     if (!token || !ctx || token->type != TOKEN_IMM)
         return 0;
     
-    str = token->sv.str;
-    str[token->sv.length] = '\0';
-
-    value = atoi(str);
-
-    if (value == 0 && strcmp(str, "0") != 0) 
+    if (!sv_to_long(token_sv(token), &value)) 
     {
         error_report(ctx->errors, ERR_INVALID_DATA, 
-                 "%s:%lu: Invalid data value '%s'", 
-                 ctx->ir_filename, token->line_number, str);
+                 "%s:%lu: Invalid data value '%.*s'", 
+                 ctx->ir_filename, (unsigned long)token->line_number, (int)token->length, token->str);
         return 0;
     }
 
-    if (value < INT21_MIN|| value > INT21_MAX - 1) 
+    if (value < INT21_MIN || value > INT21_MAX) 
     {
         error_report(ctx->errors, ERR_IMM_OUT_OF_BOUNDS, 
-                 "%s:%lu: Data value %ld is out of range (-2^20 to 2^20-1)", 
-                 ctx->ir_filename, token->line_number, value);
+                 "%s:%lu: Data value %.*s is out of range (-2^20 to 2^20-1)", 
+                 ctx->ir_filename, (unsigned long)token->line_number, (int)token->length, token->str);
         return 0;
     }
     
     return 1;
 }
 
+int parse_data_value(char **cursor, long *value)
+{
+    char *p = NULL;
+    long result = 0;
+    int is_negative = 0;
+
+    if (!cursor || !*cursor || !value)
+        return DATA_VALUE_INVALID;
+
+    p = *cursor;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    /* The number - an optional sign and its digits, converted in the same scan (see sv_to_long()) */
+    is_negative = *p == '-';
+    if (*p == '+' || *p == '-')
+        p++;
+
+    if (!isdigit((unsigned char)*p))
+        return DATA_VALUE_INVALID;
+
+    for (; isdigit((unsigned char)*p); p++)
+        if (result < SV_NUMBER_SATURATION)
+            result = result * 10 + (*p - '0');
+
+    *value = is_negative ? -result : result;
+
+    /* Anything validate_data_value() would reject is left to the token path */
+    if (*value < INT21_MIN || *value > INT21_MAX)
+        return DATA_VALUE_INVALID;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    *cursor = p + (*p == ',');
+
+    if (*p == ',')
+        return DATA_VALUE_MORE;
+
+    return *p == '\0' ? DATA_VALUE_LAST : DATA_VALUE_INVALID;
+}
+
+size_t count_data_values(char *list)
+{
+    size_t count = 0;
+    long value = 0;
+    int status = 0;
+
+    do
+    {
+        status = parse_data_value(&list, &value);
+        count++;
+    } while (status == DATA_VALUE_MORE);
+
+    return status == DATA_VALUE_LAST ? count : 0;
+}
+
 int validate_instruction(ParsedInstruction *instruction, AssemblerContext *ctx)
 {
     InstructionInfo *info = NULL;
-    char *instruction_name = NULL;
+    const FirstWord *entry = NULL;
     int is_valid = 1;
     
-    if (!instruction || !ctx || !instruction->instruction)
+    if (!instruction || !ctx || !instruction->instruction || instruction->index == INS_NONE)
         return 0;
     
-    /* Get instruction info from table */
-    instruction_name = instruction->instruction->sv.str;
-    instruction_name[instruction->instruction->sv.length] = '\0';
-    info = find_instruction(instruction_name);
+    /* Get instruction info and the legality of both modes from the tables */
+    info = &instruction_set[instruction->index];
+    entry = first_word(instruction->index, instruction->rs ? instruction->rs_add_mode : ADD_MOD_NONE,
+                       instruction->rt ? instruction->rt_add_mode : ADD_MOD_NONE);
     
-    if (!info)
+    if (!entry)
         return 0;
     
     /* Check operand count */
     if (instruction->operand_count != info->num_operands) 
     {
-        error_report(ctx->errors, ERR_SYNTAX_NUM_OPERANDS, "%s:%lu: Invalid number of operands for instruction '%s'. Expected %d, got %d",
-            ctx->ir_filename, instruction->instruction->line_number,
-            instruction_name, info->num_operands, instruction->operand_count);
+        error_report(ctx->errors, ERR_SYNTAX_NUM_OPERANDS, "%s:%lu: Invalid number of operands for instruction '%.*s'. Expected %d, got %d",
+            ctx->ir_filename, (unsigned long)instruction->instruction->line_number,
+            (int)instruction->instruction->length, instruction->instruction->str, info->num_operands, instruction->operand_count);
         is_valid = 0;
     }
     
@@ -572,14 +660,12 @@ int validate_instruction(ParsedInstruction *instruction, AssemblerContext *ctx)
     if (instruction->rs) 
     {
         /* Check if the instruction supports the addressing mode */
-        unsigned int rs_mode_mask = 1 << instruction->rs_add_mode;
-        
-        if (!(rs_mode_mask & info->allowd_src_add_mode)) 
+        if (!(entry->legal & FIRST_WORD_SRC_LEGAL)) 
         {
-            error_report(ctx->errors, ERR_SYNTAX_ADD_MOD, "%s:%lu: Invalid addressing mode '%s' for source operand in '%s'",
-                   ctx->ir_filename, instruction->instruction->line_number,
+            error_report(ctx->errors, ERR_SYNTAX_ADD_MOD, "%s:%lu: Invalid addressing mode '%s' for source operand in '%.*s'",
+                   ctx->ir_filename, (unsigned long)instruction->instruction->line_number,
                    get_addressing_mode_str(instruction->rs_add_mode),
-                   instruction_name);
+                   (int)instruction->instruction->length, instruction->instruction->str);
             is_valid = 0;
         }
     }
@@ -588,14 +674,12 @@ int validate_instruction(ParsedInstruction *instruction, AssemblerContext *ctx)
     if (instruction->rt) 
     {
         /* Check if the instruction supports the addressing mode */
-        unsigned int rt_mode_mask = 1 << instruction->rt_add_mode;
-        
-        if (!(rt_mode_mask & info->allowd_dst_add_mode)) 
+        if (!(entry->legal & FIRST_WORD_DST_LEGAL)) 
         {
-           error_report(ctx->errors, ERR_SYNTAX_ADD_MOD, "%s:%lu: Invalid addressing mode '%s' for destination operand in '%s'",
-                   ctx->ir_filename, instruction->instruction->line_number,
+           error_report(ctx->errors, ERR_SYNTAX_ADD_MOD, "%s:%lu: Invalid addressing mode '%s' for destination operand in '%.*s'",
+                   ctx->ir_filename, (unsigned long)instruction->instruction->line_number,
                    get_addressing_mode_str(instruction->rt_add_mode),
-                   instruction_name);
+                   (int)instruction->instruction->length, instruction->instruction->str);
             is_valid = 0;
         }
     }
@@ -17,6 +17,7 @@
 typedef struct {
     Token *label;                               /* Label of the instruction - optional */
     Token *instruction;                         /* Instruction token */
+    int index;                                  /* Index of the instruction in instruction_set[], INS_NONE if unknown */
     Token *rs;                                  /* Source operand token */  
     AddressingMode rs_add_mode;                 /* Source operand addressing mode */
     Token *rt;                                  /* Destination operand token */
@@ -34,7 +35,43 @@ typedef struct {
     int code_word_count;                        /* Number of code words generated when encoding */
 } ParsedDirective;
 
+/* Results of parse_data_value() */
+#define DATA_VALUE_INVALID 0
+#define DATA_VALUE_MORE 1
+#define DATA_VALUE_LAST 2
+
+/* Statement types */
+typedef enum {
+    STATEMENT_INSTRUCTION,
+    STATEMENT_DIRECTIVE
+} StatementType;
+
+/* Parsed statement structure */
+/* A single statement of the intermediate representation the first pass hands to the second pass. */
+/* The tokens list of the parsed statement is not retained, the second pass takes it from the token line index. */
+typedef struct Statement {
+    StatementType type;                         /* Type of the statement */
+    size_t line_number;                         /* Line number of the statement */
+    int IC;                                     /* Instruction counter at the start of the statement */
+    int DC;                                     /* Data counter at the start of the statement */
+    union {
+        ParsedInstruction instruction;          /* Parsed instruction (STATEMENT_INSTRUCTION) */
+        ParsedDirective directive;              /* Parsed directive (STATEMENT_DIRECTIVE) */
+    } as;
+} Statement;
+
 /* Function prototypes */
+/* Statement functions */
+/**
+ * @brief Appends a new statement to the statements of the assembler context.
+ * @param ctx Pointer to the assembler context.
+ * @param type The type of the statement.
+ * @param line_number The line number of the statement.
+ * @return Pointer to the new statement with IC and DC taken from the context, or NULL on failure.
+ * @note The returned pointer is only valid until the next call, since the statements array may be reallocated.
+ */
+Statement *statement_append(AssemblerContext *ctx, StatementType type, size_t line_number);
+
 /* Instruction functions */
 /**
  * @brief Initializes a parsed instruction structure.
@@ -159,6 +196,22 @@ int validate_immediate(Token *token, AssemblerContext *ctx);
  */
 int validate_data_value(Token *token, AssemblerContext *ctx);
 
+/**
+ * @brief Parses the next value of a .data list straight from the source line, without any allocation.
+ * @param cursor Pointer to the position in the line, advanced past the value and its comma.
+ * @param value Set to the parsed value.
+ * @return DATA_VALUE_MORE if a comma follows, DATA_VALUE_LAST at the end of the line,
+ *         DATA_VALUE_INVALID if the value is malformed or rejected by validate_data_value().
+ */
+int parse_data_value(char **cursor, long *value);
+
+/**
+ * @brief Counts the values of a well formed .data list.
+ * @param list The line after the .data directive.
+ * @return The number of values, 0 if the list is empty or has any error - the tokens then have to be checked.
+ */
+size_t count_data_values(char *list);
+
 /**
  * @brief Validates an instruction token.
  * @param instruction Pointer to the parsed instruction to validate.
@@ -0,0 +1,249 @@
+/**
+ * @file stats.c
+ * @brief Implementation of the assembly statistics.
+ * @details This file contains the phase timers, the per thread allocation statistics used by util.c
+ *          and the human readable and JSON printers.
+ *          Wall time is read from the monotonic clock and CPU time from the CPU clock of the calling thread,
+ *          so the times of a file stay correct when the files are assembled in parallel.
+ */
+
+/* clock_gettime() is POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "./stats.h"
+
+#ifndef ASM_NO_THREADS
+#include <pthread.h>
+#endif
+
+/* Names of the phases, indexed by Phase */
+static const char *phase_names[PHASE_COUNT] = {
+    "preprocess", "first_pass", "second_pass", "single_pass", "preprocess+first_pass", "output"
+};
+
+/* Width of the phase column of the text statistics - the longest phase name */
+#define PHASE_NAME_WIDTH 21
+
+/* Set once by stats_enable_alloc_tracking() before any thread is started */
+static int alloc_tracking = 0;
+
+#ifndef ASM_NO_THREADS
+static pthread_key_t allocs_key;
+static pthread_once_t allocs_key_once = PTHREAD_ONCE_INIT;
+
+static void allocs_key_create(void)
+{
+    pthread_key_create(&allocs_key, NULL);
+}
+#else
+static AllocStats *thread_allocs = NULL;
+#endif
+
+
+double stats_wall_time(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+    return (double)time(NULL);
+}
+
+/* Returns the CPU time of the calling thread in seconds */
+static double stats_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* Adds the time since the innermost running phase was (re)started to its totals */
+static void stats_phase_pause(Stats *stats, double wall, double cpu)
+{
+    int top = stats->depth - 1;
+
+    stats->wall[stats->stack[top]] += wall - stats->wall_start[top];
+    stats->cpu[stats->stack[top]] += cpu - stats->cpu_start[top];
+}
+
+void stats_phase_begin(Stats *stats, Phase phase)
+{
+    double wall, cpu;
+
+    if (!stats || !stats->enabled || stats->depth == STATS_MAX_DEPTH)
+        return;
+
+    wall = stats_wall_time();
+    cpu = stats_cpu_time();
+
+    if (stats->depth > 0)
+        stats_phase_pause(stats, wall, cpu);
+
+    stats->stack[stats->depth] = phase;
+    stats->wall_start[stats->depth] = wall;
+    stats->cpu_start[stats->depth] = cpu;
+    stats->depth++;
+}
+
+void stats_phase_end(Stats *stats)
+{
+    double wall, cpu;
+
+    if (!stats || !stats->enabled || stats->depth == 0)
+        return;
+
+    wall = stats_wall_time();
+    cpu = stats_cpu_time();
+
+    stats_phase_pause(stats, wall, cpu);
+    stats->depth--;
+
+    /* Resume the interrupted phase */
+    if (stats->depth > 0)
+    {
+        stats->wall_start[stats->depth - 1] = wall;
+        stats->cpu_start[stats->depth - 1] = cpu;
+    }
+}
+
+void stats_add(Stats *total, const Stats *file)
+{
+    int i;
+
+    if (!total || !file)
+        return;
+
+    for (i = 0; i < PHASE_COUNT; i++)
+    {
+        total->wall[i] += file->wall[i];
+        total->cpu[i] += file->cpu[i];
+    }
+
+    total->files += file->files ? file->files : 1;
+    total->lines += file->lines;
+    total->tokens += file->tokens;
+    total->symbols += file->symbols;
+    total->words += file->words;
+    total->errors += file->errors;
+    total->allocs.allocs += file->allocs.allocs;
+    total->allocs.reallocs += file->allocs.reallocs;
+    total->allocs.frees += file->allocs.frees;
+    /* The peaks of the files are not reached at the same time, the peak of the run is the highest of them */
+    if (file->allocs.peak_bytes > total->allocs.peak_bytes)
+        total->allocs.peak_bytes = file->allocs.peak_bytes;
+}
+
+void stats_print(FILE *stream, const char *name, const Stats *stats, double elapsed)
+{
+    double wall = 0, cpu = 0;
+    int i;
+
+    if (!stream || !stats)
+        return;
+
+    if (name)
+        fprintf(stream, "Statistics for %s\n", name);
+    else
+        fprintf(stream, "Statistics for %lu file(s), elapsed %.3f ms\n", stats->files, elapsed * 1e3);
+
+    fprintf(stream, "  %-*s %12s %12s\n", PHASE_NAME_WIDTH, "phase", "wall (ms)", "cpu (ms)");
+    for (i = 0; i < PHASE_COUNT; i++)
+    {
+        fprintf(stream, "  %-*s %12.3f %12.3f\n", PHASE_NAME_WIDTH, phase_names[i], stats->wall[i] * 1e3, stats->cpu[i] * 1e3);
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+    fprintf(stream, "  %-*s %12.3f %12.3f\n", PHASE_NAME_WIDTH, "total", wall * 1e3, cpu * 1e3);
+
+    fprintf(stream, "  lines %lu, tokens %lu, symbols %lu, words %lu, errors %lu\n",
+            stats->lines, stats->tokens, stats->symbols, stats->words, stats->errors);
+
+    if (alloc_tracking)
+        fprintf(stream, "  allocations %lu, reallocations %lu, frees %lu, peak bytes %ld\n",
+                stats->allocs.allocs, stats->allocs.reallocs, stats->allocs.frees, stats->allocs.peak_bytes);
+}
+
+/* Prints a string as a JSON string literal */
+static void stats_print_json_string(FILE *stream, const char *str)
+{
+    fputc('"', stream);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fprintf(stream, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(stream, "\\u%04x", (unsigned char)*str);
+        else
+            fputc(*str, stream);
+    }
+    fputc('"', stream);
+}
+
+void stats_print_json(FILE *stream, const char *name, const Stats *stats, double elapsed)
+{
+    int i;
+
+    if (!stream || !stats)
+        return;
+
+    fputc('{', stream);
+    if (name)
+    {
+        fprintf(stream, "\"file\":");
+        stats_print_json_string(stream, name);
+    }
+    else
+        fprintf(stream, "\"files\":%lu,\"elapsed\":%.6f", stats->files, elapsed);
+
+    fprintf(stream, ",\"phases\":{");
+    for (i = 0; i < PHASE_COUNT; i++)
+        fprintf(stream, "%s\"%s\":{\"wall\":%.6f,\"cpu\":%.6f}", i ? "," : "",
+                phase_names[i], stats->wall[i], stats->cpu[i]);
+
+    fprintf(stream, "},\"lines\":%lu,\"tokens\":%lu,\"symbols\":%lu,\"words\":%lu,\"errors\":%lu",
+            stats->lines, stats->tokens, stats->symbols, stats->words, stats->errors);
+
+    if (alloc_tracking)
+        fprintf(stream, ",\"allocs\":{\"allocs\":%lu,\"reallocs\":%lu,\"frees\":%lu,\"peak_bytes\":%ld}",
+                stats->allocs.allocs, stats->allocs.reallocs, stats->allocs.frees, stats->allocs.peak_bytes);
+
+    fputc('}', stream);
+}
+
+void stats_enable_alloc_tracking(void)
+{
+    alloc_tracking = 1;
+}
+
+int stats_alloc_tracking(void)
+{
+    return alloc_tracking;
+}
+
+void stats_set_thread_allocs(AllocStats *allocs)
+{
+#ifndef ASM_NO_THREADS
+    pthread_once(&allocs_key_once, allocs_key_create);
+    pthread_setspecific(allocs_key, allocs);
+#else
+    thread_allocs = allocs;
+#endif
+}
+
+AllocStats *stats_thread_allocs(void)
+{
+#ifndef ASM_NO_THREADS
+    pthread_once(&allocs_key_once, allocs_key_create);
+    return (AllocStats *)pthread_getspecific(allocs_key);
+#else
+    return thread_allocs;
+#endif
+}
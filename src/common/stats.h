@@ -0,0 +1,134 @@
+/**
+ * @file stats.h
+ * @brief Header file for the assembly statistics (--stats / --stats-json).
+ * @details This file contains the definition of the per file statistics - wall and CPU time of each phase,
+ *          the sizes of the assembled file and the allocations made through MALLOC/REALLOC/FREE -
+ *          and the functions collecting and printing them.
+ *          Allocation tracking is switched on once, before the first allocation of the run, and the
+ *          allocations of each thread are counted into the AllocStats set with stats_set_thread_allocs().
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Output format of the statistics */
+#define STATS_NONE 0
+#define STATS_TEXT 1
+#define STATS_JSON 2
+
+/* Maximum nesting of phases - the output phase runs inside the other phases */
+#define STATS_MAX_DEPTH 4
+
+/* Assembly phases timed by the statistics */
+typedef enum {
+    PHASE_PREPROCESS,
+    PHASE_FIRST_PASS,
+    PHASE_SECOND_PASS,
+    PHASE_SINGLE_PASS,
+    PHASE_STREAM,                                       /* The preprocessor and the first pass of --stream, interleaved per line */
+    PHASE_OUTPUT,
+    PHASE_COUNT
+} Phase;
+
+/* Allocation statistics structure */
+/* Counts of the MALLOC/REALLOC/FREE calls and the live and peak heap bytes */
+
+typedef struct {
+    unsigned long allocs;                               /* Number of new allocations */
+    unsigned long reallocs;                             /* Number of reallocations of an existing block */
+    unsigned long frees;                                /* Number of freed blocks */
+    long bytes;                                         /* Currently allocated bytes */
+    long peak_bytes;                                    /* Highest value of bytes */
+} AllocStats;
+
+/* Statistics structure */
+/* Statistics of a single file, or the sum of all the files of the run */
+
+typedef struct {
+    int enabled;                                        /* Nothing is measured unless set */
+    double wall[PHASE_COUNT];                           /* Wall time of each phase in seconds, nested phases excluded */
+    double cpu[PHASE_COUNT];                            /* CPU time of each phase in seconds, nested phases excluded */
+    int stack[STATS_MAX_DEPTH];                         /* The running phases, innermost last */
+    double wall_start[STATS_MAX_DEPTH];                 /* Wall time when each running phase was (re)started */
+    double cpu_start[STATS_MAX_DEPTH];                  /* CPU time when each running phase was (re)started */
+    int depth;                                          /* Number of running phases */
+    unsigned long files;                                /* Number of files summed up */
+    unsigned long lines;                                /* Number of preprocessed lines */
+    unsigned long tokens;                               /* Number of tokens */
+    unsigned long symbols;                              /* Number of symbols in the symbol table */
+    unsigned long words;                                /* Number of encoded code and data words */
+    unsigned long errors;                               /* Number of reported errors */
+    AllocStats allocs;                                  /* Allocations made while assembling the file */
+} Stats;
+
+
+/**
+ * @brief Starts timing a phase, pausing the phase that is currently running.
+ * @param stats Pointer to the statistics of the file (ignored unless stats->enabled).
+ * @param phase The phase that starts.
+ */
+void stats_phase_begin(Stats *stats, Phase phase);
+
+/**
+ * @brief Stops timing the innermost running phase and resumes the phase it interrupted.
+ * @param stats Pointer to the statistics of the file (ignored unless stats->enabled).
+ */
+void stats_phase_end(Stats *stats);
+
+/**
+ * @brief Adds the statistics of a file to the statistics of the run.
+ * @param total Pointer to the statistics of the run.
+ * @param file Pointer to the statistics of the file.
+ * @note Peak bytes are not summed - the peak of the run is the highest peak of its files.
+ */
+void stats_add(Stats *total, const Stats *file);
+
+/**
+ * @brief Prints statistics in a human readable table.
+ * @param stream The stream to print to.
+ * @param name Name of the file, or NULL for the statistics of the run.
+ * @param stats Pointer to the statistics to print.
+ * @param elapsed Wall time of the whole run in seconds, printed only for the run.
+ */
+void stats_print(FILE *stream, const char *name, const Stats *stats, double elapsed);
+
+/**
+ * @brief Prints statistics as a JSON object.
+ * @param stream The stream to print to.
+ * @param name Name of the file, or NULL for the statistics of the run.
+ * @param stats Pointer to the statistics to print.
+ * @param elapsed Wall time of the whole run in seconds, printed only for the run.
+ */
+void stats_print_json(FILE *stream, const char *name, const Stats *stats, double elapsed);
+
+/**
+ * @brief Returns a monotonic wall clock time in seconds.
+ */
+double stats_wall_time(void);
+
+/**
+ * @brief Turns on the tracking of the allocations.
+ * @note Must be called before the first MALLOC of the run, tracked blocks carry a small size header.
+ */
+void stats_enable_alloc_tracking(void);
+
+/**
+ * @brief Returns non zero when the allocations are tracked.
+ */
+int stats_alloc_tracking(void);
+
+/**
+ * @brief Sets the allocation statistics the allocations of the calling thread are counted into.
+ * @param allocs Pointer to the allocation statistics, or NULL to stop counting.
+ */
+void stats_set_thread_allocs(AllocStats *allocs);
+
+/**
+ * @brief Returns the allocation statistics of the calling thread, NULL if none is set.
+ */
+AllocStats *stats_thread_allocs(void);
+
+#endif /* STATS_H */
@@ -7,6 +7,7 @@
  */
 
 #include "./string_view.h"  
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -127,3 +128,38 @@ int sv_ends_with(StringView sv, char *str)
 
     return sv_eq_str(suffix, str);
 }
+
+int sv_to_long(StringView sv, long *value)
+{
+    size_t i = 0;
+    long result = 0;
+    int is_negative = 0;
+
+    if (!sv.str || sv.length == 0)
+        return 0;
+
+    /* Optional sign */
+    if (sv.str[0] == '+' || sv.str[0] == '-')
+    {
+        is_negative = sv.str[0] == '-';
+        i++;
+    }
+
+    /* At least one digit */
+    if (i == sv.length)
+        return 0;
+
+    for (; i < sv.length; i++)
+    {
+        if (!isdigit((unsigned char)sv.str[i]))
+            return 0;
+
+        if (result < SV_NUMBER_SATURATION)
+            result = result * 10 + (sv.str[i] - '0');
+    }
+
+    if (value)
+        *value = is_negative ? -result : result;
+
+    return 1;
+}
@@ -11,6 +11,8 @@
 
 #include <stdio.h>
 
+#define SV_NUMBER_SATURATION 100000000L                 /* Far beyond any value of the machine word */
+
 /* StringView structure */
 
 typedef struct {
@@ -58,6 +60,15 @@ StringView sv_trim_right(StringView sv);
  */
 StringView sv_trim(StringView sv);
 
+/**
+ * @brief Compares two StringViews.
+ * @param a The first StringView.
+ * @param b The second StringView.
+ * @return 1 if they are equal, 0 otherwise.
+ * @note The comparison is case-sensitive.
+ */
+int sv_eq(StringView a, StringView b);
+
 /**
  * @brief Compares a StringView with a string.
  * @param sv The StringView to compare.
@@ -83,4 +94,13 @@ int sv_starts_with(StringView sv, char *str);
  */
 int sv_ends_with(StringView sv, char *str);
 
+/**
+ * @brief Converts a StringView holding a decimal number to a long, without copying it.
+ * @param sv The StringView to convert - an optional sign followed by decimal digits, nothing else.
+ * @param value Set to the number on success (may be NULL).
+ * @return 1 if the whole StringView is a number, 0 otherwise.
+ * @note Magnitudes past SV_NUMBER_SATURATION stop growing, so out of range values stay out of range without overflowing.
+ */
+int sv_to_long(StringView sv, long *value);
+
 #endif /* STRING_VIEW_H */
\ No newline at end of file
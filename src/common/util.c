@@ -8,16 +8,55 @@
  */
 
 #include "./util.h"
+#include "./stats.h"
 #include "../main/assembler.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Header in front of the tracked blocks (--stats) - keeps the size of the block and the alignment of the data */
+typedef union {
+    size_t size;
+    ArenaAlign align;
+} AllocHeader;
+
+#define ALLOC_HEADER_SIZE sizeof(AllocHeader)
+
+/* Counts a change of the allocated bytes into the allocation statistics of the thread */
+static void alloc_count(long delta)
+{
+    AllocStats *allocs = stats_thread_allocs();
+
+    if (!allocs)
+        return;
+
+    allocs->bytes += delta;
+    if (allocs->bytes > allocs->peak_bytes)
+        allocs->peak_bytes = allocs->bytes;
+}
+
 void *xmalloc(size_t size, const char *file, int line) 
 {
     void *ptr = NULL;
 
-    ptr = malloc(size);
+    /* Tracked allocation - the size is kept in a header in front of the block */
+    if (stats_alloc_tracking())
+    {
+        AllocHeader *header = (AllocHeader *)malloc(ALLOC_HEADER_SIZE + size);
+        AllocStats *allocs = stats_thread_allocs();
+
+        if (header)
+        {
+            header->size = size;
+            ptr = header + 1;
+
+            if (allocs)
+                allocs->allocs++;
+            alloc_count((long)size);
+        }
+    }
+    else
+        ptr = malloc(size);
 
     if (!ptr) 
     {
@@ -32,7 +71,30 @@ void *xrealloc(void *ptr, size_t size, const char *file, int line)
 {
     void *new_ptr = NULL;
 
-    new_ptr = realloc(ptr, size);
+    if (stats_alloc_tracking())
+    {
+        AllocHeader *header = NULL;
+        AllocStats *allocs = stats_thread_allocs();
+        size_t old_size = 0;
+
+        if (!ptr)
+            return xmalloc(size, file, line);
+
+        old_size = ((AllocHeader *)ptr - 1)->size;
+        header = (AllocHeader *)realloc((AllocHeader *)ptr - 1, ALLOC_HEADER_SIZE + size);
+
+        if (header)
+        {
+            header->size = size;
+            new_ptr = header + 1;
+
+            if (allocs)
+                allocs->reallocs++;
+            alloc_count((long)size - (long)old_size);
+        }
+    }
+    else
+        new_ptr = realloc(ptr, size);
 
     if (!new_ptr) 
     {
@@ -48,7 +110,19 @@ void xfree(void **ptr, const char *file, int line)
 {
     if (ptr && *ptr) 
     {
-        free(*ptr);
+        if (stats_alloc_tracking())
+        {
+            AllocHeader *header = (AllocHeader *)*ptr - 1;
+            AllocStats *allocs = stats_thread_allocs();
+
+            if (allocs)
+                allocs->frees++;
+            alloc_count(-(long)header->size);
+            free(header);
+        }
+        else
+            free(*ptr);
+
         *ptr = NULL;
     }
 }
@@ -89,43 +163,93 @@ char *xstrdup(const char *str, const char *file, int line)
     return dup;
 }
 
-char *xstrdup_norm(const char *str, const char *file, int line)
+/* Copies str into dst, replacing sequences of whitespace with a single space if normalize is set */
+static void copy_str(char *dst, const char *str, size_t len, int normalize)
 {
-    char *norm_str = NULL;
-    size_t len = 0, i = 0, j = 0;
-
-    if (!str)
-        return NULL;
-
-    while (str[len])
-        len++;
-
-    norm_str = (char *)xmalloc(len + 1, file, line); 
-
-    if (!norm_str) 
-    {
-        fprintf(stderr, "Memory allocation failed at %s:%d\n", file, line);
-        return NULL;
-    }
+    size_t i = 0, j = 0;
 
     while (i < len) 
     {
         /* Normalize spaces */
-        if (str[i] == ' ' || str[i] == '\t') 
+        if (normalize && (str[i] == ' ' || str[i] == '\t')) 
         {
-            if (j > 0 && norm_str[j - 1] != ' ')
-                norm_str[j++] = ' ';
+            if (j > 0 && dst[j - 1] != ' ')
+                dst[j++] = ' ';
         } 
 
         /* Copy other characters */
         else 
-            norm_str[j++] = str[i];
+            dst[j++] = str[i];
         
         i++;
     }
 
     /* Null-terminate the string */
-    norm_str[j] = '\0';
+    dst[j] = '\0';
+}
+
+size_t str_normalize(char *str)
+{
+    size_t i = 0, j = 0;
 
-    return norm_str;
-}
\ No newline at end of file
+    if (!str)
+        return 0;
+
+    /* Skip the prefix that stays as it is - up to a leading space, a tab or a space after a space */
+    while (str[i] && str[i] != '\t' && !(str[i] == ' ' && (i == 0 || str[i - 1] == ' ')))
+        i++;
+
+    /* Collapse the rest in place, the normalized string is never longer than what was read */
+    for (j = i; str[i]; i++)
+    {
+        if (str[i] == ' ' || str[i] == '\t')
+        {
+            if (j > 0 && str[j - 1] != ' ')
+                str[j++] = ' ';
+        }
+        else
+            str[j++] = str[i];
+    }
+
+    str[j] = '\0';
+    return j;
+}
+
+void *xarena_alloc(Arena *arena, size_t size, const char *file, int line)
+{
+    void *ptr = NULL;
+
+    if (!arena)
+        return xmalloc(size, file, line);
+
+    ptr = arena_alloc(arena, size);
+
+    if (!ptr) 
+    {
+        fprintf(stderr, "Memory allocation failed at %s:%d\n", file, line);
+        return NULL;
+    }
+
+    return ptr;
+}
+
+char *xarena_strdup(Arena *arena, const char *str, int normalize, const char *file, int line)
+{
+    char *dup = NULL;
+    size_t len = 0;
+
+    if (!str)
+        return NULL;
+
+    while (str[len])
+        len++;
+
+    dup = (char *)xarena_alloc(arena, len + 1, file, line);
+
+    if (!dup)
+        return NULL;
+
+    copy_str(dup, str, len, normalize);
+
+    return dup;
+}
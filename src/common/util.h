@@ -2,7 +2,7 @@
  * @file util.h
  * @brief Header file for utility functions - mainly memory management.
  * @details This file contains function prototypes for memory management,
- *          string duplication, and normalization. It also includes macros for easy
+ *          string duplication, and in place normalization. It also includes macros for easy
  *          memory management with error checking and reporting.
  */
 
@@ -10,13 +10,18 @@
 #define UTIL_H
 
 #include <stddef.h>
+
+#include "../data_structures/arena.h"
  
 /* Macros for easy memory management */
 #define MALLOC(size) xmalloc(size, __FILE__, __LINE__)  
 #define REALLOC(ptr, size) xrealloc(ptr, size, __FILE__, __LINE__)
 #define FREE(ptr) xfree((void **)&ptr, __FILE__, __LINE__)
 #define STRDUP(s) xstrdup(s, __FILE__, __LINE__)
-#define STRDUP_NORM(s) xstrdup_norm(s, __FILE__, __LINE__)
+
+/* Macros for allocations owned by an arena - with a NULL arena they fall back to MALLOC/STRDUP */
+#define ARENA_ALLOC(arena, size) xarena_alloc(arena, size, __FILE__, __LINE__)
+#define ARENA_STRDUP(arena, s) xarena_strdup(arena, s, 0, __FILE__, __LINE__)
 
 /**
  * @brief Allocates memory and checks for allocation failure.
@@ -66,13 +71,33 @@ void free_string(void *str);
 char *xstrdup(const char *s, const char *file, int line);
 
 /**
- * @brief Normalizes a string by replacing sequences of whitespace with a single space.
- * @param s The string to normalize.
+ * @brief Normalizes a string in place by replacing sequences of whitespace with a single space.
+ * @param s The string to normalize, leading whitespace is removed and a trailing sequence becomes a single space.
+ * @return The length of the normalized string.
+ * @note Nothing is written up to the first tab or repeated space, so an already normalized string is only scanned.
+ */
+size_t str_normalize(char *s);
+
+/**
+ * @brief Allocates memory from an arena and checks for allocation failure.
+ * @param arena The arena to allocate from, NULL to allocate with xmalloc().
+ * @param size Size of memory to allocate.
+ * @param file File where the function is called.
+ * @param line Line number where the function is called.
+ * @return Pointer to the allocated memory.
+ * @note Memory from an arena must not be freed with FREE(), it is released with the arena.
+ */
+void *xarena_alloc(Arena *arena, size_t size, const char *file, int line);
+
+/**
+ * @brief Duplicates a string into an arena, optionally normalizing its whitespace.
+ * @param arena The arena to allocate from, NULL to allocate with xmalloc().
+ * @param s The string to duplicate.
+ * @param normalize Flag indicating if sequences of whitespace are replaced with a single space (like str_normalize()).
  * @param file File where the function is called.
  * @param line Line number where the function is called.
- * @return A new string with normalized whitespace.
- *        The caller is responsible for freeing the returned string.
+ * @return Pointer to the duplicated string.
  */
-char *xstrdup_norm(const char *s, const char *file, int line);
+char *xarena_strdup(Arena *arena, const char *s, int normalize, const char *file, int line);
 
 #endif /* UTIL_H */
\ No newline at end of file
@@ -0,0 +1,161 @@
+/**
+ * @file arena.c
+ * @brief Implementation of the arena (bump) allocator.
+ * @details This file contains the implementation of an arena allocator made of a linked list of blocks.
+ *          Allocations are bumped from the current block, and a new block is pushed when it is full.
+ *          The memory is only released by resetting or destroying the arena.
+ */
+
+#include "./arena.h"
+#include "../common/util.h"
+
+
+/* Offset of the memory of a block from its header */
+#define BLOCK_HEADER_SIZE ARENA_ALIGN_UP(sizeof(ArenaBlock))
+#define BLOCK_DATA(block) ((char *)(block) + BLOCK_HEADER_SIZE)
+
+/* Allocates a new block with size usable bytes and pushes it as the head of the arena */
+static ArenaBlock *arena_push_block(Arena *arena, size_t size)
+{
+    ArenaBlock *block = NULL;
+
+    block = (ArenaBlock *)MALLOC(BLOCK_HEADER_SIZE + size);
+    if (!block)
+        return NULL;
+
+    block->size = size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+
+    return block;
+}
+
+Arena *arena_create(size_t block_size)
+{
+    Arena *arena = NULL;
+
+    arena = (Arena *)MALLOC(sizeof(Arena));
+    if (!arena)
+        return NULL;
+
+    arena->head = NULL;
+    arena->block_size = block_size ? ARENA_ALIGN_UP(block_size) : ARENA_BLOCK_SIZE;
+    arena->allocated = 0;
+
+    return arena;
+}
+
+void arena_destroy(Arena *arena)
+{
+    ArenaBlock *block = NULL, *next = NULL;
+
+    if (!arena)
+        return;
+
+    for (block = arena->head; block; block = next)
+    {
+        next = block->next;
+        FREE(block);
+    }
+
+    FREE(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = NULL;
+    void *ptr = NULL;
+
+    if (!arena)
+        return NULL;
+
+    size = ARENA_ALIGN_UP(size ? size : 1);
+
+    /* Large requests get a dedicated block behind the current one, so the current block keeps being used */
+    if (size > arena->block_size / 4)
+    {
+        block = arena_push_block(arena, size);
+        if (!block)
+            return NULL;
+
+        if (block->next)
+        {
+            arena->head = block->next;
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+
+        block->used = size;
+        arena->allocated += size;
+        return BLOCK_DATA(block);
+    }
+
+    /* Push a new block if the current one is full */
+    block = arena->head;
+    if (!block || block->size - block->used < size)
+    {
+        block = arena_push_block(arena, arena->block_size);
+        if (!block)
+            return NULL;
+    }
+
+    ptr = BLOCK_DATA(block) + block->used;
+    block->used += size;
+    arena->allocated += size;
+
+    return ptr;
+}
+
+void arena_reset(Arena *arena)
+{
+    ArenaBlock *block = NULL, *next = NULL;
+
+    if (!arena || !arena->head)
+        return;
+
+    /* Keep the oldest regular block, free everything else */
+    for (block = arena->head; block->next; block = next)
+    {
+        next = block->next;
+        FREE(block);
+    }
+
+    arena->head = block;
+    arena->allocated = 0;
+
+    /* The oldest block may be a dedicated one */
+    if (block->size != arena->block_size)
+    {
+        FREE(arena->head);
+        return;
+    }
+
+    block->used = 0;
+}
+
+void arena_merge(Arena *dst, Arena *src)
+{
+    ArenaBlock *tail = NULL;
+
+    if (!dst || !src)
+        return;
+
+    /* Splice the blocks of src right behind the current block of dst */
+    if (src->head)
+    {
+        for (tail = src->head; tail->next; tail = tail->next)
+            ;
+
+        if (dst->head)
+        {
+            tail->next = dst->head->next;
+            dst->head->next = src->head;
+        }
+        else
+            dst->head = src->head;
+    }
+
+    dst->allocated += src->allocated;
+    FREE(src);
+}
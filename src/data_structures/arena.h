@@ -0,0 +1,79 @@
+/**
+ * @file arena.h
+ * @brief Header file for the arena (bump) allocator.
+ * @details This file contains the definition of the arena structure and function prototypes for creating,
+ *          destroying, allocating from and resetting an arena.
+ *          An arena hands out memory from large blocks by bumping an offset. Allocations are never freed one by one,
+ *          all of them are released at once by resetting or destroying the arena.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h> /* size_t */
+
+#define ARENA_BLOCK_SIZE 65536
+
+/* Alignment unit for arena allocations - the strictest of the basic types */
+typedef union {
+    long l;
+    double d;
+    void *p;
+} ArenaAlign;
+
+#define ARENA_ALIGNMENT sizeof(ArenaAlign)
+#define ARENA_ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+/* Arena block structure, the memory of the block follows the (aligned) header */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;                        /* Next (older) block */
+    size_t size;                                    /* Usable size of the block */
+    size_t used;                                    /* Number of bytes handed out from the block */
+} ArenaBlock;
+
+/* Arena structure */
+typedef struct {
+    ArenaBlock *head;                               /* Current block, allocations are bumped from it */
+    size_t block_size;                              /* Size of a regular block */
+    size_t allocated;                               /* Total number of bytes handed out since the last reset */
+} Arena;
+
+/**
+ * @brief Creates a new arena.
+ * @param block_size Size of the blocks the arena allocates, 0 for ARENA_BLOCK_SIZE.
+ * @return Pointer to the newly created arena, or NULL on failure.
+ * @note The caller is responsible for freeing the arena using arena_destroy().
+ */
+Arena *arena_create(size_t block_size);
+
+/**
+ * @brief Destroys an arena, releasing all the memory allocated from it.
+ * @param arena Pointer to the arena to destroy.
+ */
+void arena_destroy(Arena *arena);
+
+/**
+ * @brief Allocates memory from an arena.
+ * @param arena Pointer to the arena.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory aligned to ARENA_ALIGNMENT, or NULL on failure.
+ * @note Requests larger than a quarter of the block size get a block of their own.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Resets an arena, releasing all the allocations at once.
+ * @param arena Pointer to the arena.
+ * @note The first block is kept for reuse, all the others are freed.
+ */
+void arena_reset(Arena *arena);
+
+/**
+ * @brief Moves all the blocks of an arena into another one and destroys the emptied arena.
+ * @param dst Pointer to the arena receiving the blocks.
+ * @param src Pointer to the arena to merge, it is freed.
+ * @note The allocations of src stay valid and are released with dst. The current block of dst is kept current.
+ */
+void arena_merge(Arena *dst, Arena *src);
+
+#endif /* ARENA_H */
@@ -2,8 +2,9 @@
  * @file hash_map.c
  * @brief Implementation of a simple hash map.
  * @details This file contains the implementation of a hash map data structure
- *          using separate chaining for collision resolution. The hash map allows
- *          for dynamic resizing and uses the djb2 hash function for hashing keys.
+ *          using open addressing with linear probing for collision resolution. The hash map allows
+ *          for dynamic resizing and uses the FNV-1a hash function for hashing keys.
+ *          Keys are interned into an arena owned by the map.
  */
 
 #include "./hash_map.h"
@@ -11,6 +12,29 @@
 
 #include <string.h>
 
+/* Finds the slot of a key - either the slot holding it or the empty slot where it belongs */
+static Entry *hash_map_find_slot(Entry *entries, size_t capacity, StringView key, size_t key_hash)
+{
+    size_t index = key_hash & (capacity - 1);
+    Entry *entry = NULL;
+
+    for (;;)
+    {
+        entry = &entries[index];
+
+        /* Empty slot - the key is not in the map */
+        if (!entry->key.str)
+            return entry;
+
+        /* Compare the stored hash first, the string only on a hash match */
+        if (entry->hash == key_hash && entry->key.length == key.length && 
+            memcmp(entry->key.str, key.str, key.length) == 0)
+            return entry;
+
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
 HashMap *hash_map_create(HashMapFreeFunction free_func) 
 {
     HashMap *map = NULL;
@@ -22,61 +46,80 @@ HashMap *hash_map_create(HashMapFreeFunction free_func)
     map->capacity = HASH_MAP_INIT_CAPACITY;
     map->size = 0;
 
-    map->entries = (Entry **)MALLOC(map->capacity * sizeof(Entry *));
+    map->entries = (Entry *)MALLOC(map->capacity * sizeof(Entry));
     if (!map->entries) 
     {
         FREE(map);
         return NULL;
     }
 
+    map->keys = arena_create(HASH_MAP_KEYS_BLOCK_SIZE);
+    if (!map->keys)
+    {
+        FREE(map->entries);
+        FREE(map);
+        return NULL;
+    }
+
     map->free_func = free_func;
 
-    memset(map->entries, 0, map->capacity * sizeof(Entry *));   
+    memset(map->entries, 0, map->capacity * sizeof(Entry));   
 
     return map;
 }
 
 void hash_map_destroy(HashMap *map) 
 {
-    
     size_t i;
-    Entry *entry = NULL, *next = NULL;
 
     if (!map) 
         return;
 
+    /* Free the values if a free function is provided */
+    if (map->free_func)
+        for (i = 0; i < map->capacity; i++) 
+            if (map->entries[i].key.str)
+                map->free_func(map->entries[i].value);
 
-    for (i = 0; i < map->capacity; i++) 
-    {
-        /* Free the linked list at each index */
-        entry = map->entries[i];
-        while (entry) 
-        {
-            /* Free the entry and its key */
-            next = entry;
-            entry = entry->next;
-
-            /* Free the value if a free function is provided */
-            if (map->free_func)
-                map->free_func(next->value);
-
-            FREE(next->key);
-            FREE(next);
-        }
-    }
-
-    /* Free the entries array and the map itself */
+    /* Free the entries array, the keys and the map itself */
+    arena_destroy(map->keys);
     FREE(map->entries);
     FREE(map);
 }
 
+void hash_map_clear(HashMap *map)
+{
+    size_t i;
+
+    if (!map || map->size == 0)
+        return;
+
+    /* Free the values if a free function is provided */
+    if (map->free_func)
+        for (i = 0; i < map->capacity; i++) 
+            if (map->entries[i].key.str)
+                map->free_func(map->entries[i].value);
+
+    memset(map->entries, 0, map->capacity * sizeof(Entry));
+    arena_reset(map->keys);
+    map->size = 0;
+}
 
 void hash_map_put(HashMap *map, const char *key, void *value) 
 {    
-    size_t index = 0;
+    if (!key)
+        return;
+
+    hash_map_put_sv(map, sv_from_str((char *)key), value);
+}
+
+void hash_map_put_sv(HashMap *map, StringView key, void *value) 
+{    
+    size_t key_hash = 0;
     Entry *entry = NULL;
+    char *interned = NULL;
 
-    if (!map || !key) 
+    if (!map || (!key.str && key.length)) 
         return;
 
     /* Check if needs resizing */
@@ -84,59 +127,53 @@ void hash_map_put(HashMap *map, const char *key, void *value)
         if (!hash_map_resize(map)) 
             return;
 
-    /* Check if the key already exists */
-    index = hash(key) % map->capacity;
-    entry = map->entries[index];
-    while (entry) 
+    key_hash = hash(key);
+    entry = hash_map_find_slot(map->entries, map->capacity, key, key_hash);
+
+    /* Key already exists - update the value */
+    if (entry->key.str)
     {
-        if (strcmp(entry->key, key) == 0) 
-        {
-            /* Key already exists - update the value */
-            if (map->free_func) 
-                map->free_func(entry->value);
+        if (map->free_func) 
+            map->free_func(entry->value);
 
-            entry->value = value;
+        entry->value = value;
+        return;
+    }
 
-            return;
-        }
+    /* Key does not exist - intern it and fill the empty slot */
+    interned = (char *)ARENA_ALLOC(map->keys, key.length + 1);
+    if (!interned)
+        return;
 
-        entry = entry->next;
-    }
+    memcpy(interned, key.str ? key.str : "", key.length);
+    interned[key.length] = '\0';
 
-    /* Key does not exist - create a new entry */
-    entry = (Entry *)MALLOC(sizeof(Entry));
-    entry->key = STRDUP(key);
+    entry->key.str = interned;
+    entry->key.length = key.length;
+    entry->hash = key_hash;
     entry->value = value;
-    
-    /* Add at the head of the linked list at the hash index */
-    entry->next = map->entries[index];
-    map->entries[index] = entry;
     map->size++;
 }
 
 void *hash_map_get(HashMap *map, const char *key)
 {
-    size_t index = 0;
-    Entry *entry = NULL;
-
-    if (!map || !key)
+    if (!key)
         return NULL;
 
-    /* Get the index using the hash function */
-    index = hash((char *)key) % map->capacity;
-    entry = map->entries[index];
+    return hash_map_get_sv(map, sv_from_str((char *)key));
+}
 
-    /* Traverse the linked list at the index */
-    while (entry)
-    {
-        if (strcmp(entry->key, key) == 0)
-            return entry->value;
-        entry = entry->next;
-    }
+void *hash_map_get_sv(HashMap *map, StringView key)
+{
+    Entry *entry = NULL;
+
+    if (!map || (!key.str && key.length))
+        return NULL;
 
-    /* Key not found */
+    entry = hash_map_find_slot(map->entries, map->capacity, key, hash(key));
 
-    return NULL;
+    /* Key not found if the slot is empty */
+    return entry->key.str ? entry->value : NULL;
 }
 
 size_t hash_map_size(HashMap *map) 
@@ -149,13 +186,16 @@ int hash_map_contains(HashMap *map, const char *key)
     return hash_map_get(map, key) != NULL;
 }
 
-size_t hash(const char *key) 
+size_t hash(StringView key) 
 {
-    size_t hash = HASH_CONSTANT;
-    int c;
+    size_t hash = HASH_FNV_OFFSET;
+    size_t i;
 
-    while ((c = *key++)) 
-        hash = ((hash << HASH_SHIFT) + hash) + c; 
+    for (i = 0; i < key.length; i++)
+    {
+        hash ^= (unsigned char)key.str[i];
+        hash *= HASH_FNV_PRIME;
+    }
 
     return hash;
 }
@@ -163,35 +203,27 @@ size_t hash(const char *key)
 int hash_map_resize(HashMap *map) 
 {
     size_t new_capacity = 0, i;
-    Entry **new_entries = NULL;
+    Entry *new_entries = NULL;
 
     if (!map)
         return 0;
 
     /* Allocate new entries array */
     new_capacity = map->capacity * HASH_MAP_GROWTH_FACTOR;
-    new_entries = (Entry **)MALLOC(new_capacity * sizeof(Entry *));
+    new_entries = (Entry *)MALLOC(new_capacity * sizeof(Entry));
 
     if (!new_entries)
         return 0;
 
-    memset(new_entries, 0, new_capacity * sizeof(Entry *));
+    memset(new_entries, 0, new_capacity * sizeof(Entry));
 
-    /* Rehash all entries into the new array */
+    /* Reinsert all entries into the new array using their stored hash */
     for (i = 0; i < map->capacity; i++) 
     {
-        Entry *entry = map->entries[i];
+        Entry *entry = &map->entries[i];
         
-        while (entry) 
-        {
-            size_t index = hash(entry->key) % new_capacity;
-            Entry *next = entry->next;
-
-            entry->next = new_entries[index];
-            new_entries[index] = entry;
-
-            entry = next;
-        }
+        if (entry->key.str)
+            *hash_map_find_slot(new_entries, new_capacity, entry->key, entry->hash) = *entry;
     }
 
     FREE(map->entries);
@@ -201,4 +233,4 @@ int hash_map_resize(HashMap *map)
     map->capacity = new_capacity;
 
     return 1;
-}
\ No newline at end of file
+}
@@ -3,8 +3,11 @@
  * @brief Header file for a simple hash map implementation.
  * @details This file contains the definition of the hash map structure and function prototypes for creating,
  *          destroying, and manipulating the hash map.
- *          The hash map uses separate chaining for collision resolution and allows for dynamic resizing.
- *          The hash function is the djb2 algorithm.
+ *          The hash map uses open addressing with linear probing over a power of two capacity,
+ *          and stores the hash of every key next to it so most probes are decided without comparing strings.
+ *          Keys are interned into an arena owned by the map, so inserting a key does not allocate it on its own.
+ *          Lookups can be made with a StringView, no null terminated copy of the key is needed.
+ *          The hash function is FNV-1a.
  */
 
 #ifndef HASH_MAP_H  
@@ -12,28 +15,33 @@
 
 #include <stddef.h>
 
+#include "../common/string_view.h"
+#include "./arena.h"
+
 #define HASH_MAP_INIT_CAPACITY 16
 #define HASH_MAP_LOAD_FACTOR 0.75
 #define HASH_MAP_GROWTH_FACTOR 2
-#define HASH_CONSTANT 5381
-#define HASH_SHIFT 5
+#define HASH_MAP_KEYS_BLOCK_SIZE 4096
+#define HASH_FNV_OFFSET 2166136261UL
+#define HASH_FNV_PRIME 16777619UL
 
 /* Free function type for freeing elements in the hash map */
 typedef void (*HashMapFreeFunction)(void *ptr);
 
-/* Hash map entry structure */
+/* Hash map entry structure - entries are stored inline in the entries array */
 typedef struct Entry {
-    char *key;                      /* Key for the entry */
+    StringView key;                 /* Interned key for the entry, key.str is NULL for an empty slot */
+    size_t hash;                    /* Hash of the key */
     void *value;                    /* Value associated with the key */
-    struct Entry *next;             /* Pointer to the next entry in the linked list */
 } Entry;
 
 /* Hash map structure */
 typedef struct HashMap {
-    Entry **entries;                /* Array of pointers to linked lists of entries */
-    size_t capacity;                /* Total capacity of the hash map */
+    Entry *entries;                 /* Array of entries (slots) */
+    size_t capacity;                /* Total capacity of the hash map, always a power of two */
     size_t size;                    /* Number of entries in the hash map */
     HashMapFreeFunction free_func;  /* Function to free elements */
+    Arena *keys;                    /* Arena holding the interned keys */
 } HashMap;
 
 
@@ -54,6 +62,13 @@ HashMap *hash_map_create(HashMapFreeFunction free_func);
 
 void hash_map_destroy(HashMap *map);
 
+/**
+ * @brief Removes all the entries of a hash map, keeping its capacity for reuse.
+ * @param map Pointer to the hash map to clear.
+ * @note Frees the values using the free function if provided, the interned keys are released at once.
+ */
+void hash_map_clear(HashMap *map);
+
 /**
  * @brief Puts a key-value pair into the hash map.
  * @param map Pointer to the hash map.
@@ -64,6 +79,15 @@ void hash_map_destroy(HashMap *map);
  */
 void hash_map_put(HashMap *map, const char *key, void *value);
 
+/**
+ * @brief Puts a key-value pair into the hash map, with the key given as a StringView.
+ * @param map Pointer to the hash map.
+ * @param key Key for the entry, it does not have to be null terminated.
+ * @param value Value associated with the key.
+ * @note The key is copied (interned) into the map, so it does not have to outlive the call.
+ */
+void hash_map_put_sv(HashMap *map, StringView key, void *value);
+
 /**
  * @brief Gets a value from the hash map by key.
  * @param map Pointer to the hash map.
@@ -72,6 +96,14 @@ void hash_map_put(HashMap *map, const char *key, void *value);
  */
 void *hash_map_get(HashMap *map, const char *key);
 
+/**
+ * @brief Gets a value from the hash map by a StringView key.
+ * @param map Pointer to the hash map.
+ * @param key Key for the entry, it does not have to be null terminated.
+ * @return Pointer to the value associated with the key, or NULL if not found.
+ */
+void *hash_map_get_sv(HashMap *map, StringView key);
+
 /**
  * @brief Gets the number of entries in the hash map.
  * @param map Pointer to the hash map.
@@ -98,7 +130,9 @@ int hash_map_contains(HashMap *map, const char *key);
 
 /**
  * @brief Hash function for strings.
- * @param key Pointer to the string key.
+ * @param key The key as a StringView.
  * @return Hash value for the key.
- */size_t hash(const char *key);
-#endif /* HASH_MAP_H */
\ No newline at end of file
+ */
+size_t hash(StringView key);
+
+#endif /* HASH_MAP_H */
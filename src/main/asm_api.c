@@ -0,0 +1,177 @@
+/**
+ * @file asm_api.c
+ * @brief Implementation of the assembler library API.
+ * @details This file contains the in-memory assembly entry points. The source is handed to the preprocessor
+ *          through the context instead of being read from a file, the output phase is switched off with the
+ *          no_output option, and the results are copied out of the context before it is destroyed.
+ */
+
+#include <string.h>
+
+#include "./asm_api.h"
+#include "../assembly/first_pass.h"
+#include "../common/code_gen.h"
+#include "../common/util.h"
+
+/* Copies a list of symbols into an array, the names are appended to the names storage */
+static void copy_symbols(ArrayList *list, AsmSymbol *symbols, char **names)
+{
+    size_t i;
+
+    for (i = 0; i < array_list_size(list); i++)
+    {
+        Symbol *symbol = (Symbol *)array_list_get(list, i);
+
+        memcpy(*names, symbol->sv.str, symbol->sv.length);
+        (*names)[symbol->sv.length] = '\0';
+
+        symbols[i].name = *names;
+        symbols[i].address = (int)symbol->address;
+        *names += symbol->sv.length + 1;
+    }
+}
+
+/* Returns the size of the names of a list of symbols, terminators included */
+static size_t names_size(ArrayList *list)
+{
+    size_t i, size = 0;
+
+    for (i = 0; i < array_list_size(list); i++)
+        size += ((Symbol *)array_list_get(list, i))->sv.length + 1;
+
+    return size;
+}
+
+int asm_result_from_ctx(AssemblerContext *ctx, AsmResult *out)
+{
+    size_t i, code = 0, data = 0;
+    char *names = NULL;
+
+    if (!ctx || !out)
+        return 0;
+
+    memset(out, 0, sizeof(AsmResult));
+
+    /* Errors are formatted into the result, the records stay with the context */
+    out->error_count = error_record_count(ctx->errors);
+    if (out->error_count)
+    {
+        out->errors = (AsmError *)MALLOC(out->error_count * sizeof(AsmError));
+        if (!out->errors)
+            return 0;
+
+        for (i = 0; i < out->error_count; i++)
+        {
+            out->errors[i].type = error_record(ctx->errors, i)->type;
+            error_format(error_record(ctx->errors, i), out->errors[i].message, sizeof(out->errors[i].message));
+        }
+
+        return 1;
+    }
+
+    out->success = 1;
+
+    /* Split the image into the code and data words, like the .ob file */
+    for (i = 0; i < ctx->image_size; i++)
+    {
+        if (ctx->image[i] & WORD_DATA_FLAG)
+            out->data_count++;
+        else
+            out->code_count++;
+    }
+
+    out->entry_count = array_list_size(ctx->entries);
+    out->extern_count = array_list_size(ctx->externals);
+
+    out->code = (AsmWord *)MALLOC((out->code_count + 1) * sizeof(AsmWord));
+    out->data = (AsmWord *)MALLOC((out->data_count + 1) * sizeof(AsmWord));
+    out->entries = (AsmSymbol *)MALLOC((out->entry_count + 1) * sizeof(AsmSymbol));
+    out->externals = (AsmSymbol *)MALLOC((out->extern_count + 1) * sizeof(AsmSymbol));
+    out->names = (char *)MALLOC(names_size(ctx->entries) + names_size(ctx->externals) + 1);
+
+    if (!out->code || !out->data || !out->entries || !out->externals || !out->names)
+    {
+        asm_result_destroy(out);
+        return 0;
+    }
+
+    for (i = 0; i < ctx->image_size; i++)
+    {
+        AsmWord *word = (ctx->image[i] & WORD_DATA_FLAG) ? &out->data[data++] : &out->code[code++];
+
+        word->address = INITIAL_IC + (int)i;
+        word->value = ctx->image[i] & WORD_MASK;
+    }
+
+    names = out->names;
+    copy_symbols(ctx->entries, out->entries, &names);
+    copy_symbols(ctx->externals, out->externals, &names);
+
+    return 1;
+}
+
+int asm_assemble_buffer_opt(const char *src, size_t len, const AssemblerOptions *options, AsmResult *out)
+{
+    AssemblerContext ctx;
+    AssemblerOptions buffer_options = {0};
+
+    if (!out)
+        return 0;
+
+    memset(out, 0, sizeof(AsmResult));
+
+    if (!src)
+        return 0;
+
+    /* Same options, but the results stay in memory */
+    if (options)
+        buffer_options = *options;
+    buffer_options.no_output = 1;
+    buffer_options.jobs = 0;
+
+    asm_ctx_init(&ctx, ASM_BUFFER_NAME, &buffer_options);
+    if (!ctx.errors)
+        return 0;
+
+    ctx.source = src;
+    ctx.source_size = len;
+
+    assemble_file(&ctx);
+
+    if (!asm_result_from_ctx(&ctx, out))
+        memset(out, 0, sizeof(AsmResult));
+
+    asm_ctx_destroy(&ctx);
+    return out->success;
+}
+
+int asm_assemble_buffer(const char *src, size_t len, AsmResult *out)
+{
+    return asm_assemble_buffer_opt(src, len, NULL, out);
+}
+
+void asm_result_destroy(AsmResult *result)
+{
+    if (!result)
+        return;
+
+    if (result->code)
+        FREE(result->code);
+
+    if (result->data)
+        FREE(result->data);
+
+    if (result->entries)
+        FREE(result->entries);
+
+    if (result->externals)
+        FREE(result->externals);
+
+    if (result->errors)
+        FREE(result->errors);
+
+    if (result->names)
+        FREE(result->names);
+
+    memset(result, 0, sizeof(AsmResult));
+}
@@ -0,0 +1,98 @@
+/**
+ * @file asm_api.h
+ * @brief Header file for the assembler library API (libassembler.a).
+ * @details This file contains the definition of the AsmResult structure and the function assembling an
+ *          in-memory source into it. Nothing is read from or written to the filesystem - the code and data
+ *          images, the entries, the externals and the errors are all returned in memory.
+ *          Every call works on its own AssemblerContext, so separate calls may run concurrently on different threads.
+ */
+
+#ifndef ASM_API_H
+#define ASM_API_H
+
+#include <stddef.h>
+
+#include "./assembler.h"
+#include "../common/error.h"
+
+/* Name of the source in the diagnostics of asm_assemble_buffer() */
+#define ASM_BUFFER_NAME "buffer"
+
+/* Word of the assembled program structure */
+
+typedef struct {
+    int address;                                        /* Address of the word */
+    unsigned int value;                                 /* The 24 bit machine word */
+} AsmWord;
+
+/* Symbol of the assembled program structure */
+
+typedef struct {
+    const char *name;                                   /* Name of the symbol, owned by the result */
+    int address;                                        /* Address of the entry, or of the word referencing the external */
+} AsmSymbol;
+
+/* Error of the assembled program structure */
+
+typedef struct {
+    ErrorType type;                                     /* Type of the error */
+    char message[ERR_MSG_MAX_LEN];                      /* The formatted message, as printed in the error report */
+} AsmError;
+
+/* Assembly result structure */
+/* Everything the assembler would have written to the .ob, .ent and .ext files, and the reported errors */
+
+typedef struct {
+    int success;                                        /* 1 if the source was assembled without errors */
+    AsmWord *code;                                      /* Code words in address order, as listed in the .ob file */
+    size_t code_count;                                  /* Number of code words */
+    AsmWord *data;                                      /* Data words in address order, listed after the code in the .ob file */
+    size_t data_count;                                  /* Number of data words */
+    AsmSymbol *entries;                                 /* Entry symbols, as listed in the .ent file */
+    size_t entry_count;                                 /* Number of entries */
+    AsmSymbol *externals;                               /* References to external symbols, as listed in the .ext file */
+    size_t extern_count;                                /* Number of external references */
+    AsmError *errors;                                   /* The reported errors, in order */
+    size_t error_count;                                 /* Number of errors (repeated errors are folded into one) */
+    char *names;                                        /* Storage of the symbol names */
+} AsmResult;
+
+
+/**
+ * @brief Assembles a source held in memory.
+ * @param src The source text, does not have to be null terminated.
+ * @param len The size of the source text in bytes.
+ * @param out The result to fill, its previous contents are not freed.
+ * @return 1 if the source was assembled without errors, 0 otherwise (the errors are in out->errors).
+ * @note The default two pass engine is used. The diagnostics name the source ASM_BUFFER_NAME.
+ * @note The caller is responsible for freeing the result using asm_result_destroy().
+ */
+int asm_assemble_buffer(const char *src, size_t len, AsmResult *out);
+
+/**
+ * @brief Assembles a source held in memory with the given options.
+ * @param src The source text, does not have to be null terminated.
+ * @param len The size of the source text in bytes.
+ * @param options Options of the assembly, NULL for the defaults. No file is written whatever the options are.
+ * @param out The result to fill, its previous contents are not freed.
+ * @return 1 if the source was assembled without errors, 0 otherwise (the errors are in out->errors).
+ * @note The caller is responsible for freeing the result using asm_result_destroy().
+ */
+int asm_assemble_buffer_opt(const char *src, size_t len, const AssemblerOptions *options, AsmResult *out);
+
+/**
+ * @brief Fills a result from an assembled context.
+ * @param ctx Pointer to the assembled context.
+ * @param out The result to fill.
+ * @return 1 on success, 0 if the result could not be allocated.
+ * @note The images, entries and externals are only copied when the context has no errors.
+ */
+int asm_result_from_ctx(AssemblerContext *ctx, AsmResult *out);
+
+/**
+ * @brief Frees the memory of a result.
+ * @param result The result to free.
+ */
+void asm_result_destroy(AsmResult *result);
+
+#endif /* ASM_API_H */
@@ -1,22 +1,29 @@
 /**
  * @file assembler.c
- * @brief Main file for the assembler program.
- * @details This file contains the entry point to the program and the assembler context initialization and destruction functions.
+ * @brief Implementation of the assembler module.
+ * @details This file contains the assembler context initialization and destruction functions.
  *          It also includes the assembly process function which connects all the assembly phases.
  */
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "./assembler.h"
+#include "./worker_pool.h"
 #include "../assembly/preprocessor.h"   
 #include "../assembly/first_pass.h"   
 #include "../assembly/second_pass.h"   
+#include "../assembly/single_pass.h"
+#include "../assembly/parallel_pass.h"
+#include "../assembly/stream_pass.h"
+#include "../common/cache.h"
 #include "../common/error.h"
 #include "../common/file_io.h"
 #include "../common/util.h"
 #include "../common/code_gen.h"
+#include "../common/parser.h"
 
 /* Macros for easy initialization and destruction of array lists for the assembler context */
 #define INIT_LIST(field, free_func, error_msg)              \
@@ -36,90 +43,243 @@
         }
 
 
-int main(int argc, char **argv) 
+/* Files of a single assemble() call shared with the worker threads */
+typedef struct {
+    char **files;
+    const AssemblerOptions *options;
+    AssemblerContext *contexts;
+    Stats total;                                        /* Statistics summed over the reported files */
+} AssembleJob;
+
+/* Reports the errors and the statistics of a file, in file order */
+static void assemble_report(AssembleJob *job, AssemblerContext *ctx, int index)
 {
-    /* Check Command line arguments */
-    if (argc < 2) 
+    error_report_all(ctx->errors);
+
+    if (!ctx->stats.enabled)
+        return;
+
+    if (job->options->stats == STATS_JSON)
     {
-        fprintf(stderr, "Usage <%s> - At least one file name must be provided as a command line argument\n", argv[0]);  
-        return 1;
+        printf(index == 0 ? "{\"files\":[" : ",");
+        stats_print_json(stdout, ctx->filename, &ctx->stats, 0);
     }
+    else
+        stats_print(stdout, ctx->filename, &ctx->stats, 0);
+
+    stats_add(&job->total, &ctx->stats);
+}
 
-    /* Assemble the files */
-    assemble(argv + 1, argc - 1);
+/* Worker task - assembles a single file, keeping its errors in its context */
+static void assemble_job_run(void *arg, int index)
+{
+    AssembleJob *job = (AssembleJob *)arg;
+
+    asm_ctx_init(&job->contexts[index], job->files[index], job->options);
+    assemble_file(&job->contexts[index]);
 
-    return 0;
+    /* The context is released on the calling thread */
+    stats_set_thread_allocs(NULL);
 }
 
+/* Called in file order - reports the errors of the file and releases its context */
+static void assemble_job_done(void *arg, int index)
+{
+    AssembleJob *job = (AssembleJob *)arg;
+
+    assemble_report(job, &job->contexts[index], index);
+    asm_ctx_destroy(&job->contexts[index]);
+}
 
-void assemble(char **files, int file_count)
+void assemble(char **files, int file_count, const AssemblerOptions *options)
 {
+    AssembleJob job = {0};
+    double start = stats_wall_time();
     int i;
 
-    for (i = 0; i < file_count; i++)
-    {
-        AssemblerContext ctx = {0};
-        asm_ctx_init(&ctx, files[i]);
+    job.files = files;
+    job.options = options;
 
-        /* Preprocess the file */
-        preprocess(&ctx);
-        
-        /* Check for errors and if there are any, report them and move to next file if exists */
-        if (array_list_size(ctx.errors) > 0) 
-        {
-            error_report_all(ctx.errors);
-            asm_ctx_destroy(&ctx);
-            continue;
-        }
-        
-        /* First pass - build symbol table and calculate IC and DC */
-        first_pass(&ctx);
+    /* Parallel - spread the files over a pool of worker threads */
+    if (options && options->jobs > 1 && file_count > 1)
+        job.contexts = (AssemblerContext *)MALLOC(file_count * sizeof(AssemblerContext));
 
-        if (array_list_size(ctx.errors) > 0) 
+    if (job.contexts)
+    {
+        worker_pool_run(options->jobs, file_count, assemble_job_run, assemble_job_done, &job);
+        FREE(job.contexts);
+    }
+    else
+    {
+        for (i = 0; i < file_count; i++)
         {
-            error_report_all(ctx.errors);
+            AssemblerContext ctx = {0};
+            asm_ctx_init(&ctx, files[i], options);
+
+            assemble_file(&ctx);
+
+            assemble_report(&job, &ctx, i);
             asm_ctx_destroy(&ctx);
-            continue;
         }
+    }
+
+    /* Statistics of the whole run */
+    if (options && options->stats == STATS_JSON)
+    {
+        printf("],\"total\":");
+        stats_print_json(stdout, NULL, &job.total, stats_wall_time() - start);
+        printf("}\n");
+    }
+    else if (options && options->stats)
+        stats_print(stdout, NULL, &job.total, stats_wall_time() - start);
+}
 
-        /* Second pass - encode instructions and directives */
-        second_pass(&ctx);
+/* Runs the phases of assemble_file(), stopping after the first phase that reports errors */
+static void assemble_phases(AssemblerContext *ctx)
+{
+    int is_parallel = ctx->options && ctx->options->threads > 1;
+    int is_streamed = ctx->options && ctx->options->stream && !ctx->options->single_pass && !is_parallel;
+
+    /* Streaming - the first pass runs on every line as soon as it is preprocessed, so the two are timed as one phase */
+    if (is_streamed)
+    {
+        stats_phase_begin(&ctx->stats, PHASE_STREAM);
+        stream_first_pass(ctx);
+        stats_phase_end(&ctx->stats);
+    }
+    else
+    {
+        /* Preprocess the file */
+        stats_phase_begin(&ctx->stats, PHASE_PREPROCESS);
+        preprocess(ctx);
+        stats_phase_end(&ctx->stats);
+    
+        /* Check for errors and if there are any, stop - they are reported by the caller */
+        if (error_count(ctx->errors) > 0) 
+            return;
 
-        if (array_list_size(ctx.errors) > 0) 
+        /* Single pass - encode while building the symbol table and resolve forward references at EOF */
+        if (ctx->options && ctx->options->single_pass)
         {
-            error_report_all(ctx.errors);
-            asm_ctx_destroy(&ctx);
-            continue;
+            stats_phase_begin(&ctx->stats, PHASE_SINGLE_PASS);
+            single_pass(ctx);
+            stats_phase_end(&ctx->stats);
+            return;
         }
-        
-        asm_ctx_destroy(&ctx);
+    
+        /* First pass - build symbol table and calculate IC and DC, split over threads with -t N */
+        stats_phase_begin(&ctx->stats, PHASE_FIRST_PASS);
+        if (is_parallel)
+            parallel_first_pass(ctx);
+        else
+            first_pass(ctx);
+        stats_phase_end(&ctx->stats);
     }
+
+    if (error_count(ctx->errors) > 0) 
+        return;
+
+    /* Second pass - encode instructions and directives */
+    stats_phase_begin(&ctx->stats, PHASE_SECOND_PASS);
+    if (is_parallel)
+        parallel_second_pass(ctx);
+    else
+        second_pass(ctx);
+    stats_phase_end(&ctx->stats);
 }
 
-void asm_ctx_init(AssemblerContext *ctx, const char *filename)
+void assemble_file(AssemblerContext *ctx)
+{
+    const char *cache_dir = ctx && ctx->options && !ctx->source ? ctx->options->cache_dir : NULL;
+    char key[CACHE_KEY_MAX];
+    char *source = NULL;
+    size_t i, source_size = 0;
+    int is_cached = 0;
+
+    if (!ctx || !ctx->errors)
+        return;
+
+    /* Build cache - an unchanged source only has its outputs and diagnostics replayed */
+    if (cache_dir)
+    {
+        is_cached = cache_lookup(ctx, cache_dir, key, &source, &source_size);
+
+        /* On a miss the phases use the source already read for the key */
+        ctx->source = source;
+        ctx->source_size = source_size;
+    }
+
+    if (!is_cached)
+        assemble_phases(ctx);
+
+    if (cache_dir)
+    {
+        /* A file stopped by --max-errors is not cached, its diagnostics are incomplete */
+        if (!is_cached && source && !error_limit_reached(ctx->errors))
+            cache_store(ctx, cache_dir, key);
+
+        ctx->source = NULL;
+        ctx->source_size = 0;
+
+        if (source)
+            FREE(source);
+    }
+
+    if (!ctx->stats.enabled)
+        return;
+
+    /* Sizes of the assembled file */
+    ctx->stats.lines += array_list_size(ctx->preprocessed_lines);
+    for (i = 0; i < ctx->token_line_count; i++)
+        ctx->stats.tokens += ctx->token_lines[i].count;
+    ctx->stats.symbols = hash_map_size(ctx->symbol_table);
+    ctx->stats.words = ctx->image_size;
+    ctx->stats.errors = error_count(ctx->errors);
+}
+
+void asm_ctx_init(AssemblerContext *ctx, const char *filename, const AssemblerOptions *options)
 {
     if (!ctx)
         return;
     
     /* Initialize all properties to NULL/0 first */
     memset(ctx, 0, sizeof(AssemblerContext));
+    ctx->options = options;
     ctx->filename = filename;
     ctx->ir_filename = NULL;
     ctx->IC = INITIAL_IC;
+
+    /* Count the allocations of the file from here on into its statistics */
+    ctx->stats.enabled = options && options->stats;
+    if (ctx->stats.enabled)
+        stats_set_thread_allocs(&ctx->stats.allocs);
     
-    /* Initialize all the array lists */
-    INIT_LIST(errors, error_destroy, "Failed to create error list\n");
-    INIT_LIST(preprocessed_lines, free_string, "Failed to create preprocessed lines list\n");
-    INIT_LIST(tokens, token_destroy, "Failed to create tokens list\n");
-    INIT_LIST(code_img, word_destroy, "Failed to create code image list\n");
-    INIT_LIST(data_img, word_destroy, "Failed to create data image list\n");
-    INIT_LIST(entries, symbol_destroy, "Failed to create entries list\n");
-    INIT_LIST(externals, symbol_destroy, "Failed to create externals list\n");
-    INIT_LIST(entry_names, symbol_destroy, "Failed to create entry names list\n");
+    /* Initialize the arena - the file's tokens, symbols and lines are all allocated from it */
+    ctx->arena = arena_create(ARENA_BLOCK_SIZE);
+    if (!ctx->arena)
+    {
+        fprintf(stderr, "Failed to create arena\n");
+        return;
+    }
+
+    /* Initialize the error log */
+    ctx->errors = error_log_create(options && options->max_errors > 0 ? (unsigned long)options->max_errors : 0);
+    if (!ctx->errors)
+    {
+        fprintf(stderr, "Failed to create error log\n");
+        asm_ctx_destroy(ctx);
+        return;
+    }
+
+    /* Initialize all the array lists - lists of arena owned items have no free function */
+    INIT_LIST(preprocessed_lines, NULL, "Failed to create preprocessed lines list\n");
+    INIT_LIST(entries, NULL, "Failed to create entries list\n");
+    INIT_LIST(externals, NULL, "Failed to create externals list\n");
+    INIT_LIST(entry_names, NULL, "Failed to create entry names list\n");
     INIT_LIST(extern_names, NULL, "Failed to create extern names list\n");
     
     /* Initialize the symbol table */
-    ctx->symbol_table = hash_map_create(free_string);
+    ctx->symbol_table = hash_map_create(NULL);
     if (!ctx->symbol_table) 
     {
         fprintf(stderr, "Failed to create symbol table\n");
@@ -128,21 +288,66 @@ void asm_ctx_init(AssemblerContext *ctx, const char *filename)
     }
 }
 
+void asm_ctx_reset(AssemblerContext *ctx, const char *filename)
+{
+    if (!ctx || !ctx->errors)
+        return;
+
+    /* Empty the lists and the symbol table, their storage is kept */
+    error_log_clear(ctx->errors);
+    array_list_clear(ctx->preprocessed_lines);
+    array_list_clear(ctx->entries);
+    array_list_clear(ctx->externals);
+    array_list_clear(ctx->entry_names);
+    array_list_clear(ctx->extern_names);
+    DESTROY_IF_EXISTS(fixups);
+    hash_map_clear(ctx->symbol_table);
+
+    /* The arrays are refilled from the start */
+    ctx->token_line_count = 0;
+    ctx->statement_count = 0;
+    ctx->image_size = 0;
+
+    if (ctx->ir_filename)
+        FREE(ctx->ir_filename);
+
+    if (ctx->line_buffer)
+        FREE(ctx->line_buffer);
+
+    ctx->filename = filename;
+    ctx->source = NULL;
+    ctx->source_size = 0;
+    ctx->line_number = 0;
+    ctx->IC = INITIAL_IC;
+    ctx->DC = 0;
+    ctx->outputs = 0;
+
+    /* The statistics start over for the next file */
+    memset(&ctx->stats, 0, sizeof(Stats));
+    ctx->stats.enabled = ctx->options && ctx->options->stats;
+
+    /* Tokens, symbols and lines of the previous file are released at once */
+    arena_reset(ctx->arena);
+}
+
 void asm_ctx_destroy(AssemblerContext *ctx)
 {
     if (!ctx)
         return;
 
+    if (ctx->errors)
+    {
+        error_log_destroy(ctx->errors);
+        ctx->errors = NULL;
+    }
+
     /* Destroy all the array lists */
-    DESTROY_IF_EXISTS(errors);
     DESTROY_IF_EXISTS(preprocessed_lines);
-    DESTROY_IF_EXISTS(tokens);
-    DESTROY_IF_EXISTS(code_img);
-    DESTROY_IF_EXISTS(data_img);
     DESTROY_IF_EXISTS(entries);
     DESTROY_IF_EXISTS(externals);
     DESTROY_IF_EXISTS(entry_names);
     DESTROY_IF_EXISTS(extern_names);
+    DESTROY_IF_EXISTS(fixups);
     
     /* Destroy the symbol table */
     if (ctx->symbol_table) 
@@ -151,8 +356,34 @@ void asm_ctx_destroy(AssemblerContext *ctx)
         ctx->symbol_table = NULL;
     }
 
+    /* Free the parsed statements */
+    if (ctx->statements)
+        FREE(ctx->statements);
+
+    /* Free the token line index */
+    if (ctx->token_lines)
+        FREE(ctx->token_lines);
+
+    if (ctx->image)
+        FREE(ctx->image);
+
     /* Free IR filename */
     if (ctx->ir_filename) 
         FREE(ctx->ir_filename);
+
+    /* Free the source buffer of the preprocessed lines */
+    if (ctx->line_buffer)
+        FREE(ctx->line_buffer);
+
+    /* Release all the arena allocations at once */
+    if (ctx->arena)
+    {
+        arena_destroy(ctx->arena);
+        ctx->arena = NULL;
+    }
+
+    /* Stop counting into the statistics of the released context */
+    if (stats_thread_allocs() == &ctx->stats.allocs)
+        stats_set_thread_allocs(NULL);
     
 }
\ No newline at end of file
@@ -10,28 +10,75 @@
 
 #include "../data_structures/array_list.h"
 #include "../data_structures/hash_map.h"
+#include "../data_structures/arena.h"
+#include "../common/stats.h"
+#include "../common/error.h"
 
 
 #define INITIAL_IC 100
 
+/* Version of the assembler - part of the build cache key, bump it whenever the output of a source may change */
+#define ASM_VERSION "1.1"
+
+/* Assembler options structure */
+/* Command line options shared by all the files of a single run */
+
+typedef struct {
+    int single_pass;                                    /* Assemble with the single pass engine instead of two passes */
+    int jobs;                                           /* Number of files assembled in parallel (-j N) */
+    int threads;                                        /* Number of threads sharing the passes of a single file (-t N) */
+    int no_am;                                          /* Keep the preprocessed lines in memory only, without writing the .am file */
+    int binary_object;                                  /* Also write the binary object file (.obb) */
+    int no_output;                                      /* Keep the results in the context only, without writing any file */
+    const char *cache_dir;                              /* Directory of the build cache (--cache DIR), NULL for none */
+    int stats;                                          /* Print statistics of the run - STATS_NONE, STATS_TEXT or STATS_JSON */
+    int max_errors;                                     /* Stop assembling a file after this many errors (--max-errors N), 0 for no limit */
+    int stream;                                         /* Stream the preprocessed lines into the passes instead of keeping them (--stream) */
+    int run;                                            /* Run the assembled (or linked) programs in the simulator (--run) */
+    unsigned long max_steps;                            /* Stop a program after this many instructions (--max-steps N), 0 for no limit */
+} AssemblerOptions;
+
+/* Token line structure */
+/* The tokens of a single line, stored contiguously by value in the arena, indexed by line number - 1 */
+
+typedef struct {
+    struct Token *tokens;                               /* The tokens of the line */
+    size_t count;                                       /* Number of tokens in the line */
+} TokenLine;
+
 /* Assembler context structure */
 
 typedef struct {
-    ArrayList *errors;                                  /* List of errors encountered during assembly */
+    const AssemblerOptions *options;                    /* Options of the current run */
+    Arena *arena;                                       /* Arena owning the tokens, symbols and lines of the file */
+    Arena *line_arena;                                  /* Arena of the current line when streaming (--stream), NULL otherwise */
+    ErrorLog *errors;                                   /* Log of the errors encountered during assembly */
     const char *filename;                               /* Name of the source file being assembled */
+    const char *source;                                 /* In-memory source read instead of the file, NULL to read the file */
+    size_t source_size;                                 /* Size of the in-memory source in bytes */
     const char *ir_filename;                            /* Name of the intermediate representation file (.am)*/
     size_t line_number;                                 /* Current line number in the source file */
     ArrayList *preprocessed_lines;                      /* List of preprocessed lines */
-    ArrayList *tokens;                                  /* List of tokens generated from the source file */
+    char *line_buffer;                                  /* Source buffer the preprocessed lines point into */
+    TokenLine *token_lines;                             /* Per line token arrays */
+    size_t token_line_count;                            /* Number of lines in token_lines */
+    size_t token_line_capacity;                         /* Allocated capacity of token_lines */
+    struct Statement *statements;                       /* Parsed statements built by the first pass */
+    size_t statement_count;                             /* Number of parsed statements */
+    size_t statement_capacity;                          /* Allocated capacity of statements */
     HashMap *symbol_table;                              /* Symbol table for storing labels and their addresses */
-    ArrayList *code_img;                                /* List of code image words */
-    ArrayList *data_img;                                /* List of data image words */
+    unsigned int *image;                                /* Code and data words (Word) indexed by address - INITIAL_IC */
+    size_t image_size;                                  /* Number of words in the image */
+    size_t image_capacity;                              /* Allocated capacity of the image */
     ArrayList *entries;                                 /* List of entry references */
     ArrayList *externals;                               /* List of external references */
     ArrayList *entry_names;                             /* List of entry names */
     ArrayList *extern_names;                            /* List of external names */
+    ArrayList *fixups;                                  /* List of unresolved symbol references (single pass only) */
     int IC;                                             /* Instruction Counter */
     int DC;                                             /* Data Counter */                    
+    Stats stats;                                        /* Timing and allocation statistics (--stats) */
+    unsigned int outputs;                               /* Output files written (OUTPUT_FILE_* flags) */
 } AssemblerContext;
 
 
@@ -39,20 +86,45 @@ typedef struct {
  * @brief Assembles the given files.
  * @param files Array of file names to assemble.
  * @param file_count Number of files to assemble.
+ * @param options Options of the run, NULL for the defaults.
  * @note This function processes each file, performing preprocessing, first pass,
  *       and second pass assembly. It generates the output files (.ob, .ent, .ext) if assembly is successful.
+ * @note With options->single_pass the first and second pass are replaced by single_pass().
+ * @note With options->jobs > 1 the files are spread over a pool of worker threads,
+ *       the errors of each file are still reported in the order of the files.
+ * @note With options->threads > 1 the first and second pass of a large file are split over a pool of worker threads.
+ * @note With options->stats the statistics of each file and of the whole run are printed to stdout.
  */
-void assemble(char **files, int file_count);
+void assemble(char **files, int file_count, const AssemblerOptions *options);
+
+/**
+ * @brief Runs all the assembly phases on a single file.
+ * @param ctx Pointer to an initialized AssemblerContext.
+ * @note Stops after the first phase that reports errors. The errors are left in ctx->errors to be reported by the caller.
+ * @note With options->max_errors a phase also stops as soon as the file reached that many errors.
+ * @note With options->cache_dir an unchanged source is served from the build cache without running any phase.
+ */
+void assemble_file(AssemblerContext *ctx);
 
 
 /**
  * @brief Initializes the assembler context.
  * @param ctx Pointer to the AssemblerContext to initialize.
  * @param filename Name of the source file to assemble.
+ * @param options Options of the run, NULL for the defaults.
  * @note This function allocates memory for the context and initializes its fields.
  */
 
-void asm_ctx_init(AssemblerContext *ctx, const char *filename);
+void asm_ctx_init(AssemblerContext *ctx, const char *filename, const AssemblerOptions *options);
+
+/**
+ * @brief Resets an initialized assembler context for the next file, keeping its allocated storage.
+ * @param ctx Pointer to the AssemblerContext to reset.
+ * @param filename Name of the next source file to assemble.
+ * @note The lists are cleared with array_list_clear() and the arena is reset instead of being recreated,
+ *       so assembling many files on one context only allocates when a file outgrows the previous ones.
+ */
+void asm_ctx_reset(AssemblerContext *ctx, const char *filename);
 
 /**
  * @brief Destroys the assembler context and frees allocated memory.
@@ -0,0 +1,242 @@
+/**
+ * @file daemon.c
+ * @brief Implementation of the daemon mode of the assembler.
+ * @details This file contains the request loop of the daemon mode. Each request is assembled from memory on the
+ *          session's context, and the .ob, .ent and .ext contents are formatted into one reusable buffer and written
+ *          back as a single frame. See daemon.h for the protocol.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./daemon.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/util.h"
+
+/* Writes a response frame - the header line, then the body */
+static void daemon_respond(FILE *out, const char *header, OutputBuffer *body)
+{
+    fputs(header, out);
+    if (body->length)
+        fwrite(body->data, 1, body->length, out);
+    fflush(out);
+}
+
+/* Responds with a single protocol error */
+static void daemon_protocol_error(FILE *out, OutputBuffer *body, const char *message)
+{
+    char header[DAEMON_HEADER_MAX];
+
+    body->length = 0;
+    output_append(body, "[Protocol] ", 11);
+    output_append(body, message, strlen(message));
+    output_char(body, '\n');
+
+    sprintf(header, "ERROR %lu\n", (unsigned long)body->length);
+    daemon_respond(out, header, body);
+}
+
+/* Formats the result of an assembled request and writes it */
+static void daemon_respond_result(FILE *out, AssemblerContext *ctx, OutputBuffer *body)
+{
+    char header[DAEMON_HEADER_MAX];
+    char message[ERR_MSG_MAX_LEN];
+    size_t i, ob_length = 0, ent_length = 0;
+    Error *error = NULL;
+
+    body->length = 0;
+
+    /* Errors - the lines of the error report */
+    if (error_count(ctx->errors) > 0)
+    {
+        for (i = 0; i < error_record_count(ctx->errors); i++)
+        {
+            error = error_record(ctx->errors, i);
+
+            output_char(body, '[');
+            output_append(body, error_type_name(error->type), strlen(error_type_name(error->type)));
+            output_append(body, "] ", 2);
+            output_append(body, message, error_format(error, message, sizeof(message)));
+            output_char(body, '\n');
+        }
+
+        sprintf(header, "ERROR %lu\n", (unsigned long)body->length);
+        daemon_respond(out, header, body);
+        return;
+    }
+
+    /* The .ob, .ent and .ext sections, each one only when the file would be written */
+    if (ctx->image_size > (size_t)ctx->DC)
+        output_object(body, ctx);
+    ob_length = body->length;
+
+    for (i = 0; i < (size_t)array_list_size(ctx->entries); i++)
+        write_symbol_to_file(body, array_list_get(ctx->entries, i));
+    ent_length = body->length - ob_length;
+
+    for (i = 0; i < (size_t)array_list_size(ctx->externals); i++)
+        write_symbol_to_file(body, array_list_get(ctx->externals, i));
+
+    sprintf(header, "OK %lu %lu %lu\n", (unsigned long)ob_length, (unsigned long)ent_length,
+            (unsigned long)(body->length - ob_length - ent_length));
+    daemon_respond(out, header, body);
+}
+
+/* Parses an ASSEMBLE header into the length and the name of the source, returns 0 if it is malformed */
+static int daemon_parse_header(const char *header, unsigned long *length, char *name)
+{
+    char *end = NULL;
+
+    /* A sign or a blank before the digits would be accepted by strtoul */
+    if (strncmp(header, "ASSEMBLE ", 9) != 0 || !isdigit((unsigned char)header[9]))
+        return 0;
+
+    *length = strtoul(header + 9, &end, 10);
+    if (*end != '\0' && !isspace((unsigned char)*end))
+        return 0;
+
+    strcpy(name, DAEMON_DEFAULT_NAME);
+    sscanf(end, "%255s", name);
+
+    return 1;
+}
+
+/* Reads and drops the source of a rejected request, returns 0 at the end of the input */
+static int daemon_skip_source(FILE *in, unsigned long length)
+{
+    char buffer[4096];
+    size_t chunk = 0;
+
+    while (length > 0)
+    {
+        chunk = length < sizeof(buffer) ? (size_t)length : sizeof(buffer);
+        if (fread(buffer, 1, chunk, in) != chunk)
+            return 0;
+
+        length -= chunk;
+    }
+
+    return 1;
+}
+
+/* Reads a request header line, returns 0 at the end of the input */
+static int daemon_read_header(FILE *in, char *header)
+{
+    size_t length = 0;
+    int c;
+
+    if (!fgets(header, DAEMON_HEADER_MAX, in))
+        return 0;
+
+    length = strlen(header);
+
+    /* Drop the rest of an overlong line, the header is then rejected */
+    if (length == DAEMON_HEADER_MAX - 1 && header[length - 1] != '\n')
+    {
+        while ((c = getc(in)) != EOF && c != '\n')
+            ;
+        header[0] = '\0';
+    }
+
+    return 1;
+}
+
+int daemon_run(FILE *in, FILE *out, const AssemblerOptions *options)
+{
+    AssemblerOptions daemon_options = {0};
+    AssemblerContext ctx;
+    OutputBuffer body;
+    char header[DAEMON_HEADER_MAX];
+    char name[DAEMON_NAME_MAX + 1];
+    char *source = NULL, *new_source = NULL;
+    size_t source_capacity = 0;
+    unsigned long length = 0;
+    int initialized = 0;
+    int status = 0;
+
+    if (!in || !out)
+        return 1;
+
+    /* Same options, but every result goes out over the stream */
+    if (options)
+        daemon_options = *options;
+    daemon_options.no_output = 1;
+    daemon_options.jobs = 0;
+    daemon_options.stats = STATS_NONE;
+
+    output_init(&body, 0);
+
+    while (daemon_read_header(in, header))
+    {
+        if (strcmp(header, "QUIT\n") == 0 || strcmp(header, "QUIT") == 0)
+            break;
+
+        if (!daemon_parse_header(header, &length, name))
+        {
+            daemon_protocol_error(out, &body, "Expected 'ASSEMBLE <length> [name]' or 'QUIT'");
+            continue;
+        }
+
+        /* The source of a request that is too long is dropped, so the next header is read in place */
+        if (length > DAEMON_SOURCE_MAX)
+        {
+            daemon_protocol_error(out, &body, "Source length exceeds the maximum of the daemon");
+
+            if (!daemon_skip_source(in, length))
+                break;
+            continue;
+        }
+
+        /* Read the source into the reusable buffer - the length is capped, so length + 1 does not wrap */
+        if (length + 1 > source_capacity)
+        {
+            new_source = (char *)REALLOC(source, length + 1);
+            if (!new_source)
+            {
+                status = 1;
+                break;
+            }
+
+            source = new_source;
+            source_capacity = length + 1;
+        }
+
+        if (fread(source, 1, length, in) != length)
+        {
+            status = 1;
+            break;
+        }
+
+        /* The context is created by the first request and reset by the next ones */
+        if (!initialized)
+        {
+            asm_ctx_init(&ctx, name, &daemon_options);
+            if (!ctx.errors)
+            {
+                status = 1;
+                break;
+            }
+            initialized = 1;
+        }
+        else
+            asm_ctx_reset(&ctx, name);
+
+        ctx.source = source;
+        ctx.source_size = length;
+
+        assemble_file(&ctx);
+        daemon_respond_result(out, &ctx, &body);
+    }
+
+    if (initialized)
+        asm_ctx_destroy(&ctx);
+
+    if (source)
+        FREE(source);
+
+    output_destroy(&body);
+    return status;
+}
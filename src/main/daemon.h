@@ -0,0 +1,44 @@
+/**
+ * @file daemon.h
+ * @brief Header file for the daemon mode of the assembler (--daemon).
+ * @details This file contains the function prototype of a long running loop that assembles sources sent over a stream,
+ *          using a simple framed protocol. One AssemblerContext is kept for the whole session and reset between
+ *          the requests, so its lists, tables and arena are reused instead of being recreated for every source.
+ *
+ * Protocol - every frame is a header line followed by exactly the number of bytes given in the header:
+ *
+ *   Request:   ASSEMBLE <length> [name]\n<length bytes of source>
+ *              QUIT\n                                       (or end of input) ends the session
+ *
+ *   Response:  OK <ob length> <ent length> <ext length>\n<.ob contents><.ent contents><.ext contents>
+ *              ERROR <length>\n<length bytes of "[type] message\n" lines>
+ *
+ * A header that is not a request, or a length that does not start with a digit, is answered with a protocol error.
+ * A source longer than DAEMON_SOURCE_MAX is skipped and answered with a protocol error, the session goes on.
+ *
+ * The contents are exactly what the assembler would write to the output files, a section is empty (length 0)
+ * when the file would not be written. The name is only used in the diagnostics, it defaults to DAEMON_DEFAULT_NAME.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdio.h>
+
+#include "./assembler.h"
+
+#define DAEMON_HEADER_MAX 512                           /* Maximum length of a request header line */
+#define DAEMON_NAME_MAX 255                             /* Maximum length of the name in a request */
+#define DAEMON_SOURCE_MAX (64UL * 1024 * 1024)          /* Maximum length of the source of a request */
+#define DAEMON_DEFAULT_NAME "buffer"                    /* Name of the source when the request has none */
+
+/**
+ * @brief Serves assembly requests until QUIT or the end of the input.
+ * @param in The stream the requests are read from.
+ * @param out The stream the responses are written to, flushed after every response.
+ * @param options Options applied to every request, NULL for the defaults. No file is ever written.
+ * @return 0 when the session ended normally, 1 on a read or allocation failure.
+ */
+int daemon_run(FILE *in, FILE *out, const AssemblerOptions *options);
+
+#endif /* DAEMON_H */
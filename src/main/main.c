@@ -0,0 +1,227 @@
+/**
+ * @file main.c
+ * @brief Main file for the assembler program.
+ * @details This file contains the entry point to the program, which parses the command line options
+ *          and assembles the given files. Everything else is linked from the assembler library (libassembler.a).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./assembler.h"
+#include "./daemon.h"
+#include "./simulator.h"
+#include "./watch.h"
+#include "../assembly/linker.h"
+
+#define USAGE "Usage <%s> [--single-pass] [--stream] [--no-am] [--binary] [--stats | --stats-json] [--cache DIR] [--max-errors N] [-j N] [-t N] <file1> [file2] ... - At least one file name must be provided as a command line argument\n"
+#define USAGE_MODES "       <%s> --daemon [--single-pass] - Assemble the sources sent on stdin, see daemon.h for the protocol\n" \
+                    "       <%s> --watch [options] <file1> [file2] ... - Reassemble the files whenever they change, until Ctrl+C\n" \
+                    "       <%s> --link [options] <module1> [module2] ... -o <program> - Link sources or .obb files into one program\n" \
+                    "       <%s> --run [--max-steps N] [options] <file1> [file2] ... - Run the assembled (or linked) programs\n"
+
+
+int main(int argc, char **argv) 
+{
+    AssemblerOptions options = {0};
+    int file_count = 0;
+    int daemon_mode = 0;
+    int watch_mode = 0;
+    int link_mode = 0;
+    const char *program = NULL;
+    int i;
+
+    /* Check Command line arguments */
+    if (argc < 2) 
+    {
+        fprintf(stderr, USAGE, argv[0]);
+        fprintf(stderr, USAGE_MODES, argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    /* Separate the options from the file names, file names are compacted to the start of argv + 1 */
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--single-pass") == 0)
+            options.single_pass = 1;
+
+        else if (strcmp(argv[i], "--stream") == 0)
+            options.stream = 1;
+
+        else if (strcmp(argv[i], "--no-am") == 0)
+            options.no_am = 1;
+
+        else if (strcmp(argv[i], "--binary") == 0)
+            options.binary_object = 1;
+
+        else if (strcmp(argv[i], "--daemon") == 0)
+            daemon_mode = 1;
+
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch_mode = 1;
+
+        else if (strcmp(argv[i], "--link") == 0)
+            link_mode = 1;
+
+        else if (strcmp(argv[i], "--run") == 0)
+            options.run = 1;
+
+        /* Number of instructions after which a program is stopped */
+        else if (strcmp(argv[i], "--max-steps") == 0)
+        {
+            if (i + 1 >= argc || atol(argv[++i]) < 1)
+            {
+                fprintf(stderr, "Invalid number of instructions for option '--max-steps'\n");
+                return 1;
+            }
+
+            options.max_steps = (unsigned long)atol(argv[i]);
+        }
+
+        /* Name of the linked program */
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "Missing program name for option '-o'\n");
+                return 1;
+            }
+
+            program = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--stats") == 0)
+            options.stats = STATS_TEXT;
+
+        else if (strcmp(argv[i], "--stats-json") == 0)
+            options.stats = STATS_JSON;
+
+        /* Directory of the build cache */
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "Missing directory for option '--cache'\n");
+                return 1;
+            }
+
+            options.cache_dir = argv[++i];
+        }
+
+        /* Number of errors after which a file is stopped */
+        else if (strcmp(argv[i], "--max-errors") == 0)
+        {
+            if (i + 1 >= argc || (options.max_errors = atoi(argv[++i])) < 1)
+            {
+                fprintf(stderr, "Invalid number of errors for option '--max-errors'\n");
+                return 1;
+            }
+        }
+
+        /* Number of parallel jobs, either -j N or -jN */
+        else if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            char *jobs = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : NULL);
+
+            if (!jobs || (options.jobs = atoi(jobs)) < 1)
+            {
+                fprintf(stderr, "Invalid number of jobs for option '-j'\n");
+                return 1;
+            }
+        }
+
+        /* Number of threads per file, either -t N or -tN */
+        else if (strncmp(argv[i], "-t", 2) == 0)
+        {
+            char *threads = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : NULL);
+
+            if (!threads || (options.threads = atoi(threads)) < 1)
+            {
+                fprintf(stderr, "Invalid number of threads for option '-t'\n");
+                return 1;
+            }
+        }
+
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+
+        else
+            argv[1 + file_count++] = argv[i];
+    }
+
+    /* Daemon mode - serve the requests on stdin, the files come with the requests */
+    if (daemon_mode)
+    {
+        if (file_count > 0)
+        {
+            fprintf(stderr, "File names can not be given with '--daemon'\n");
+            return 1;
+        }
+
+        if (watch_mode || link_mode || options.run)
+        {
+            fprintf(stderr, "Option '%s' can not be used with '--daemon'\n",
+                    watch_mode ? "--watch" : (link_mode ? "--link" : "--run"));
+            return 1;
+        }
+
+        return daemon_run(stdin, stdout, &options);
+    }
+
+    if (file_count == 0)
+    {
+        fprintf(stderr, USAGE, argv[0]);
+        fprintf(stderr, USAGE_MODES, argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    /* The program name and the link stage come together */
+    if (link_mode != (program != NULL))
+    {
+        fprintf(stderr, link_mode ? "Missing program name, give it with '-o'\n" : "Option '-o' requires '--link'\n");
+        return 1;
+    }
+
+    if (link_mode && watch_mode)
+    {
+        fprintf(stderr, "Option '--watch' can not be used with '--link'\n");
+        return 1;
+    }
+
+    if (options.run && watch_mode)
+    {
+        fprintf(stderr, "Option '--run' can not be used with '--watch'\n");
+        return 1;
+    }
+
+    if (options.max_steps && !options.run)
+    {
+        fprintf(stderr, "Option '--max-steps' requires '--run'\n");
+        return 1;
+    }
+
+    /* Allocations are tracked from the first one, so every block carries the same header */
+    if (options.stats)
+        stats_enable_alloc_tracking();
+
+    /* Link stage - assemble the modules in memory and link them into a single program, run it with --run */
+    if (link_mode)
+        return link_modules(argv + 1, file_count, program, &options);
+
+    /* Watch mode - reassemble the files whenever they change */
+    if (watch_mode)
+        return watch_run(argv + 1, file_count, &options);
+
+    /* Run mode - assemble the files and run their programs */
+    if (options.run)
+        return sim_run_files(argv + 1, file_count, &options);
+
+    /* Assemble the files */
+    assemble(argv + 1, file_count, &options);
+
+    return 0;
+}
@@ -0,0 +1,605 @@
+/**
+ * @file simulator.c
+ * @brief Implementation of the simulator of the assembled programs.
+ * @details This file contains the decoder of the machine words into SimInstructions, the dispatch loop executing
+ *          them, and the run mode assembling and running the files. See simulator.h for the machine.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "./simulator.h"
+#include "../common/code_gen.h"
+#include "../common/error.h"
+#include "../common/stats.h"
+#include "../common/util.h"
+
+/* Sign bits of a word and of the value of an extra word */
+#define SIM_WORD_SIGN (1UL << (WORD_BITS - 1))
+#define SIM_VALUE_SIGN (1UL << (WORD_BITS - IMM_SHIFT - 1))
+
+/* Operations of the decoded instructions - the addressing modes are already resolved into the operands */
+typedef enum {
+    SIM_OP_DECODE,                                      /* Not decoded yet, or dropped by a write into its words */
+    SIM_OP_MOV,                                         /* mov, and lea - the address of its operand is its source */
+    SIM_OP_CMP,
+    SIM_OP_ADD,
+    SIM_OP_SUB,
+    SIM_OP_CLR,
+    SIM_OP_NOT,
+    SIM_OP_INC,
+    SIM_OP_DEC,
+    SIM_OP_JMP,
+    SIM_OP_BNE,
+    SIM_OP_JSR,
+    SIM_OP_RED,
+    SIM_OP_PRN,
+    SIM_OP_RTS,
+    SIM_OP_STOP,
+    SIM_OP_FAULT                                        /* The word can not be executed, faults when it is reached */
+} SimOp;
+
+/* Faults of the SIM_OP_FAULT instructions */
+typedef enum {
+    SIM_FAULT_END,                                      /* Execution left the program */
+    SIM_FAULT_DATA,                                     /* A data word was reached */
+    SIM_FAULT_WORD,                                     /* The word is not a valid first word */
+    SIM_FAULT_ADDRESS                                   /* An operand is outside the program */
+} SimFault;
+
+/* Decoded instruction structure */
+/* An instruction ready to execute - at the index of its address in the decoded instructions of the program */
+
+typedef struct SimInstruction {
+    SimOp op;                                           /* Operation of the instruction */
+    int index;                                          /* Index of the instruction in instruction_set[] */
+    int cycles;                                         /* Cycles of the instruction */
+    Word *src;                                          /* Value of the source operand */
+    Word *dst;                                          /* Value of the destination operand */
+    Word immediate[2];                                  /* Values of the immediate operands the operands point to */
+    int written;                                        /* Address of the code word the instruction writes, 0 for none */
+    struct SimInstruction *next;                        /* The instruction that follows it */
+    struct SimInstruction *target;                      /* The instruction a jump goes to */
+    SimFault fault;                                     /* Fault of a SIM_OP_FAULT instruction */
+    int fault_address;                                  /* Address the fault is about */
+} SimInstruction;
+
+/* Simulator structure */
+/* The machine, and the program decoded into it */
+
+typedef struct {
+    AssemblerContext *ctx;                              /* Context of the program */
+    Word *memory;                                       /* The words of the image without the data flag, by address - INITIAL_IC */
+    size_t size;                                        /* Number of words of memory */
+    SimInstruction *code;                               /* Decoded instructions by address - INITIAL_IC, the end of the program last */
+    Word registers[SIM_REGISTER_COUNT];                 /* The registers */
+    SimInstruction *stack[SIM_STACK_SIZE];              /* Return stack - the instructions after the calls */
+    size_t depth;                                       /* Number of addresses on the return stack */
+    unsigned long decodes;                              /* Number of decoded instructions */
+    FILE *in;                                           /* Stream read by red */
+    FILE *out;                                          /* Stream written by prn */
+} Simulator;
+
+/* The signed value of a word */
+static long sim_signed(Word word)
+{
+    return (word & SIM_WORD_SIGN) ? (long)word - (long)(SIM_WORD_SIGN << 1) : (long)word;
+}
+
+/* The signed value of an extra word - an immediate or a relative offset */
+static long sim_value(Word word)
+{
+    unsigned long value = (word & IMM_MASK) >> IMM_SHIFT;
+
+    return (value & SIM_VALUE_SIGN) ? (long)value - (long)(SIM_VALUE_SIGN << 1) : (long)value;
+}
+
+/* Checks if an address is a word of the program */
+static int sim_in_program(Simulator *sim, long address)
+{
+    return address >= INITIAL_IC && address < INITIAL_IC + (long)sim->size;
+}
+
+/* The decoded instruction of an address, the end of the program for an address outside it */
+static SimInstruction *sim_at(Simulator *sim, long address)
+{
+    return sim_in_program(sim, address) ? &sim->code[address - INITIAL_IC] : &sim->code[sim->size];
+}
+
+/* The instruction of a first word, by its opcode and funct - INS_NONE if there is none */
+static int sim_instruction_index(Word word)
+{
+    unsigned int opcode = (word & OPCODE_MASK) >> OPCODE_POS;
+    unsigned int funct = (word & FUNCT_MASK) >> FUNCT_POS;
+    int i;
+
+    for (i = 0; i < INSTRUCTION_COUNT; i++)
+        if ((unsigned int)instruction_set[i].opcode == opcode && (unsigned int)instruction_set[i].funct == funct)
+            return i;
+
+    return INS_NONE;
+}
+
+/* Turns a decoded instruction into a fault */
+static void sim_decode_fault(SimInstruction *ins, SimFault fault, int address)
+{
+    ins->op = SIM_OP_FAULT;
+    ins->index = INS_NONE;
+    ins->fault = fault;
+    ins->fault_address = address;
+}
+
+/* Decodes an operand, reading its extra word at *pos - returns its value, NULL if it is outside the program */
+static Word *sim_decode_operand(Simulator *sim, SimInstruction *ins, AddressingMode mode, Word reg, int *pos, int slot)
+{
+    long address = 0;
+    Word extra = 0;
+
+    if (mode == ADD_MOD_REGISTER)
+        return &sim->registers[reg];
+
+    if (!sim_in_program(sim, *pos))
+    {
+        sim_decode_fault(ins, SIM_FAULT_ADDRESS, *pos);
+        return NULL;
+    }
+
+    extra = sim->memory[*pos - INITIAL_IC];
+    (*pos)++;
+
+    switch (mode)
+    {
+        case ADD_MOD_IMMEDIATE:
+            ins->immediate[slot] = (Word)sim_value(extra) & WORD_MASK;
+            return &ins->immediate[slot];
+
+        /* A jump goes to the address, lea moves it */
+        case ADD_MOD_DIRECT:
+            address = (long)((extra & IMM_MASK) >> IMM_SHIFT);
+
+            if (ins->index == INS_JMP || ins->index == INS_BNE || ins->index == INS_JSR)
+            {
+                ins->target = sim_at(sim, address);
+                return &ins->immediate[slot];
+            }
+
+            if (ins->index == INS_LEA && slot == 0)
+            {
+                ins->immediate[slot] = (Word)address;
+                return &ins->immediate[slot];
+            }
+
+            if (!sim_in_program(sim, address))
+            {
+                sim_decode_fault(ins, SIM_FAULT_ADDRESS, (int)address);
+                return NULL;
+            }
+
+            ins->cycles++;
+            return &sim->memory[address - INITIAL_IC];
+
+        /* The offset is from the address of the instruction, only jumps have it */
+        default:
+            ins->target = sim_at(sim, (long)(ins - sim->code) + INITIAL_IC + sim_value(extra));
+            return &ins->immediate[slot];
+    }
+}
+
+/* Decodes the instruction at the address of a decoded instruction */
+static void sim_decode(Simulator *sim, SimInstruction *ins)
+{
+    static const SimOp ops[INSTRUCTION_COUNT] = {
+        SIM_OP_MOV, SIM_OP_CMP, SIM_OP_ADD, SIM_OP_SUB, SIM_OP_MOV, SIM_OP_CLR, SIM_OP_NOT, SIM_OP_INC,
+        SIM_OP_DEC, SIM_OP_JMP, SIM_OP_BNE, SIM_OP_JSR, SIM_OP_RED, SIM_OP_PRN, SIM_OP_RTS, SIM_OP_STOP
+    };
+    const FirstWord *entry = NULL;
+    const InstructionInfo *info = NULL;
+    AddressingMode src_mode = ADD_MOD_NONE, dst_mode = ADD_MOD_NONE;
+    size_t index = (size_t)(ins - sim->code);
+    int address = INITIAL_IC + (int)index;
+    int pos = address + 1;
+    Word word = 0, expected = 0;
+
+    memset(ins, 0, sizeof(SimInstruction));
+    sim->decodes++;
+
+    if (index >= sim->size)
+    {
+        sim_decode_fault(ins, SIM_FAULT_END, address);
+        return;
+    }
+
+    if (sim->ctx->image[index] & WORD_DATA_FLAG)
+    {
+        sim_decode_fault(ins, SIM_FAULT_DATA, address);
+        return;
+    }
+
+    word = sim->memory[index];
+    ins->index = sim_instruction_index(word);
+
+    if (ins->index != INS_NONE)
+    {
+        info = &instruction_set[ins->index];
+
+        /* The modes of the operands the instruction has - the fields of the missing ones are 0 */
+        if (info->num_operands == 2)
+            src_mode = (AddressingMode)((word & SRC_ADD_MODE_MASK) >> SRC_ADD_MODE_POS);
+        if (info->num_operands >= 1)
+            dst_mode = (AddressingMode)((word & DST_ADD_MODE_MASK) >> DST_ADD_MODE_POS);
+
+        entry = first_word(ins->index, src_mode, dst_mode);
+    }
+
+    /* The word must be the first word the assembler encodes, with registers only in the register operands */
+    if (entry)
+        expected = entry->word | (src_mode == ADD_MOD_REGISTER ? word & SRC_OPERAND_MASK : 0) |
+                   (dst_mode == ADD_MOD_REGISTER ? word & DST_OPERAND_MASK : 0);
+
+    if (!entry || word != expected || (src_mode != ADD_MOD_NONE && !(entry->legal & FIRST_WORD_SRC_LEGAL)) ||
+        (dst_mode != ADD_MOD_NONE && !(entry->legal & FIRST_WORD_DST_LEGAL)))
+    {
+        sim_decode_fault(ins, SIM_FAULT_WORD, address);
+        return;
+    }
+
+    ins->op = ops[ins->index];
+
+    if (src_mode != ADD_MOD_NONE)
+        ins->src = sim_decode_operand(sim, ins, src_mode, (word & SRC_OPERAND_MASK) >> SRC_OPERAND_POS, &pos, 0);
+    if (dst_mode != ADD_MOD_NONE && ins->op != SIM_OP_FAULT)
+        ins->dst = sim_decode_operand(sim, ins, dst_mode, (word & DST_OPERAND_MASK) >> DST_OPERAND_POS, &pos, 1);
+
+    if (ins->op == SIM_OP_FAULT)
+        return;
+
+    /* A write into a code word drops the instructions decoded from it */
+    if (dst_mode == ADD_MOD_DIRECT && ins->op != SIM_OP_CMP && ins->op != SIM_OP_PRN && ins->target == NULL &&
+        !(sim->ctx->image[ins->dst - sim->memory] & WORD_DATA_FLAG))
+        ins->written = INITIAL_IC + (int)(ins->dst - sim->memory);
+
+    /* A word per cycle, the direct operands and the return stack were counted while decoding */
+    ins->cycles += pos - address + (ins->op == SIM_OP_JSR || ins->op == SIM_OP_RTS);
+    ins->next = sim_at(sim, pos);
+}
+
+/* Drops the decoded instructions that cover a code word */
+static void sim_write(Simulator *sim, int address)
+{
+    int i;
+
+    /* An instruction is at most 3 words */
+    for (i = address; i > address - 3 && i >= INITIAL_IC; i--)
+        sim->code[i - INITIAL_IC].op = SIM_OP_DECODE;
+}
+
+/* Reports the fault of an instruction */
+static void sim_fault(Simulator *sim, SimInstruction *ins, SimInstruction *last)
+{
+    const char *name = sim->ctx->filename;
+    char hex[16];
+    int address = INITIAL_IC + (int)(ins - sim->code);
+
+    if (ins->op == SIM_OP_JSR)
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Return stack overflow (%d calls) at address %d",
+                     name, SIM_STACK_SIZE, address);
+
+    else if (ins->op == SIM_OP_RTS)
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Return with an empty return stack at address %d", name, address);
+
+    else if (ins->fault == SIM_FAULT_END)
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Execution left the program after the instruction at address %d",
+                     name, INITIAL_IC + (int)(last - sim->code));
+
+    else if (ins->fault == SIM_FAULT_DATA)
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Data word at address %d executed as an instruction", name, address);
+
+    else if (ins->fault == SIM_FAULT_ADDRESS)
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Operand address %d of the instruction at address %d is outside the program",
+                     name, ins->fault_address, address);
+
+    else
+    {
+        sprintf(hex, "%06lx", (unsigned long)sim->memory[address - INITIAL_IC]);
+        error_report(sim->ctx->errors, ERR_RUN_FAULT, "%s: Invalid instruction word %s at address %d", name, hex, address);
+    }
+}
+
+/* Executes the program from an instruction until it stops, faults or reaches the step limit */
+static SimStatus sim_execute(Simulator *sim, SimInstruction *ins, unsigned long max_steps, SimResult *result)
+{
+    SimInstruction *next = NULL, *last = ins;
+    SimStatus status = SIM_STEP_LIMIT;
+    unsigned long limit = max_steps ? max_steps : (unsigned long)-1;
+    unsigned long steps = 0, cycles = 0;
+    unsigned long *counts = result->counts;
+    int zero = 0, c = 0;
+
+    while (ins && steps < limit)
+    {
+        next = ins->next;
+
+        switch (ins->op)
+        {
+            case SIM_OP_DECODE:
+                sim_decode(sim, ins);
+                continue;
+
+            case SIM_OP_MOV:
+                *ins->dst = *ins->src;
+                break;
+
+            case SIM_OP_CMP:
+                zero = *ins->src == *ins->dst;
+                break;
+
+            case SIM_OP_ADD:
+                *ins->dst = (*ins->dst + *ins->src) & WORD_MASK;
+                break;
+
+            case SIM_OP_SUB:
+                *ins->dst = (*ins->dst - *ins->src) & WORD_MASK;
+                break;
+
+            case SIM_OP_CLR:
+                *ins->dst = 0;
+                break;
+
+            case SIM_OP_NOT:
+                *ins->dst = ~*ins->dst & WORD_MASK;
+                break;
+
+            case SIM_OP_INC:
+                *ins->dst = (*ins->dst + 1) & WORD_MASK;
+                break;
+
+            case SIM_OP_DEC:
+                *ins->dst = (*ins->dst - 1) & WORD_MASK;
+                break;
+
+            case SIM_OP_JMP:
+                next = ins->target;
+                break;
+
+            case SIM_OP_BNE:
+                if (!zero)
+                    next = ins->target;
+                break;
+
+            case SIM_OP_JSR:
+                if (sim->depth == SIM_STACK_SIZE)
+                {
+                    sim_fault(sim, ins, last);
+                    status = SIM_FAULT;
+                    ins = NULL;
+                    continue;
+                }
+
+                sim->stack[sim->depth++] = next;
+                next = ins->target;
+                break;
+
+            case SIM_OP_RED:
+                c = getc(sim->in);
+                *ins->dst = (Word)(c == EOF ? -1 : c) & WORD_MASK;
+                break;
+
+            case SIM_OP_PRN:
+                fprintf(sim->out, "%ld\n", sim_signed(*ins->dst));
+                break;
+
+            case SIM_OP_RTS:
+                if (sim->depth == 0)
+                {
+                    sim_fault(sim, ins, last);
+                    status = SIM_FAULT;
+                    ins = NULL;
+                    continue;
+                }
+
+                next = sim->stack[--sim->depth];
+                break;
+
+            case SIM_OP_STOP:
+                status = SIM_STOPPED;
+                next = NULL;
+                break;
+
+            default:
+                sim_fault(sim, ins, last);
+                status = SIM_FAULT;
+                ins = NULL;
+                continue;
+        }
+
+        if (ins->written)
+            sim_write(sim, ins->written);
+
+        counts[ins->index]++;
+        cycles += ins->cycles;
+        steps++;
+
+        last = ins;
+        ins = next;
+    }
+
+    result->address = INITIAL_IC + (int)(last - sim->code);
+    result->zero = zero;
+    result->steps = steps;
+    result->cycles = cycles;
+
+    return status;
+}
+
+SimStatus simulate(AssemblerContext *ctx, unsigned long max_steps, FILE *in, FILE *out, SimResult *result)
+{
+    Simulator *sim = NULL;
+    double start = stats_wall_time();
+    size_t i, entry = 0;
+
+    if (!result)
+        return SIM_FAULT;
+
+    memset(result, 0, sizeof(SimResult));
+    result->status = SIM_FAULT;
+
+    if (!ctx || !ctx->errors)
+        return SIM_FAULT;
+
+    /* The external references are resolved by the link stage */
+    if (array_list_size(ctx->externals) > 0)
+    {
+        error_report(ctx->errors, ERR_RUN_EXTERNAL, "%s: The program references %lu external symbol(s), link it to run it",
+                     ctx->filename, (unsigned long)array_list_size(ctx->externals));
+        return SIM_FAULT;
+    }
+
+    /* The program starts at its first code word */
+    while (entry < ctx->image_size && (ctx->image[entry] & WORD_DATA_FLAG))
+        entry++;
+
+    if (entry == ctx->image_size)
+    {
+        error_report(ctx->errors, ERR_RUN_FAULT, "%s: The program has no instructions", ctx->filename);
+        return SIM_FAULT;
+    }
+
+    sim = (Simulator *)MALLOC(sizeof(Simulator));
+    if (sim)
+    {
+        memset(sim, 0, sizeof(Simulator));
+        sim->memory = (Word *)MALLOC(ctx->image_size * sizeof(Word));
+        sim->code = (SimInstruction *)MALLOC((ctx->image_size + 1) * sizeof(SimInstruction));
+    }
+
+    if (!sim || !sim->memory || !sim->code)
+        fprintf(stderr, "Failed to create the simulator\n");
+    else
+    {
+        sim->ctx = ctx;
+        sim->size = ctx->image_size;
+        sim->in = in;
+        sim->out = out;
+
+        for (i = 0; i < sim->size; i++)
+            sim->memory[i] = ctx->image[i] & WORD_MASK;
+
+        /* Nothing is decoded yet, the entry after the program is decoded into its end */
+        memset(sim->code, 0, (sim->size + 1) * sizeof(SimInstruction));
+
+        result->status = sim_execute(sim, &sim->code[entry], max_steps, result);
+        result->decodes = sim->decodes;
+
+        for (i = 0; i < SIM_REGISTER_COUNT; i++)
+            result->registers[i] = sim_signed(sim->registers[i]);
+    }
+
+    fflush(out);
+    result->seconds = stats_wall_time() - start;
+
+    /* Clean up */
+    if (sim && sim->memory)
+        FREE(sim->memory);
+    if (sim && sim->code)
+        FREE(sim->code);
+    if (sim)
+        FREE(sim);
+
+    return result->status;
+}
+
+void sim_print_result(FILE *stream, const char *name, const SimResult *result)
+{
+    static const char *endings[] = {"stopped", "reached the step limit", "faulted"};
+    int i;
+
+    if (!stream || !result)
+        return;
+
+    fprintf(stream, "%s: %s at address %d after %lu instruction(s), %lu cycle(s), %lu decoded, %.3f ms",
+            name ? name : "program", endings[result->status], result->address, result->steps, result->cycles,
+            result->decodes, result->seconds * 1000.0);
+
+    if (result->seconds > 0)
+        fprintf(stream, " (%.1f M instructions/s)", result->steps / result->seconds / 1e6);
+
+    fprintf(stream, "\n  instructions:");
+    for (i = 0; i < INSTRUCTION_COUNT; i++)
+        if (result->counts[i] > 0)
+            fprintf(stream, " %s %lu", instruction_set[i].name, result->counts[i]);
+
+    fprintf(stream, "\n  registers:");
+    for (i = 0; i < SIM_REGISTER_COUNT; i++)
+        fprintf(stream, " r%d %ld", i, result->registers[i]);
+
+    fprintf(stream, " Z %d\n", result->zero);
+}
+
+int sim_run(AssemblerContext *ctx, const AssemblerOptions *options)
+{
+    SimResult result;
+    SimStatus status = SIM_FAULT;
+
+    if (!ctx)
+        return 0;
+
+    status = simulate(ctx, options ? options->max_steps : 0, stdin, stdout, &result);
+    error_report_all(ctx->errors);
+
+    /* A program that could not start has no summary */
+    if (result.decodes > 0)
+        sim_print_result(stdout, ctx->filename, &result);
+
+    fflush(stdout);
+    return status == SIM_STOPPED;
+}
+
+int sim_run_files(char **files, int file_count, const AssemblerOptions *options)
+{
+    AssemblerContext ctx;
+    AssemblerOptions run_options = {0};
+    int i, is_failed = 0;
+
+    if (!files || file_count < 1)
+        return 1;
+
+    /* A file served from the build cache has no image to run */
+    if (options)
+        run_options = *options;
+    run_options.cache_dir = NULL;
+
+    for (i = 0; i < file_count; i++)
+    {
+        memset(&ctx, 0, sizeof(AssemblerContext));
+        asm_ctx_init(&ctx, files[i], &run_options);
+
+        if (!ctx.errors)
+        {
+            is_failed = 1;
+            continue;
+        }
+
+        assemble_file(&ctx);
+
+        if (ctx.stats.enabled && run_options.stats == STATS_JSON)
+        {
+            stats_print_json(stdout, ctx.filename, &ctx.stats, 0);
+            printf("\n");
+        }
+        else if (ctx.stats.enabled)
+            stats_print(stdout, ctx.filename, &ctx.stats, 0);
+
+        /* Only a file assembled without errors is run */
+        if (error_count(ctx.errors) > 0)
+        {
+            error_report_all(ctx.errors);
+            is_failed = 1;
+        }
+        else if (!sim_run(&ctx, &run_options))
+            is_failed = 1;
+
+        asm_ctx_destroy(&ctx);
+    }
+
+    return is_failed;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file simulator.h
+ * @brief Header file for the simulator of the assembled programs (--run).
+ * @details This file contains the function prototypes of an interpreter that executes an assembled program straight
+ *          from the image of its context (ctx->image), without writing or parsing the .ob file. Every address of
+ *          the image is memory, the code and data words at the addresses they were assembled at, and the program
+ *          starts at its first code word. The machine has the registers r0 to r7, a zero flag set by cmp and tested
+ *          by bne, and a return stack of SIM_STACK_SIZE addresses for jsr and rts.
+ *
+ * Every instruction is decoded once, the first time it is executed, into a SimInstruction - the operation with its
+ * addressing modes resolved, pointers to the source and destination values (a register, a memory word or the
+ * immediate kept in the instruction), the jump target and the next instruction. Executing it is a single dispatch on
+ * the operation, no field of the word is extracted again. A write into a code word drops the decoded instructions
+ * covering it, so a program that modifies its own code is decoded again.
+ *
+ * red reads a character from stdin (-1 at the end of the input) and prn prints the signed value of its operand on
+ * stdout, one per line. The cycle count is one cycle per word of an executed instruction, and one more per direct
+ * operand and per access of the return stack.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdio.h>
+
+#include "./assembler.h"
+#include "../common/isa.h"
+
+#define SIM_REGISTER_COUNT 8                            /* Registers r0 to r7 */
+#define SIM_STACK_SIZE 1024                             /* Depth of the return stack of jsr and rts */
+
+/* Simulation status */
+typedef enum {
+    SIM_STOPPED,                                        /* The program executed stop */
+    SIM_STEP_LIMIT,                                     /* The program executed the maximum number of instructions */
+    SIM_FAULT                                           /* The program faulted, the fault is reported */
+} SimStatus;
+
+/* Simulation result structure */
+/* The state of the machine when the program ended, and the counts of the run */
+
+typedef struct {
+    SimStatus status;                                   /* How the program ended */
+    int address;                                        /* Address of the last executed instruction */
+    long registers[SIM_REGISTER_COUNT];                 /* Signed values of the registers */
+    int zero;                                           /* The zero flag */
+    unsigned long steps;                                /* Number of executed instructions */
+    unsigned long cycles;                               /* Number of cycles */
+    unsigned long counts[INSTRUCTION_COUNT];            /* Executed instructions by instruction_set[] index */
+    unsigned long decodes;                              /* Number of decoded instructions */
+    double seconds;                                     /* Wall time of the run */
+} SimResult;
+
+/**
+ * @brief Executes the assembled program of a context.
+ * @param ctx Pointer to a context holding an assembled program without errors.
+ * @param max_steps Stop after this many instructions, 0 for no limit.
+ * @param in Stream read by red.
+ * @param out Stream written by prn.
+ * @param result The result to fill.
+ * @return The status of the run, also kept in result->status.
+ * @note A fault (an invalid instruction, an address outside the program, data executed as code, an overflow of the
+ *       return stack) is reported into ctx->errors. A program with external references can not run before it is linked.
+ */
+SimStatus simulate(AssemblerContext *ctx, unsigned long max_steps, FILE *in, FILE *out, SimResult *result);
+
+/**
+ * @brief Prints the summary of a run - how it ended, the instruction and cycle counts, the speed and the registers.
+ * @param stream The stream to print to.
+ * @param name Name of the program.
+ * @param result The result of the run.
+ */
+void sim_print_result(FILE *stream, const char *name, const SimResult *result);
+
+/**
+ * @brief Runs the assembled program of a context with the options of the run, and reports the run.
+ * @param ctx Pointer to a context holding an assembled program without errors.
+ * @param options Options of the run, NULL for the defaults (options->max_steps limits the run).
+ * @return 1 if the program stopped, 0 otherwise.
+ * @note The program reads stdin and prints on stdout, then the faults are reported and the summary is printed.
+ */
+int sim_run(AssemblerContext *ctx, const AssemblerOptions *options);
+
+/**
+ * @brief Assembles the files and runs every file assembled without errors, printing the summary of each run.
+ * @param files The names of the files, without the .as extension.
+ * @param file_count The number of files.
+ * @param options Options of the run, NULL for the defaults. The files are assembled and run one at a time (-j is ignored).
+ * @return 0 if every file was assembled and its program stopped, 1 otherwise.
+ * @note The output files are written as usual, the build cache is not used - a cached file has no image to run.
+ */
+int sim_run_files(char **files, int file_count, const AssemblerOptions *options);
+
+#endif /* SIMULATOR_H */
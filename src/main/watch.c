@@ -0,0 +1,330 @@
+/**
+ * @file watch.c
+ * @brief Implementation of the watch mode of the assembler.
+ * @details This file contains the loop of the watch mode - it waits for the sources to change, with inotify or by
+ *          polling them, and reassembles the changed files on the session's context. See watch.h for the details.
+ */
+
+/* stat() and nanosleep() are POSIX, not ANSI C */
+#define _POSIX_C_SOURCE 199309L
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(__linux__) && !defined(ASM_NO_INOTIFY)
+#define WATCH_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "./watch.h"
+#include "../common/error.h"
+#include "../common/file_io.h"
+#include "../common/util.h"
+
+/* A watched source */
+typedef struct {
+    const char *name;                                   /* Name of the file, without the extension */
+    char *path;                                         /* Path of the source */
+    const char *base;                                   /* Name of the source in its directory */
+    int watch;                                          /* inotify watch of its directory, -1 when polled */
+    int exists;                                         /* The source existed when it was last seen */
+    struct stat last;                                   /* State of the source when it was last seen */
+    int is_changed;                                     /* The source changed since it was assembled */
+} WatchedFile;
+
+/* Set by SIGINT, ends the session */
+static volatile sig_atomic_t is_interrupted = 0;
+
+static void watch_interrupt(int signal_number)
+{
+    (void)signal_number;
+    is_interrupted = 1;
+}
+
+/* Sleeps for a number of milliseconds, returns early on a signal */
+static void watch_sleep(long ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+/* Records the state of a source, returns 1 if it differs from the one recorded last */
+static int watch_stat(WatchedFile *file)
+{
+    struct stat current;
+    int exists = stat(file->path, &current) == 0;
+    int is_changed = exists != file->exists;
+
+    if (exists && file->exists)
+        is_changed = current.st_mtime != file->last.st_mtime || current.st_ctime != file->last.st_ctime ||
+                     current.st_size != file->last.st_size || current.st_ino != file->last.st_ino;
+
+    file->exists = exists;
+    if (exists)
+        file->last = current;
+
+    return is_changed;
+}
+
+/* Assembles a single file on the session's context and reports it */
+static void watch_assemble(AssemblerContext *ctx, WatchedFile *file)
+{
+    double start = stats_wall_time();
+    unsigned long errors = 0;
+
+    /* The storage of the previous file is reused */
+    asm_ctx_reset(ctx, file->name);
+    assemble_file(ctx);
+
+    /* Counted before the report, which empties the log */
+    errors = error_count(ctx->errors);
+    error_report_all(ctx->errors);
+
+    if (ctx->stats.enabled && ctx->options->stats == STATS_JSON)
+    {
+        stats_print_json(stdout, ctx->filename, &ctx->stats, 0);
+        printf("\n");
+    }
+    else if (ctx->stats.enabled)
+        stats_print(stdout, ctx->filename, &ctx->stats, 0);
+
+    if (errors > 0)
+        printf("%s: %lu error(s)\n", file->path, errors);
+    else
+        printf("%s: assembled in %.3f ms\n", file->path, (stats_wall_time() - start) * 1000.0);
+
+    fflush(stdout);
+}
+
+/* Waits until a source changed and stopped changing, returns 0 when interrupted */
+static int watch_poll_wait(WatchedFile *files, int file_count)
+{
+    int i, is_changed = 0;
+
+    while (!is_interrupted && !is_changed)
+    {
+        watch_sleep(WATCH_POLL_INTERVAL_MS);
+
+        for (i = 0; i < file_count; i++)
+            if (watch_stat(&files[i]))
+                files[i].is_changed = is_changed = 1;
+    }
+
+    /* A source that is still being written is assembled once it settles */
+    while (!is_interrupted && is_changed)
+    {
+        watch_sleep(WATCH_SETTLE_MS);
+        is_changed = 0;
+
+        for (i = 0; i < file_count; i++)
+            if (watch_stat(&files[i]))
+                files[i].is_changed = is_changed = 1;
+    }
+
+    return !is_interrupted;
+}
+
+#ifdef WATCH_INOTIFY
+/* Watches the directory of every source - a rename into place is seen, a watch of the file would be lost with it */
+static int watch_inotify_open(WatchedFile *files, int file_count)
+{
+    char *dir = NULL;
+    size_t length = 0;
+    int fd = inotify_init();
+    int i;
+
+    if (fd < 0)
+        return -1;
+
+    for (i = 0; i < file_count; i++)
+    {
+        dir = STRDUP(files[i].path);
+        if (!dir)
+            break;
+
+        /* The part of the path before the name, the current directory when there is none */
+        length = (size_t)(files[i].base - files[i].path);
+        if (length == 0)
+            strcpy(dir, ".");
+        else
+            dir[length > 1 ? length - 1 : length] = '\0';
+
+        files[i].watch = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+        FREE(dir);
+
+        if (files[i].watch < 0)
+            break;
+    }
+
+    /* Any directory that can not be watched falls back to polling, for all of the sources */
+    if (i < file_count)
+    {
+        for (i = 0; i < file_count; i++)
+            files[i].watch = -1;
+
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Waits until a source changed and no event came for WATCH_SETTLE_MS, returns 0 when interrupted or on a failure */
+static int watch_inotify_wait(int fd, WatchedFile *files, int file_count)
+{
+    union {
+        struct inotify_event event;                     /* Aligns the buffer for the events */
+        char bytes[WATCH_EVENT_BUFFER_SIZE];
+    } buffer;
+    struct inotify_event *event = NULL;
+    struct pollfd pfd;
+    long length = 0, pos = 0;
+    int i, ready = 0, is_changed = 0;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (!is_interrupted)
+    {
+        ready = poll(&pfd, 1, is_changed ? WATCH_SETTLE_MS : -1);
+
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0)
+            return 0;
+
+        /* No event since the last change */
+        if (ready == 0)
+            return 1;
+
+        length = (long)read(fd, buffer.bytes, sizeof(buffer.bytes));
+        if (length <= 0)
+            return 0;
+
+        for (pos = 0; pos < length; pos += (long)sizeof(struct inotify_event) + (long)event->len)
+        {
+            event = (struct inotify_event *)(buffer.bytes + pos);
+
+            for (i = 0; i < file_count; i++)
+            {
+                /* Events were dropped, any source may have changed */
+                if ((event->mask & IN_Q_OVERFLOW) ||
+                    (event->len && event->wd == files[i].watch && strcmp(event->name, files[i].base) == 0))
+                    files[i].is_changed = is_changed = 1;
+            }
+        }
+    }
+
+    return 0;
+}
+#endif /* WATCH_INOTIFY */
+
+int watch_run(char **files, int file_count, const AssemblerOptions *options)
+{
+    AssemblerContext ctx;
+    WatchedFile *watched = NULL;
+    void (*previous)(int) = NULL;
+    int i, fd = -1, is_failed = 0;
+
+    if (!files || file_count < 1)
+        return 1;
+
+    memset(&ctx, 0, sizeof(AssemblerContext));
+
+    watched = (WatchedFile *)MALLOC(file_count * sizeof(WatchedFile));
+    if (!watched)
+        return 1;
+
+    memset(watched, 0, file_count * sizeof(WatchedFile));
+
+    /* Every file is assembled once when the session starts */
+    for (i = 0; i < file_count; i++)
+    {
+        watched[i].name = files[i];
+        watched[i].path = (char *)MALLOC(strlen(files[i]) + strlen(ASM_EXT) + 1);
+        watched[i].watch = -1;
+        watched[i].is_changed = 1;
+
+        if (!watched[i].path)
+        {
+            is_failed = 1;
+            break;
+        }
+
+        sprintf(watched[i].path, "%s%s", files[i], ASM_EXT);
+        watched[i].base = strrchr(watched[i].path, '/') ? strrchr(watched[i].path, '/') + 1 : watched[i].path;
+        watch_stat(&watched[i]);
+    }
+
+    if (!is_failed)
+    {
+        asm_ctx_init(&ctx, files[0], options);
+        is_failed = !ctx.errors;
+    }
+
+    if (!is_failed)
+    {
+#ifdef WATCH_INOTIFY
+        fd = watch_inotify_open(watched, file_count);
+#endif
+        printf("Watching %d file(s) (%s), press Ctrl+C to stop\n", file_count, fd >= 0 ? "inotify" : "polling");
+        fflush(stdout);
+
+        previous = signal(SIGINT, watch_interrupt);
+
+        while (!is_interrupted)
+        {
+            for (i = 0; i < file_count && !is_interrupted; i++)
+            {
+                if (!watched[i].is_changed)
+                    continue;
+
+                watched[i].is_changed = 0;
+                watch_assemble(&ctx, &watched[i]);
+            }
+
+#ifdef WATCH_INOTIFY
+            /* A failure of inotify falls back to polling */
+            if (fd >= 0 && !watch_inotify_wait(fd, watched, file_count) && !is_interrupted)
+            {
+                close(fd);
+                fd = -1;
+
+                for (i = 0; i < file_count; i++)
+                    watch_stat(&watched[i]);
+            }
+
+            if (fd >= 0)
+                continue;
+#endif
+            watch_poll_wait(watched, file_count);
+        }
+
+        signal(SIGINT, previous);
+    }
+
+    /* Clean up */
+#ifdef WATCH_INOTIFY
+    if (fd >= 0)
+        close(fd);
+#endif
+
+    asm_ctx_destroy(&ctx);
+
+    for (i = 0; i < file_count; i++)
+        if (watched[i].path)
+            FREE(watched[i].path);
+
+    FREE(watched);
+    return is_failed;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file watch.h
+ * @brief Header file for the watch mode of the assembler (--watch).
+ * @details This file contains the function prototype of a long running loop that assembles the given files once,
+ *          then reassembles a file every time its source changes. One AssemblerContext is kept for the whole
+ *          session and reset between the files, like the daemon mode, so only the changed files are read,
+ *          hashed and assembled, and no process is started for them.
+ *
+ * On Linux the directories of the sources are watched with inotify, a source is changed when it is written,
+ * renamed into place or removed. Elsewhere (or when built with -DASM_NO_INOTIFY, or when inotify is not available)
+ * the sources are polled every WATCH_POLL_INTERVAL_MS with stat(), a source is changed when its modification
+ * time, size or inode differ. Changes that come close together are assembled once, after WATCH_SETTLE_MS of quiet.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "./assembler.h"
+
+#define WATCH_POLL_INTERVAL_MS 500                      /* Interval of the stat() polling */
+#define WATCH_SETTLE_MS 50                              /* Quiet time after a change before reassembling */
+#define WATCH_EVENT_BUFFER_SIZE 4096                    /* Size of the buffer the inotify events are read into */
+
+/**
+ * @brief Assembles the files, then reassembles every file whose source changed until interrupted (SIGINT).
+ * @param files The names of the files to watch, without the .as extension.
+ * @param file_count The number of files.
+ * @param options Options applied to every file, NULL for the defaults. The files are assembled one at a time (-j is ignored).
+ * @return 0 when the session was interrupted, 1 on an allocation failure.
+ * @note A line is printed on stdout for every assembled file, the errors are reported as usual.
+ */
+int watch_run(char **files, int file_count, const AssemblerOptions *options);
+
+#endif /* WATCH_H */
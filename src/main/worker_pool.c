@@ -0,0 +1,156 @@
+/**
+ * @file worker_pool.c
+ * @brief Implementation of the worker pool.
+ * @details This file contains a minimal worker pool built on POSIX threads. Worker threads take the next task index
+ *          from a shared counter, while the calling thread waits for the tasks to finish one after the other
+ *          and calls the done function in task order.
+ */
+
+#include "./worker_pool.h"
+#include "../common/util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef ASM_NO_THREADS
+#include <pthread.h>
+
+/* Shared state of a single worker_pool_run() call */
+typedef struct {
+    pthread_mutex_t lock;                   /* Protects next and finished */
+    pthread_cond_t task_done;               /* Signaled whenever a task finishes */
+    int next;                               /* Index of the next task to run */
+    int task_count;                         /* Number of tasks */
+    char *finished;                         /* Per task flag, set once the task finished */
+    WorkerFunction task;                    /* The task function */
+    void *arg;                              /* User argument */
+} WorkerPool;
+
+static void *worker_main(void *pool_ptr)
+{
+    WorkerPool *pool = (WorkerPool *)pool_ptr;
+    int index;
+
+    for (;;)
+    {
+        /* Take the next task */
+        pthread_mutex_lock(&pool->lock);
+        index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (index >= pool->task_count)
+            break;
+
+        pool->task(pool->arg, index);
+
+        /* Mark it as finished and wake the calling thread */
+        pthread_mutex_lock(&pool->lock);
+        pool->finished[index] = 1;
+        pthread_cond_broadcast(&pool->task_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+#endif /* ASM_NO_THREADS */
+
+/* Runs all the tasks in order on the calling thread */
+static void run_sequential(int task_count, WorkerFunction task, WorkerFunction done, void *arg)
+{
+    int i;
+
+    for (i = 0; i < task_count; i++)
+    {
+        task(arg, i);
+
+        if (done)
+            done(arg, i);
+    }
+}
+
+int worker_pool_run(int jobs, int task_count, WorkerFunction task, WorkerFunction done, void *arg)
+{
+#ifndef ASM_NO_THREADS
+    WorkerPool pool;
+    pthread_t *threads = NULL;
+    int thread_count = 0;
+    int i;
+#endif
+
+    if (!task || task_count <= 0)
+        return 1;
+
+#ifndef ASM_NO_THREADS
+    if (jobs > 1 && task_count > 1)
+    {
+        if (jobs > task_count)
+            jobs = task_count;
+
+        memset(&pool, 0, sizeof(WorkerPool));
+        pool.task_count = task_count;
+        pool.task = task;
+        pool.arg = arg;
+
+        pool.finished = (char *)MALLOC(task_count);
+        threads = (pthread_t *)MALLOC(jobs * sizeof(pthread_t));
+
+        if (!pool.finished || !threads)
+        {
+            FREE(pool.finished);
+            FREE(threads);
+            run_sequential(task_count, task, done, arg);
+            return 0;
+        }
+
+        memset(pool.finished, 0, task_count);
+        pthread_mutex_init(&pool.lock, NULL);
+        pthread_cond_init(&pool.task_done, NULL);
+
+        /* Start the workers */
+        for (i = 0; i < jobs; i++)
+        {
+            if (pthread_create(&threads[i], NULL, worker_main, &pool) != 0)
+                break;
+
+            thread_count++;
+        }
+
+        /* Not a single worker could be started */
+        if (thread_count == 0)
+        {
+            pthread_mutex_destroy(&pool.lock);
+            pthread_cond_destroy(&pool.task_done);
+            FREE(pool.finished);
+            FREE(threads);
+            run_sequential(task_count, task, done, arg);
+            return 0;
+        }
+
+        /* Hand the finished tasks back in order */
+        for (i = 0; i < task_count; i++)
+        {
+            pthread_mutex_lock(&pool.lock);
+            while (!pool.finished[i])
+                pthread_cond_wait(&pool.task_done, &pool.lock);
+            pthread_mutex_unlock(&pool.lock);
+
+            if (done)
+                done(arg, i);
+        }
+
+        for (i = 0; i < thread_count; i++)
+            pthread_join(threads[i], NULL);
+
+        pthread_mutex_destroy(&pool.lock);
+        pthread_cond_destroy(&pool.task_done);
+        FREE(pool.finished);
+        FREE(threads);
+        return 1;
+    }
+#else
+    (void)jobs;
+#endif
+
+    run_sequential(task_count, task, done, arg);
+    return 1;
+}
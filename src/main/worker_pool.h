@@ -0,0 +1,28 @@
+/**
+ * @file worker_pool.h
+ * @brief Header file for the worker pool.
+ * @details This file contains the function prototypes of a minimal worker pool that runs a fixed number of
+ *          independent tasks on a pool of threads. Finished tasks are handed back to the calling thread
+ *          strictly in task order, so any output they produce stays deterministic.
+ *          Building with -DASM_NO_THREADS turns the pool into a plain sequential loop.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+/* Function pointer type for a task, called with the user argument and the index of the task */
+typedef void (*WorkerFunction)(void *arg, int index);
+
+/**
+ * @brief Runs task_count tasks on up to jobs worker threads.
+ * @param jobs The maximum number of worker threads.
+ * @param task_count The number of tasks to run.
+ * @param task The function running a single task, called on a worker thread.
+ * @param done The function called for each finished task, on the calling thread and in task order (may be NULL).
+ * @param arg User argument passed to both functions.
+ * @return 1 on success, 0 if the threads could not be created (the tasks are then run sequentially).
+ * @note With jobs <= 1 (or a single task) no threads are created and every task is run and finished in order.
+ */
+int worker_pool_run(int jobs, int task_count, WorkerFunction task, WorkerFunction done, void *arg);
+
+#endif /* WORKER_POOL_H */